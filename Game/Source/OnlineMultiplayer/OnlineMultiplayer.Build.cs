@@ -23,7 +23,13 @@ public class OnlineMultiplayer : ModuleRules
                 }
         );
 
-        PrivateDependencyModuleNames.AddRange(new string[] { });
+        PrivateDependencyModuleNames.AddRange(new string[] { "Sockets", "Json", "Icmp" });
+        
+        // Used by the automation tests to stand in for web services.
+        if (Target.Configuration != UnrealTargetConfiguration.Shipping)
+        {
+            PrivateDependencyModuleNames.Add("HTTPServer");
+        }
         
         
         
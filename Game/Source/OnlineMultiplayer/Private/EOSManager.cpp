@@ -3,44 +3,19 @@
 #include "EOSManager.h"
 
 #include "eos_sdk.h"
-#include "eos_logging.h"
 #include "eos_common.h"
 #include "eos_integratedplatform.h"
+#include "Utils/EosAllocator.h"
+#include "Utils/EosLogSink.h"
+#include "Utils/BootTimeline.h"
 
+DECLARE_STATS_GROUP(TEXT("EOS"), STATGROUP_Eos, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("EOS Platform Tick"), STAT_EosPlatformTick, STATGROUP_Eos);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("EOS Tick Duration (ms)"), STAT_EosTickDuration, STATGROUP_Eos);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("EOS Frame Budget (ms)"), STAT_EosFrameBudget, STATGROUP_Eos);
+DECLARE_DWORD_COUNTER_STAT(TEXT("EOS Ticks Per Frame"), STAT_EosTicksPerFrame, STATGROUP_Eos);
 
 
-/**
- * Receives useful logs from the EOS SDK.
- */
-static void EOS_CALL OnEosLogMessage(const EOS_LogMessage* Message)
-{
-	// Temporary solution.
-	if (Message)
-	{
-		switch (Message->Level)
-		{
-		case EOS_ELogLevel::EOS_LOG_Fatal:
-			UE_LOG(LogEos, Fatal, TEXT("EOS [%hs]: %hs"), Message->Category, Message->Message);
-			break;
-		case EOS_ELogLevel::EOS_LOG_Error:
-			UE_LOG(LogEos, Error, TEXT("EOS [%hs]: %hs"), Message->Category, Message->Message);
-			break;
-		case EOS_ELogLevel::EOS_LOG_Warning:
-			UE_LOG(LogEos, Warning, TEXT("EOS [%hs]: %hs"), Message->Category, Message->Message);
-			break;
-		case EOS_ELogLevel::EOS_LOG_Info:
-			UE_LOG(LogEos, Log, TEXT("EOS [%hs]: %hs"), Message->Category, Message->Message);
-			break;
-		case EOS_ELogLevel::EOS_LOG_Verbose:
-		case EOS_ELogLevel::EOS_LOG_VeryVerbose:
-			UE_LOG(LogEos, Verbose, TEXT("EOS [%hs]: %hs"), Message->Category, Message->Message);
-			break;
-		case EOS_ELogLevel::EOS_LOG_Off:
-		default:
-			break;
-		}
-	}
-}
 
 FEosManager::~FEosManager()
 {
@@ -49,7 +24,41 @@ FEosManager::~FEosManager()
 
 void FEosManager::Tick(float DeltaTime)
 {
-	if (PlatformHandle) EOS_Platform_Tick(PlatformHandle); // If-statement maybe redundant because of IsTickable().
+	if (!PlatformHandle) return; // Maybe redundant because of IsTickable().
+	
+	// Tick every frame while busy, otherwise throttle.
+	const double Now = FPlatformTime::Seconds();
+	const bool bBusy = NumAsyncOperations > 0 || Now < BusyUntil;
+	const float TickInterval = bBusy ? 0.0f : bPerformanceCritical ? PerformanceCriticalTickInterval : IdleTickInterval;
+	if (Now - LastTickTime < TickInterval) return;
+	LastTickTime = Now;
+
+	// The budget for this frame is part of what is left after the game-thread work of the last frame.
+	const float GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	const float FrameBudgetMs = bPerformanceCritical ? MinFrameBudgetMs : FMath::Clamp((TargetFrameTimeMs - GameThreadMs) * HeadroomFraction, MinFrameBudgetMs, MaxFrameBudgetMs);
+
+	SCOPE_CYCLE_COUNTER(STAT_EosPlatformTick);
+	int32 NumTicks = 0;
+	float ElapsedMs = 0.0f;
+	float TickMs;
+	do
+	{
+		// Each tick is bounded by the SDK tick-budget, so keep ticking while there is work and the frame has room for another one.
+		const double TickStartTime = FPlatformTime::Seconds();
+		EOS_Platform_Tick(PlatformHandle);
+		TickMs = static_cast<float>((FPlatformTime::Seconds() - TickStartTime) * 1000.0);
+		ElapsedMs += TickMs;
+		++NumTicks;
+	}
+	while (bBusy && TickMs > IdleTickThresholdMs && NumTicks < MaxTicksPerFrame && ElapsedMs + TickMs <= FrameBudgetMs);
+
+	// Notifications are not counted as operations, but often cause follow-up requests, so stay busy for a moment.
+	if (TickMs > IdleTickThresholdMs) MarkBusy();
+	
+	LastTickDurationMs = ElapsedMs;
+	SET_FLOAT_STAT(STAT_EosTickDuration, ElapsedMs);
+	SET_FLOAT_STAT(STAT_EosFrameBudget, FrameBudgetMs);
+	SET_DWORD_STAT(STAT_EosTicksPerFrame, NumTicks);
 }
 
 bool FEosManager::IsTickable() const
@@ -59,8 +68,7 @@ bool FEosManager::IsTickable() const
 
 TStatId FEosManager::GetStatId() const
 {
-	// Return an empty TStatId (used for profiling)
-	return TStatId();
+	RETURN_QUICK_DECLARE_CYCLE_STAT(FEosManager, STATGROUP_Tickables);
 }
 
 FEosManager& FEosManager::Get()
@@ -70,17 +78,56 @@ FEosManager& FEosManager::Get()
 }
 
 
+/**
+ * Ticks the platform every frame for a while, for work that is not tracked as an async operation.
+ */
+void FEosManager::MarkBusy(const float Duration)
+{
+	BusyUntil = FMath::Max(BusyUntil, FPlatformTime::Seconds() + Duration);
+}
+
+/**
+ * Ticks the platform every frame until the matching EndAsyncOperation, should be called right before an async EOS call is issued.
+ */
+void FEosManager::BeginAsyncOperation()
+{
+	++NumAsyncOperations;
+}
+
+/**
+ * Should be called at the start of the completion callback. Results that are not final, like 'EOS_OperationWillRetry', are ignored, the callback is called again.
+ */
+void FEosManager::EndAsyncOperation(const EOS_EResult Result)
+{
+	if (!EOS_EResult_IsOperationComplete(Result)) return;
+	NumAsyncOperations = FMath::Max(0, NumAsyncOperations - 1);
+
+	// Completions often cause follow-up requests.
+	MarkBusy();
+}
+
+/**
+ * While performance-critical, for example during a match, EOS is ticked less often and with a minimal budget.
+ */
+void FEosManager::SetPerformanceCritical(const bool bInPerformanceCritical)
+{
+	bPerformanceCritical = bInPerformanceCritical;
+}
+
+
 // --------------------------------
 
 
 void FEosManager::Initialize()
 {
-	// Register the logging callback.
-	EOS_Logging_SetCallback(&OnEosLogMessage);
-	EOS_Logging_SetLogLevel(EOS_ELogCategory::EOS_LC_ALL_CATEGORIES, EOS_ELogLevel::EOS_LOG_Verbose);
+	int32 ConfigTickBudgetMs;
+	if (GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("EosTickBudgetMs"), ConfigTickBudgetMs, GGameIni)) TickBudgetMs = FMath::Max(0, ConfigTickBudgetMs);
+	float TargetFrameRate;
+	if (GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("EosTargetFrameRate"), TargetFrameRate, GGameIni) && TargetFrameRate > 0.0f) TargetFrameTimeMs = 1000.0f / TargetFrameRate;
 
 	// Initialize the SDK and the platform. Order is important here.
 	InitializeSdk();
+	FEosLogSink::Get().Initialize(); // The SDK only accepts the logging callback after it has been initialized.
 	InitializePlatform();
 }
 
@@ -89,16 +136,25 @@ void FEosManager::Initialize()
  */
 void FEosManager::InitializeSdk()
 {
+	BOOT_TIMELINE_SCOPE("EosInitializeSdk");
+	
 	EOS_InitializeOptions InitOptions;
 	InitOptions.ApiVersion = EOS_INITIALIZE_API_LATEST;
-	InitOptions.AllocateMemoryFunction = nullptr;
-	InitOptions.ReallocateMemoryFunction = nullptr;
-	InitOptions.ReleaseMemoryFunction = nullptr;
+	// Route the SDK memory through FMemory, so it is tracked.
+	bool bSmallBlockPool = false;
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bEosSmallBlockPool"), bSmallBlockPool, GGameIni);
+	FEosAllocator::SetSmallBlockPoolEnabled(bSmallBlockPool);
+	InitOptions.AllocateMemoryFunction = &FEosAllocator::Allocate;
+	InitOptions.ReallocateMemoryFunction = &FEosAllocator::Reallocate;
+	InitOptions.ReleaseMemoryFunction = &FEosAllocator::Release;
 	InitOptions.ProductName = "MBGame";
 	InitOptions.ProductVersion = "0.0.1";
 	InitOptions.Reserved = nullptr;
 	InitOptions.SystemInitializeOptions = nullptr;
-	InitOptions.OverrideThreadAffinity = nullptr;
+
+	EOS_Initialize_ThreadAffinity ThreadAffinity = {};
+	InitializeThreadAffinity(ThreadAffinity);
+	InitOptions.OverrideThreadAffinity = &ThreadAffinity;
 
 	const EOS_EResult InitResult = EOS_Initialize(&InitOptions);
 	if (InitResult != EOS_EResult::EOS_Success)
@@ -109,6 +165,58 @@ void FEosManager::InitializeSdk()
 	UE_LOG(LogEos, Log, TEXT("EOS SDK initialized successfully"));
 }
 
+/**
+ * Sets the affinity of every category of SDK thread.
+ *
+ * By default, all SDK threads share the cores that the game, rendering and RHI threads are not pinned to.
+ * When those threads are not pinned, or there are no cores left, the SDK uses its platform default.
+ */
+void FEosManager::InitializeThreadAffinity(EOS_Initialize_ThreadAffinity& ThreadAffinity)
+{
+	ThreadAffinity.ApiVersion = EOS_INITIALIZE_THREADAFFINITY_API_LATEST;
+
+	uint64 DefaultMask = 0;
+	bool bPinThreads = true;
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bEosPinThreads"), bPinThreads, GGameIni);
+	FParse::Bool(FCommandLine::Get(), TEXT("EosPinThreads="), bPinThreads); // So benchmark runs can compare both without editing the config.
+	if (bPinThreads)
+	{
+		const int32 NumCores = FMath::Min(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 64);
+		const uint64 AllCoresMask = NumCores >= 64 ? MAX_uint64 : (1ull << NumCores) - 1;
+		
+		// Masks that cover all cores mean the thread is not pinned, and then there is nothing to avoid.
+		uint64 ReservedMask = 0;
+		for (const uint64 Mask : { FPlatformAffinity::GetMainGameMask(), FPlatformAffinity::GetRenderingThreadMask(), FPlatformAffinity::GetRHIThreadMask() })
+		{
+			if ((Mask & AllCoresMask) != AllCoresMask) ReservedMask |= Mask;
+		}
+		
+		DefaultMask = AllCoresMask & ~ReservedMask;
+		if (!ReservedMask || !DefaultMask) DefaultMask = 0;
+	}
+	bThreadsPinned = DefaultMask != 0;
+
+	// Every category can be overridden separately.
+	const auto GetMask = [DefaultMask](const TCHAR* Key)
+	{
+		FString Value;
+		if (!GConfig->GetString(TEXT("OnlineMultiplayer"), Key, Value, GGameIni) || Value.IsEmpty()) return DefaultMask;
+		return Value.StartsWith(TEXT("0x")) ? FParse::HexNumber64(*Value.Mid(2)) : FCString::Strtoui64(*Value, nullptr, 10);
+	};
+	ThreadAffinity.NetworkWork = GetMask(TEXT("EosAffinityNetworkWork"));
+	ThreadAffinity.StorageIo = GetMask(TEXT("EosAffinityStorageIo"));
+	ThreadAffinity.WebSocketIo = GetMask(TEXT("EosAffinityWebSocketIo"));
+	ThreadAffinity.P2PIo = GetMask(TEXT("EosAffinityP2PIo"));
+	ThreadAffinity.HttpRequestIo = GetMask(TEXT("EosAffinityHttpRequestIo"));
+	ThreadAffinity.RTCIo = GetMask(TEXT("EosAffinityRTCIo"));
+
+	// Report the placement, zero meaning the SDK default.
+	const auto ToString = [](const uint64 Mask) { return Mask ? FString::Printf(TEXT("0x%llx"), Mask) : FString(TEXT("Default")); };
+	UE_LOG(LogEos, Log, TEXT("EOS thread affinity, NetworkWork: %s, StorageIo: %s, WebSocketIo: %s, P2PIo: %s, HttpRequestIo: %s, RTCIo: %s"),
+		*ToString(ThreadAffinity.NetworkWork), *ToString(ThreadAffinity.StorageIo), *ToString(ThreadAffinity.WebSocketIo),
+		*ToString(ThreadAffinity.P2PIo), *ToString(ThreadAffinity.HttpRequestIo), *ToString(ThreadAffinity.RTCIo));
+}
+
 /**
  * Initializes the EOS-Platform.
  * 
@@ -118,6 +226,8 @@ void FEosManager::InitializeSdk()
  */
 void FEosManager::InitializePlatform()
 {
+	BOOT_TIMELINE_SCOPE("EosCreatePlatform");
+	
 	// Create the temporary container.
 	EOS_Platform_Options PlatformOptions = {};
 	if(CreateIntegratedPlatform(PlatformOptions) != EOS_EResult::EOS_Success)
@@ -138,7 +248,7 @@ void FEosManager::InitializePlatform()
 	PlatformOptions.OverrideCountryCode = nullptr;
 	PlatformOptions.OverrideLocaleCode = nullptr;
 	PlatformOptions.CacheDirectory = nullptr;
-	PlatformOptions.TickBudgetInMilliseconds = 0;
+	PlatformOptions.TickBudgetInMilliseconds = TickBudgetMs;
 	PlatformOptions.RTCOptions = nullptr;
 	PlatformOptions.IntegratedPlatformOptionsContainerHandle = nullptr;
 	// PlatformOptions.Flags = EOS_PF_LOADING_IN_EDITOR;
@@ -3,10 +3,13 @@
 #include "LatentAction/StartListenServer.h"
 #include "Subsystems/Lobby/LobbySubsystem.h"
 #include "Subsystems/Session/SessionSubsystem.h"
-#include "HttpModule.h"
 #include "GameModes/MultiplayerGameMode.h"
-#include "Interfaces/IHttpResponse.h"
 #include "PlayerStates/MultiplayerPlayerState.h"
+#include "GameFramework/GameStateBase.h"
+#include "Subsystems/User/Local/LocalUserSubsystem.h"
+#include "Utils/PublicAddressCache.h"
+#include "Subsystems/Map/MapPreloadSubsystem.h"
+#include "Subsystems/Lobby/HostElectionSubsystem.h"
 
 
 UStartListenServer::UStartListenServer(const FObjectInitializer& ObjectInitializer)
@@ -14,15 +17,23 @@ UStartListenServer::UStartListenServer(const FObjectInitializer& ObjectInitializ
 {
 }
 
-UStartListenServer* UStartListenServer::StartListenServer(UObject* WorldContextObject)
+UStartListenServer* UStartListenServer::StartListenServer(UObject* WorldContextObject, const int32 Quorum, const float Timeout, const bool bAllowLateJoin, const bool bSkipHostElection, const int32 MinPlayersOnTimeout)
 {
 	UStartListenServer* Proxy = NewObject<UStartListenServer>();
 	Proxy->World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	Proxy->JoinPolicy.Quorum = Quorum;
+	Proxy->JoinPolicy.Timeout = Timeout;
+	Proxy->JoinPolicy.bAllowLateJoin = bAllowLateJoin;
+	Proxy->JoinPolicy.MinPlayersOnTimeout = MinPlayersOnTimeout;
+	if(MinPlayersOnTimeout < 0) GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("JoinMinPlayersOnTimeout"), Proxy->JoinPolicy.MinPlayersOnTimeout, GGameIni);
+	Proxy->bElectedHost = bSkipHostElection;
 	return Proxy;
 }
 
 void UStartListenServer::Activate()
 {
+	ActivateTime = FPlatformTime::Seconds();
+	
 	// Check if using correct GameMode.
 	const AMultiplayerGameMode* MultiplayerGameMode = Cast<AMultiplayerGameMode>(World->GetAuthGameMode());
 	if(!MultiplayerGameMode)
@@ -31,46 +42,40 @@ void UStartListenServer::Activate()
 		OnFailure.Broadcast(); // todo error message
 		return;
 	}
-	
-	FHttpModule* Http = &FHttpModule::Get();
-	if(!Http || !Http->IsHttpEnabled())
-	{
-		OnFailure.Broadcast(); // todo error message
-		return;
-	}
-
-	// Get public address.
-	const auto Request = Http->CreateRequest();
-	Request->SetURL("http://api.ipify.org");
-	Request->SetHeader("Content-Type" ,"text/html");
-	Request->SetTimeout(10); // todo, enum state member variable so that this can't get called multiple times while a request is busy.
-	Request->OnProcessRequestComplete().BindUObject(this, &UStartListenServer::OnHttpRequestCompleted);
-	
-	if (!Request->ProcessRequest())
-	{
-		OnFailure.Broadcast(); // todo error message
-	}
-}
 
-void UStartListenServer::OnHttpRequestCompleted(TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> Request, TSharedPtr<IHttpResponse, ESPMode::ThreadSafe> Response, const bool bWasSuccessful)
-{
-	if(!bWasSuccessful)
+	// Another member may have a better connection to host, in which case the ownership is transferred and that member starts the server instead.
+	const ULobbySubsystem* LobbySubsystem = World->GetGameInstance()->GetSubsystem<ULobbySubsystem>();
+	UHostElectionSubsystem* HostElectionSubsystem = World->GetGameInstance()->GetSubsystem<UHostElectionSubsystem>();
+	if(LobbySubsystem->ActiveLobby() && HostElectionSubsystem->IsElectionEnabled() && !bElectedHost)
 	{
-		UE_LOG(LogTemp, Error, TEXT("UStartListenServer::OnHttpRequestCompleted has failed with an unknown error."));
-		OnFailure.Broadcast();
-		return;
+		if(const FString ElectedHost = HostElectionSubsystem->RunElection(); !ElectedHost.IsEmpty() && ElectedHost != LobbySubsystem->GetLobby().OwnerID)
+		{
+			HostElectionSubsystem->TransferHost(ElectedHost, [this](const bool bSuccess)
+			{
+				if(bSuccess) OnHostTransferred.Broadcast();
+				else
+				{
+					// Host it ourselves after all.
+					UE_LOG(LogTemp, Warning, TEXT("Failed to transfer the host to the elected member, hosting locally instead."));
+					bElectedHost = true;
+					Activate();
+				}
+			});
+			return;
+		}
 	}
 	
-	ResponseString = Response.Get()->GetContentAsString();
-	if(ResponseString.IsEmpty())
-	{
-		UE_LOG(LogTemp, Error, TEXT("UStartListenServer::OnHttpRequestCompleted has returned an empty ResponseString for the Server-Address."));
-		OnFailure.Broadcast();
-		return;
-	}
+	// Make sure the public address is being looked up while traveling, if it is not cached already.
+	FPublicAddressCache::Get().Refresh();
+
+	// Let lobby members start loading the map while the server is starting. When the map was pre-warmed, the travel reuses its resident world.
+	UMapPreloadSubsystem* MapPreloadSubsystem = World->GetGameInstance()->GetSubsystem<UMapPreloadSubsystem>();
+	MapName = MapPreloadSubsystem->GetListenServerMap();
+	bMapPrewarmed = MapPreloadSubsystem->IsPreloadComplete() && MapPreloadSubsystem->GetPreloadedMapName() == MapName;
+	MapPreloadSubsystem->AnnounceMap(MapName);
 	
 	StartServerCompleteDelegateHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ThisClass::ServerStarted);
-	World->ServerTravel("/Game/Maps/MainMenu?listen");
+	World->ServerTravel(MapName + "?listen");
 }
 
 void UStartListenServer::ServerStarted(UWorld* NewWorld)
@@ -80,33 +85,19 @@ void UStartListenServer::ServerStarted(UWorld* NewWorld)
 	// We loaded into a copy of the level we were in, so the world is also different now.
 	World = NewWorld;
 
-	UE_LOG(LogTemp, Log, TEXT("Game server has started."));
+	ListeningTime = FPlatformTime::Seconds() - ActivateTime;
+	UE_LOG(LogTemp, Log, TEXT("Game server has started, listening after %.2fs (map pre-warmed: %s)."), ListeningTime, bMapPrewarmed ? TEXT("true") : TEXT("false"));
 	
 	const UGameInstance* GameInstance = NewWorld->GetGameInstance();
 	ULobbySubsystem* LobbySubsystem = GameInstance->GetSubsystem<ULobbySubsystem>();
 	
 	if(LobbySubsystem->ActiveLobby())
 	{
-		// If only in a lobby, then set the address attribute on the lobby so that they can join.
-		UE_LOG(LogTemp, Log, TEXT("Requesting lobby members to join server..."));
-	
-		// Set public address attribute on lobby.
-		FLobbyAttribute ServerAddressAttribute;
-		ServerAddressAttribute.Key = "ServerAddress";
-		ServerAddressAttribute.Type = ELobbyAttributeType::String;
-		ServerAddressAttribute.StringValue = ResponseString;
-		LobbySubsystem->SetAttribute(ServerAddressAttribute, [this, NewWorld, LobbySubsystem](const bool bSuccess)
+		// The lookup has been running during the travel, so it is usually done by now.
+		TWeakObjectPtr<UStartListenServer> WeakThis(this);
+		FPublicAddressCache::Get().ResolveAddress([WeakThis, LobbySubsystem](const FString& Address)
 		{
-			if(bSuccess)
-			{
-				WaitForPlayersToJoin(LobbySubsystem);
-			}
-			else
-			{
-				// Stop hosting.
-				UE_LOG(LogTemp, Error, TEXT("Failed to set the 'ServerAddressAttribute' on the lobby. Players cannot join without it."));
-				StopServer();
-			}
+			if(WeakThis.IsValid()) WeakThis->OnServerAddressResolved(Address, LobbySubsystem);
 		});
 	}
 	else
@@ -115,57 +106,130 @@ void UStartListenServer::ServerStarted(UWorld* NewWorld)
 	}
 }
 
-void UStartListenServer::WaitForPlayersToJoin(ULobbySubsystem* LobbySubsystem)
+void UStartListenServer::OnServerAddressResolved(const FString& Address, ULobbySubsystem* LobbySubsystem)
 {
-	const TArray<UOnlineUser*> LobbyMembers = LobbySubsystem->GetLobby().GetMemberList();
-
-	if(!LobbyMembers.Num())
+	if(Address.IsEmpty())
 	{
-		UE_LOG(LogTemp, Log, TEXT("No players in lobby, starting game alone."));
-		OnSuccess.Broadcast();
+		UE_LOG(LogTemp, Error, TEXT("Failed to resolve the Server-Address. Players cannot join without it."));
+		StopServer();
 		return;
 	}
+	ServerAddress = Address;
 
-	UE_LOG(LogTemp, Log, TEXT("Waiting for members to join..."));
+	// Start waiting before the members are requested to join, so that fast joiners are not missed.
+	if(!WaitForPlayersToJoin(LobbySubsystem)) return;
+	
+	// If only in a lobby, then set the address attribute on the lobby so that they can join.
+	UE_LOG(LogTemp, Log, TEXT("Requesting lobby members to join server..."));
+
+	// Set public address attribute on lobby.
+	FLobbyAttribute ServerAddressAttribute;
+	ServerAddressAttribute.Key = "ServerAddress";
+	ServerAddressAttribute.Type = ELobbyAttributeType::String;
+	ServerAddressAttribute.StringValue = ServerAddress;
+	LobbySubsystem->SetAttribute(ServerAddressAttribute, [this](const bool bSuccess)
+	{
+		if(bSuccess || !JoinBarrier.IsValid()) return;
+		
+		// Stop hosting.
+		UE_LOG(LogTemp, Error, TEXT("Failed to set the 'ServerAddressAttribute' on the lobby. Players cannot join without it."));
+		JoinBarrier->Cancel();
+	});
+}
+
+bool UStartListenServer::WaitForPlayersToJoin(ULobbySubsystem* LobbySubsystem)
+{
+	AMultiplayerGameMode* MultiplayerGameMode = Cast<AMultiplayerGameMode>(World->GetAuthGameMode());
+	if(!MultiplayerGameMode)
+	{
+		UE_LOG(LogTemp, Error, TEXT("GameMode used is not of type 'AMultiplayerGameMode', please derive your custom GameMode from this base class."));
+		StopServer();
+		return false;
+	}
 
-	// Retrieve the local PlayerState and attempt to cast it to AMultiplayerPlayerState
-	APlayerState* LocalPlayerState = World->GetFirstPlayerController()->PlayerState;
-	World->GetFirstPlayerController()->PlayerState;
+	// Every lobby member except the host is expected to join.
+	const FString LocalProductUserID = World->GetGameInstance()->GetSubsystem<ULocalUserSubsystem>()->GetLocalUser()->GetProductUserID();
+	TArray<FString> ExpectedMembers;
+	for(UOnlineUser* Member : LobbySubsystem->GetLobby().GetMemberList())
+	{
+		if(Member && Member->GetProductUserID() != LocalProductUserID) ExpectedMembers.Add(Member->GetProductUserID());
+	}
 
-	if(AMultiplayerPlayerState* MultiplayerPlayerState = Cast<AMultiplayerPlayerState>(LocalPlayerState))
+	JoinBarrier = MakeUnique<FJoinBarrier>(ExpectedMembers, JoinPolicy);
+	JoinBarrier->OnProgressDelegate.AddWeakLambda(this, [this](const int32 Arrived, const int32 Expected)
 	{
-		JoinedMembers.Empty();
-		
-		// Bind to the delegate
-		OnPlayerProductIDSetDelegateHandle = MultiplayerPlayerState->OnPlayerProductIDSetDelegate.AddLambda([&, MultiplayerPlayerState](const FString& ProductUserID)
-		{
-			JoinedMembers.Add(ProductUserID);
+		OnProgress.Broadcast(Arrived, Expected);
+	});
+	JoinBarrier->OnCompleteDelegate.AddUObject(this, &ThisClass::OnJoinBarrierComplete);
 
-			// todo also check if Lobby member(s) have left during this async operation.
-			if(JoinedMembers.Num() == LobbyMembers.Num())
-			{
-				UE_LOG(LogTemp, Log, TEXT("All members have joined the game server successfully."));
-				MultiplayerPlayerState->OnPlayerProductIDSetDelegate.Remove(OnPlayerProductIDSetDelegateHandle);
-				
-				World->GetTimerManager().ClearTimer(TimeoutTimerHandle);
-				OnSuccess.Broadcast();
-			}
-		});
+	// Arrivals come from the game-mode, and members that leave the lobby in the meantime are no longer waited for.
+	PlayerJoinedDelegateHandle = MultiplayerGameMode->OnPlayerJoinedDelegate.AddWeakLambda(this, [this](const FString& ProductUserID)
+	{
+		if(JoinBarrier.IsValid()) JoinBarrier->Arrive(ProductUserID);
+	});
+	LobbyUserLeftDelegateHandle = LobbySubsystem->OnLobbyUserLeftDelegate.AddWeakLambda(this, [this](const FString& ProductUserID)
+	{
+		if(JoinBarrier.IsValid()) JoinBarrier->RemoveExpected(ProductUserID);
+	});
 
-		// Timer for a timeout failure case
-		World->GetTimerManager().SetTimer(TimeoutTimerHandle, [&, MultiplayerPlayerState]()
+	// Late arrivals are tracked until the server's world goes away.
+	WorldCleanupDelegateHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &ThisClass::OnWorldCleanup);
+	
+	// Players that are already in the game count as arrived.
+	for(const APlayerState* PlayerState : World->GetGameState()->PlayerArray)
+	{
+		if(const AMultiplayerPlayerState* MultiplayerPlayerState = Cast<AMultiplayerPlayerState>(PlayerState); MultiplayerPlayerState && !MultiplayerPlayerState->ProductUserID.IsEmpty())
 		{
-			UE_LOG(LogTemp, Log, TEXT("Failed to start server because some members failed to join."));
-			MultiplayerPlayerState->OnPlayerProductIDSetDelegate.Remove(OnPlayerProductIDSetDelegateHandle);
-			StopServer();
-			
-		}, TimeoutDuration, false);
+			JoinBarrier->Arrive(MultiplayerPlayerState->ProductUserID);
+		}
 	}
-	else
+	
+	JoinBarrier->Start();
+	return true;
+}
+
+void UStartListenServer::OnJoinBarrierComplete(const EJoinBarrierResult Result)
+{
+	switch (Result)
 	{
-		UE_LOG(LogTemp, Error, TEXT("PlayerState used is not of type 'AMultiplayerPlayerState', please derive your custom PlayerState from this base class."));
+	case EJoinBarrierResult::AllJoined:
+		UE_LOG(LogTemp, Log, TEXT("All members have joined the game server successfully."));
+		break;
+	case EJoinBarrierResult::QuorumReached:
+		UE_LOG(LogTemp, Log, TEXT("Enough members have joined the game server, starting without: [%s]"), *FString::Join(JoinBarrier->GetMissing(), TEXT(", ")));
+		break;
+	default:
+		UE_LOG(LogTemp, Log, TEXT("Failed to start server because some members failed to join."));
+		World->GetTimerManager().SetTimerForNextTick(this, &ThisClass::ClearJoinBarrier);
 		StopServer();
+		return;
 	}
+
+	// Keep tracking stragglers, they can still join the running game. The barrier is broadcasting, so clear it on the next tick.
+	if(!JoinPolicy.bAllowLateJoin) World->GetTimerManager().SetTimerForNextTick(this, &ThisClass::ClearJoinBarrier);
+	OnSuccess.Broadcast();
+}
+
+void UStartListenServer::ClearJoinBarrier()
+{
+	if(World)
+	{
+		if(AMultiplayerGameMode* MultiplayerGameMode = Cast<AMultiplayerGameMode>(World->GetAuthGameMode()))
+		{
+			MultiplayerGameMode->OnPlayerJoinedDelegate.Remove(PlayerJoinedDelegateHandle);
+		}
+		if(ULobbySubsystem* LobbySubsystem = World->GetGameInstance()->GetSubsystem<ULobbySubsystem>())
+		{
+			LobbySubsystem->OnLobbyUserLeftDelegate.Remove(LobbyUserLeftDelegateHandle);
+		}
+	}
+	FWorldDelegates::OnWorldCleanup.Remove(WorldCleanupDelegateHandle);
+	JoinBarrier.Reset();
+}
+
+void UStartListenServer::OnWorldCleanup(UWorld* CleanedWorld, bool bSessionEnded, bool bCleanupResources)
+{
+	if(CleanedWorld == World) ClearJoinBarrier();
 }
 
 /*
@@ -2,8 +2,14 @@
 
 #include "OnlineMultiplayer.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/CoreDelegates.h"
 #include "SteamManager.h"
 #include "EOSManager.h"
+#include "Utils/PublicAddressCache.h"
+#include "Utils/EosLogSink.h"
+#include "Utils/BootTimeline.h"
+#include "Utils/UserProfileCache.h"
+#include "Utils/StubOnline.h"
 
 
 /**
@@ -13,16 +19,42 @@ void FOnlineMultiplayer::StartupModule()
 {
 	UE_LOG(LogTemp, Warning, TEXT("FOnlineMultiplayer::StartupModule"));
 	
-	// Initialize the Steamworks SDK.
-	FSteamManager::Get().Initialize();
+	// Neither SDK is used when the online services are stubbed, the game-instance completes the startup with fake results.
+	if(!FStubOnline::IsEnabled())
+	{
+		// Initialize the Steamworks SDK.
+		{
+			BOOT_TIMELINE_SCOPE("SteamInitialize");
+			FSteamManager::Get().Initialize();
+		}
 
-	// Initialize the EOS SDK.
-	FEosManager::Get().Initialize();
+		// Initialize the EOS SDK.
+		{
+			BOOT_TIMELINE_SCOPE("EosInitialize");
+			FEosManager::Get().Initialize();
+		}
+	}
+
+	FCoreDelegates::OnPostEngineInit.AddLambda([]()
+	{
+		// Map the persisted user profiles, so users seen in an earlier launch are shown before they are fetched again.
+		// Validated on the thread pool, which does not exist yet while the module starts up at PostConfigInit.
+		FUserProfileCache::Get().Initialize();
+		
+		// Start looking up the public address early, so hosting a server does not have to wait for it.
+		FPublicAddressCache::Get().Initialize();
+	});
 }
 
 void FOnlineMultiplayer::ShutdownModule()
 {
-	FSteamManager::Get().DeInitialize();
+	if(!FStubOnline::IsEnabled()) FSteamManager::Get().DeInitialize();
+
+	// Persist the profiles of the users seen this launch.
+	FUserProfileCache::Get().Shutdown();
+
+	// Write the EOS logs that are still queued.
+	FEosLogSink::Get().Shutdown();
 }
 
 IMPLEMENT_MODULE(FOnlineMultiplayer, OnlineMultiplayer)
@@ -1,6 +1,7 @@
 ﻿// Copyright © 2023 Melvin Brink
 
 #include "SteamManager.h"
+#include "Utils/SteamCallbackDispatcher.h"
 
 #pragma warning(push)
 #pragma warning(disable: 4996)
@@ -24,7 +25,7 @@ FSteamManager::FSteamManager()
 
 void FSteamManager::Tick(float DeltaTime)
 {
-	SteamAPI_RunCallbacks();
+	FSteamCallbackDispatcher::Get().RunFrame();
 }
 
 bool FSteamManager::IsTickable() const
@@ -68,9 +69,12 @@ void FSteamManager::Initialize()
 	
 	UE_LOG(LogSteamManager, Log, TEXT("Steamworks SDK Initialized"));
 	SteamUtils()->SetWarningMessageHook(SteamAPIDebugMessageHook);
+
+	FSteamCallbackDispatcher::Get().Initialize();
 }
 
 void FSteamManager::DeInitialize()
 {
+	FSteamCallbackDispatcher::Get().Shutdown();
 	if (SteamAPI_Init()) SteamAPI_Shutdown();
 }
\ No newline at end of file
@@ -28,45 +28,160 @@ void UAuthSubsystem::Login()
 {
 	// TODO: Also check if user is already logged in. Would prevent api call.
 	if(!AuthHandle) return;
-	
-	LocalUserSubsystem->RequestSteamSessionTicket([this](const std::string& TicketString)
+
+	LoginWithPersistentAuth([this](const bool bSuccess)
 	{
-		EOS_Auth_Credentials Credentials;
-		Credentials.ApiVersion = EOS_AUTH_CREDENTIALS_API_LATEST;
-		Credentials.Type = EOS_ELoginCredentialType::EOS_LCT_ExternalAuth;
-		Credentials.ExternalType = EOS_EExternalCredentialType::EOS_ECT_STEAM_SESSION_TICKET;
-		Credentials.Token = TicketString.c_str();
+		if(bSuccess)
+		{
+			OnAuthLoginCompleteDelegate.Broadcast(true);
+			return;
+		}
+		
+		LocalUserSubsystem->RequestSteamSessionTicket([this](const std::string& TicketString)
+		{
+			LoginWithSteamSessionTicket(TicketString);
+		});
+	});
+}
+
+struct FPersistentAuthClientData
+{
+	UAuthSubsystem* Self;
+	TFunction<void(bool bSuccess)> Callback;
+};
+
+/**
+ * Logs in with the refresh token that the SDK kept from the last login, which skips the Steam ticket exchange and the account linking.
+ * On desktop the SDK keeps this token in the keychain of the user, which is why no ID or token is passed.
+ *
+ * A token that is no longer valid is deleted, so the next launch does not try it again.
+ *
+ * @param Callback called with false when there is no valid token. Does not broadcast OnAuthLoginCompleteDelegate, the caller falls back to the ticket.
+ */
+void UAuthSubsystem::LoginWithPersistentAuth(TFunction<void(bool bSuccess)>&& Callback)
+{
+	if(!AuthHandle)
+	{
+		Callback(false);
+		return;
+	}
 	
-		EOS_Auth_LoginOptions Options;
-		Options.ApiVersion = EOS_AUTH_LOGIN_API_LATEST;
-		Options.Credentials = &Credentials;
-		Options.ScopeFlags = EOS_EAuthScopeFlags::EOS_AS_BasicProfile | EOS_EAuthScopeFlags::EOS_AS_FriendsList | EOS_EAuthScopeFlags::EOS_AS_Presence; // This is checked using bitwise operation. Which is why the enums are multiple of 2.
+	EOS_Auth_Credentials Credentials = {};
+	Credentials.ApiVersion = EOS_AUTH_CREDENTIALS_API_LATEST;
+	Credentials.Type = EOS_ELoginCredentialType::EOS_LCT_PersistentAuth;
+	Credentials.Id = nullptr;
+	Credentials.Token = nullptr;
 	
-		EOS_Auth_Login(AuthHandle, &Options, this, OnLoginComplete);
+	EOS_Auth_LoginOptions Options = {};
+	Options.ApiVersion = EOS_AUTH_LOGIN_API_LATEST;
+	Options.Credentials = &Credentials;
+	Options.ScopeFlags = EOS_EAuthScopeFlags::EOS_AS_BasicProfile | EOS_EAuthScopeFlags::EOS_AS_FriendsList | EOS_EAuthScopeFlags::EOS_AS_Presence;
+
+	FPersistentAuthClientData* ClientData = new FPersistentAuthClientData{this, MoveTemp(Callback)};
+	EosManager->BeginAsyncOperation();
+	EOS_Auth_Login(AuthHandle, &Options, ClientData, [](const EOS_Auth_LoginCallbackInfo* Data)
+	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+		const FPersistentAuthClientData* ClientData = static_cast<FPersistentAuthClientData*>(Data->ClientData);
+		UAuthSubsystem* AuthSubsystem = ClientData->Self;
+		const TFunction<void(bool)> Callback = ClientData->Callback;
+		delete ClientData;
+		
+		if(Data->ResultCode == EOS_EResult::EOS_Success)
+		{
+			UE_LOG(LogAuthSubsystem, Log, TEXT("Logged in to the Auth-Interface with the persisted login."));
+			AuthSubsystem->LocalUserSubsystem->GetLocalUser()->SetEpicAccountID(EosAccountIDToString(Data->LocalUserId));
+			Callback(true);
+			return;
+		}
+		
+		UE_LOG(LogAuthSubsystem, Log, TEXT("No persisted login to the Auth-Interface: [%hs]"), EOS_EResult_ToString(Data->ResultCode));
+		if(Data->ResultCode == EOS_EResult::EOS_InvalidAuth ||
+		   Data->ResultCode == EOS_EResult::EOS_Auth_InvalidRefreshToken ||
+		   Data->ResultCode == EOS_EResult::EOS_Auth_InvalidToken)
+		{
+			EOS_Auth_DeletePersistentAuthOptions DeleteOptions = {};
+			DeleteOptions.ApiVersion = EOS_AUTH_DELETEPERSISTENTAUTH_API_LATEST;
+			DeleteOptions.RefreshToken = nullptr; // Kept by the SDK on desktop.
+			EOS_Auth_DeletePersistentAuth(AuthSubsystem->AuthHandle, &DeleteOptions, nullptr, [](const EOS_Auth_DeletePersistentAuthCallbackInfo* DeleteData)
+			{
+				if(DeleteData->ResultCode != EOS_EResult::EOS_Success) UE_LOG(LogAuthSubsystem, Warning, TEXT("Failed to delete the persisted login: [%hs]"), EOS_EResult_ToString(DeleteData->ResultCode));
+			});
+		}
+		Callback(false);
 	});
 }
 
+/**
+ * Logs in with a session ticket that has already been requested, so the Connect login can use the same ticket at the same time.
+ */
+void UAuthSubsystem::LoginWithSteamSessionTicket(const std::string& TicketString)
+{
+	if(!AuthHandle)
+	{
+		OnAuthLoginCompleteDelegate.Broadcast(false);
+		return;
+	}
+	
+	EOS_Auth_Credentials Credentials = {};
+	Credentials.ApiVersion = EOS_AUTH_CREDENTIALS_API_LATEST;
+	Credentials.Type = EOS_ELoginCredentialType::EOS_LCT_ExternalAuth;
+	Credentials.ExternalType = EOS_EExternalCredentialType::EOS_ECT_STEAM_SESSION_TICKET;
+	Credentials.Token = TicketString.c_str();
+	
+	EOS_Auth_LoginOptions Options = {};
+	Options.ApiVersion = EOS_AUTH_LOGIN_API_LATEST;
+	Options.Credentials = &Credentials;
+	Options.ScopeFlags = EOS_EAuthScopeFlags::EOS_AS_BasicProfile | EOS_EAuthScopeFlags::EOS_AS_FriendsList | EOS_EAuthScopeFlags::EOS_AS_Presence; // This is checked using bitwise operation. Which is why the enums are multiple of 2.
+	
+	LocalUserSubsystem->AcquireSteamSessionTicket();
+	EosManager->BeginAsyncOperation();
+	EOS_Auth_Login(AuthHandle, &Options, this, OnLoginComplete);
+}
+
+/**
+ * Uses the login that is still active on the platform, which outlives the game-instance.
+ *
+ * @return True when the user is still logged in, and no new login is needed.
+ */
+bool UAuthSubsystem::RestoreLogin()
+{
+	if(!AuthHandle || EOS_Auth_GetLoggedInAccountsCount(AuthHandle) == 0) return false;
+
+	const EOS_EpicAccountId EpicAccountId = EOS_Auth_GetLoggedInAccountByIndex(AuthHandle, 0);
+	if(EOS_Auth_GetLoginStatus(AuthHandle, EpicAccountId) != EOS_ELoginStatus::EOS_LS_LoggedIn) return false;
+
+	UE_LOG(LogAuthSubsystem, Log, TEXT("Restored the login to the Auth-Interface."));
+	LocalUserSubsystem->GetLocalUser()->SetEpicAccountID(EosAccountIDToString(EpicAccountId));
+	return true;
+}
+
 void UAuthSubsystem::OnLoginComplete(const EOS_Auth_LoginCallbackInfo* Data)
 {
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 	UAuthSubsystem* AuthSubsystem = static_cast<UAuthSubsystem*>(Data->ClientData);
 	if(!AuthSubsystem) return;
-	const ULocalUserSubsystem* LocalUserSubsystem = AuthSubsystem->LocalUserSubsystem;
+	ULocalUserSubsystem* LocalUserSubsystem = AuthSubsystem->LocalUserSubsystem;
+	LocalUserSubsystem->ReleaseSteamSessionTicket();
 	
 	if(Data->ResultCode == EOS_EResult::EOS_Success)
 	{
 		// Login was successful. We can now use the Auth interface.
 		LocalUserSubsystem->GetLocalUser()->SetEpicAccountID(EosAccountIDToString(Data->LocalUserId));
+		AuthSubsystem->OnAuthLoginCompleteDelegate.Broadcast(true);
 	}
 	else if(Data->ResultCode == EOS_EResult::EOS_Auth_ExternalAuthNotLinked ||
 			Data->ResultCode == EOS_EResult::EOS_InvalidUser)
 	{
 		// Open the login overlay. The user can now login with their Epic account, or create a new one.
-		LocalUserSubsystem->GetLocalUser()->SetContinuanceToken(Data->ContinuanceToken);
+		// The token is kept on this subsystem, the Connect login may be using its own continuance-token at the same time.
+		AuthSubsystem->EosContinuanceToken = Data->ContinuanceToken;
 		AuthSubsystem->LinkUserAuth();
 	}
 	else
 	{
 		UE_LOG(LogAuthSubsystem, Error, TEXT("LoginAuth failed with error code %d"), Data->ResultCode);
+		AuthSubsystem->OnAuthLoginCompleteDelegate.Broadcast(false);
 	}
 }
 
@@ -88,10 +203,12 @@ void UAuthSubsystem::LinkUserAuth()
 	Options.ApiVersion = EOS_AUTH_LINKACCOUNT_API_LATEST;
 	Options.LinkAccountFlags = EOS_ELinkAccountFlags::EOS_LA_NoFlags;
 	Options.LocalUserId = nullptr;
-	Options.ContinuanceToken = LocalUserSubsystem->GetLocalUser()->GetContinuanceToken();
+	Options.ContinuanceToken = EosContinuanceToken;
 	
+	EosManager->BeginAsyncOperation();
 	EOS_Auth_LinkAccount(AuthHandle, &Options, this, [](const EOS_Auth_LinkAccountCallbackInfo* Data)
 	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		UAuthSubsystem* AuthSubsystem = static_cast<UAuthSubsystem*>(Data->ClientData);
 		if(!AuthSubsystem) return;
 		
@@ -103,10 +220,12 @@ void UAuthSubsystem::LinkUserAuth()
 		else if(Data->ResultCode == EOS_EResult::EOS_Canceled)
 		{
 			// User canceled the login process.
+			AuthSubsystem->OnAuthLoginCompleteDelegate.Broadcast(false);
 		}
 		else
 		{
 			UE_LOG(LogAuthSubsystem, Error, TEXT("LinkAccount failed with error code %d"), Data->ResultCode);
+			AuthSubsystem->OnAuthLoginCompleteDelegate.Broadcast(false);
 		}
 	});
 }
\ No newline at end of file
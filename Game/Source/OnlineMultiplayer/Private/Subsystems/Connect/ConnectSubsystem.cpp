@@ -7,6 +7,7 @@
 #include "eos_connect.h"
 #include "Helpers.h"
 #include "Subsystems/User/Online/SteamOnlineUserSubsystem.h"
+#include "UObject/StrongObjectPtr.h"
 
 
 void UConnectSubsystem::Initialize(FSubsystemCollectionBase& Collection)
@@ -20,8 +21,21 @@ void UConnectSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
 	if(!PlatformHandle) return;
 	ConnectHandle = EOS_Platform_GetConnectInterface(PlatformHandle);
+
+	EOS_Connect_AddNotifyAuthExpirationOptions AuthExpirationOptions = {};
+	AuthExpirationOptions.ApiVersion = EOS_CONNECT_ADDNOTIFYAUTHEXPIRATION_API_LATEST;
+	AuthExpirationNotificationId = EOS_Connect_AddNotifyAuthExpiration(ConnectHandle, &AuthExpirationOptions, this, OnAuthExpiration);
+}
+
+void UConnectSubsystem::Deinitialize()
+{
+	if(ConnectHandle && AuthExpirationNotificationId != EOS_INVALID_NOTIFICATIONID)
+	{
+		EOS_Connect_RemoveNotifyAuthExpiration(ConnectHandle, AuthExpirationNotificationId);
+		AuthExpirationNotificationId = EOS_INVALID_NOTIFICATIONID;
+	}
 	
-	Login();
+	Super::Deinitialize();
 }
 
 
@@ -38,21 +52,60 @@ void UConnectSubsystem::Login()
 	
 	LocalUserSubsystem->RequestSteamSessionTicket([this](const std::string& TicketString)
 	{
-		EOS_Connect_Credentials Credentials;
-		Credentials.ApiVersion = EOS_CONNECT_CREDENTIALS_API_LATEST;
-		Credentials.Type = EOS_EExternalCredentialType::EOS_ECT_STEAM_SESSION_TICKET;
-		// Credentials.Type = EOS_EExternalCredentialType::EOS_ECT_STEAM_APP_TICKET;
-		Credentials.Token = TicketString.c_str();
-
-		EOS_Connect_LoginOptions Options;
-		Options.ApiVersion = EOS_CONNECT_LOGIN_API_LATEST;
-		Options.Credentials = &Credentials;
-		Options.UserLoginInfo = nullptr;
-
-		EOS_Connect_Login(ConnectHandle, &Options, this, OnLoginComplete);
+		LoginWithSteamSessionTicket(TicketString);
 	});
 }
 
+/**
+ * Logs in with a session ticket that has already been requested, used by the startup graph to request the ticket in parallel.
+ */
+void UConnectSubsystem::LoginWithSteamSessionTicket(const std::string& TicketString)
+{
+	EOS_Connect_Credentials Credentials;
+	Credentials.ApiVersion = EOS_CONNECT_CREDENTIALS_API_LATEST;
+	Credentials.Type = EOS_EExternalCredentialType::EOS_ECT_STEAM_SESSION_TICKET;
+	// Credentials.Type = EOS_EExternalCredentialType::EOS_ECT_STEAM_APP_TICKET;
+	Credentials.Token = TicketString.c_str();
+
+	EOS_Connect_LoginOptions Options;
+	Options.ApiVersion = EOS_CONNECT_LOGIN_API_LATEST;
+	Options.Credentials = &Credentials;
+	Options.UserLoginInfo = nullptr;
+
+	LocalUserSubsystem->AcquireSteamSessionTicket();
+	EosManager->BeginAsyncOperation();
+	EOS_Connect_Login(ConnectHandle, &Options, this, OnLoginComplete);
+}
+
+/**
+ * Uses the login that is still active on the platform, which outlives the game-instance. For example when restarting PIE.
+ *
+ * @return True when the user is still logged in, and no new login is needed.
+ */
+bool UConnectSubsystem::RestoreLogin()
+{
+	if(!ConnectHandle || EOS_Connect_GetLoggedInUsersCount(ConnectHandle) == 0) return false;
+	
+	const EOS_ProductUserId ProductUserId = EOS_Connect_GetLoggedInUserByIndex(ConnectHandle, 0);
+	if(EOS_Connect_GetLoginStatus(ConnectHandle, ProductUserId) != EOS_ELoginStatus::EOS_LS_LoggedIn) return false;
+
+	UE_LOG(LogConnectSubsystem, Log, TEXT("Restored the login to the Connect-Interface."))
+	LocalUserSubsystem->GetLocalUser()->SetProductUserID(EosProductIDToString(ProductUserId));
+	return true;
+}
+
+/**
+ * Called about ten minutes before the login expires. Logs in again with the cached session ticket.
+ */
+void UConnectSubsystem::OnAuthExpiration(const EOS_Connect_AuthExpirationCallbackInfo* Data)
+{
+	UConnectSubsystem* ConnectSubsystem = static_cast<UConnectSubsystem*>(Data->ClientData);
+	if(!ConnectSubsystem) return;
+
+	UE_LOG(LogConnectSubsystem, Log, TEXT("Login to the Connect-Interface is about to expire, refreshing."))
+	ConnectSubsystem->Login();
+}
+
 void UConnectSubsystem::Logout()
 {
 	
@@ -60,7 +113,9 @@ void UConnectSubsystem::Logout()
 
 void UConnectSubsystem::OnLoginComplete(const EOS_Connect_LoginCallbackInfo* Data)
 {
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 	UConnectSubsystem* ConnectSubsystem = static_cast<UConnectSubsystem*>(Data->ClientData);
+	ConnectSubsystem->LocalUserSubsystem->ReleaseSteamSessionTicket();
 	ULocalUser* LocalUser = ConnectSubsystem->LocalUserSubsystem->GetLocalUser();
 	if (!LocalUser)
 	{
@@ -71,18 +126,29 @@ void UConnectSubsystem::OnLoginComplete(const EOS_Connect_LoginCallbackInfo* Dat
 	if (Data->ResultCode == EOS_EResult::EOS_Success)
 	{
 		UE_LOG(LogConnectSubsystem, Log, TEXT("Logged in to Connect-Interface."))
+		ConnectSubsystem->bRetriedWithNewTicket = false;
 		LocalUser->SetProductUserID(EosProductIDToString(Data->LocalUserId));
 		ConnectSubsystem->OnConnectLoginCompleteDelegate.Broadcast(true, LocalUser);
 	}
 	else if(Data->ResultCode == EOS_EResult::EOS_InvalidUser)
 	{
 		// Create a new account. But maybe check if the user wants to do this.
-		LocalUser->SetContinuanceToken(Data->ContinuanceToken);
+		ConnectSubsystem->EosContinuanceToken = Data->ContinuanceToken;
 		ConnectSubsystem->CreateNewUser();
 	}
+	else if(!ConnectSubsystem->bRetriedWithNewTicket)
+	{
+		// The cached session ticket may have been rejected, fall back to requesting a new one.
+		// The Auth login may still be using the old ticket, it is cancelled once that login completes.
+		UE_LOG(LogConnectSubsystem, Warning, TEXT("LoginConnect failed with error code %hs, retrying with a new session ticket."), EOS_EResult_ToString(Data->ResultCode));
+		ConnectSubsystem->bRetriedWithNewTicket = true;
+		ConnectSubsystem->LocalUserSubsystem->InvalidateSteamSessionTicket();
+		ConnectSubsystem->Login();
+	}
 	else
 	{
 		UE_LOG(LogConnectSubsystem, Error, TEXT("LoginConnect failed with error code %hs"), EOS_EResult_ToString(Data->ResultCode));
+		ConnectSubsystem->bRetriedWithNewTicket = false;
 		ConnectSubsystem->OnConnectLoginCompleteDelegate.Broadcast(false, nullptr);
 	}
 }
@@ -104,9 +170,11 @@ void UConnectSubsystem::CreateNewUser()
 {
 	EOS_Connect_CreateUserOptions CreateUserOptions;
 	CreateUserOptions.ApiVersion = EOS_CONNECT_CREATEUSER_API_LATEST;
-	CreateUserOptions.ContinuanceToken = LocalUserSubsystem->GetLocalUser()->GetContinuanceToken();
+	CreateUserOptions.ContinuanceToken = EosContinuanceToken;
+	EosManager->BeginAsyncOperation();
 	EOS_Connect_CreateUser(ConnectHandle, &CreateUserOptions, this, [](const EOS_Connect_CreateUserCallbackInfo* Data)
 	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		UConnectSubsystem* ConnectSubsystem = static_cast<UConnectSubsystem*>(Data->ClientData);
 		if(!ConnectSubsystem) return;
 		
@@ -132,8 +200,10 @@ void UConnectSubsystem::CheckAccounts()
 	QueryMappingsOptions.ProductUserIds = ProductUserIds;
 	QueryMappingsOptions.ProductUserIdCount = 1;
 
+	EosManager->BeginAsyncOperation();
 	EOS_Connect_QueryProductUserIdMappings(ConnectHandle, &QueryMappingsOptions, this,[](const EOS_Connect_QueryProductUserIdMappingsCallbackInfo* Data)
 	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		if(Data->ResultCode != EOS_EResult::EOS_Success)
 		{
 			UE_LOG(LogConnectSubsystem, Error, TEXT("QueryProductUserIdMappings failed with error code %hs"), EOS_EResult_ToString(Data->ResultCode));
@@ -164,187 +234,204 @@ void UConnectSubsystem::CheckAccounts()
 
 // --------------------------------------------
 
-struct FGetOnlineUserDetailsClientData
+/**
+ * Shared by all the chunks of a single GetOnlineUserDetails call.
+ */
+struct FGetOnlineUserDetailsState
 {
-	UConnectSubsystem* Self;
-	ULocalUserSubsystem* LocalUserSubsystem;
 	TArray<EOS_ProductUserId> UserIDs;
+	TArray<TStrongObjectPtr<UOnlineUser>> OnlineUsers; // Preallocated, same order as UserIDs. Stays empty for users that failed. Rooted until the callback.
+	
+	TArray<UOnlineUser*> GetOnlineUsers() const
+	{
+		TArray<UOnlineUser*> Users;
+		Users.Reserve(OnlineUsers.Num());
+		for (const TStrongObjectPtr<UOnlineUser>& OnlineUser : OnlineUsers) Users.Add(OnlineUser.Get());
+		return Users;
+	}
+	int32 ChunksLeft = 0;
+	int32 AvatarsLeft = 0;
 	TFunction<void(TArray<UOnlineUser*>)> Callback;
 };
 
+struct FGetOnlineUserDetailsClientData
+{
+	UConnectSubsystem* Self;
+	TSharedPtr<FGetOnlineUserDetailsState> State;
+	int32 Start;
+	int32 Count;
+};
+
+static EPlatform PlatformFromAccountType(const EOS_EExternalAccountType AccountType)
+{
+	switch (AccountType)
+	{
+		case EOS_EExternalAccountType::EOS_EAT_STEAM: return EPlatform::Steam;
+		case EOS_EExternalAccountType::EOS_EAT_PSN: return EPlatform::Psn;
+		case EOS_EExternalAccountType::EOS_EAT_XBL: return EPlatform::Xbox;
+		default: return EPlatform::Epic;
+	}
+}
+
 /**
  * Tries to get all the details for each given User-ID in the given list.
- * Callback returns the list of user's with their details.
+ * Callback returns the list of user's with their details, users that could not be found are left out.
+ *
+ * The IDs are queried in chunks of at most MaxUsersPerMappingQuery, which are all in flight at the same time.
  *
  * @param ProductUserIDList Product-User-IDs used to get the external-platforms of a user.
  * @param Callback The callback to call upon completion
  */
 void UConnectSubsystem::GetOnlineUserDetails(TArray<FString>& ProductUserIDList, const TFunction<void(TArray<UOnlineUser*> OutUserList)> &Callback)
 {
-	// Convert array UserIDs of type FString to new array of type EOS_ProductUserId
-	TArray<EOS_ProductUserId> ProductUserIDs;
-	ProductUserIDs.Reserve(ProductUserIDList.Num());
-	for (const FString& ID : ProductUserIDList)
+	if(ProductUserIDList.IsEmpty())
 	{
-		EOS_ProductUserId ProductUserID = EosProductIDFromString(ID);
-		ProductUserIDs.Add(ProductUserID);
+		Callback(TArray<UOnlineUser*>());
+		return;
 	}
-
-	// Properties needed in the callback
-	FGetOnlineUserDetailsClientData* ClientData = new FGetOnlineUserDetailsClientData();
-	ClientData->Self = this;
-	ClientData->UserIDs = ProductUserIDs;
-	ClientData->Callback = Callback;
-
-	// Options
-	EOS_Connect_QueryProductUserIdMappingsOptions Options;
-	Options.ApiVersion = EOS_CONNECT_QUERYPRODUCTUSERIDMAPPINGS_API_LATEST;
-	Options.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
-	Options.ProductUserIds = ProductUserIDs.GetData();
-	Options.ProductUserIdCount = ProductUserIDs.Num();
-
-	// Get the external account mappings from EOS
-	EOS_Connect_QueryProductUserIdMappings(ConnectHandle, &Options, ClientData, [](const EOS_Connect_QueryProductUserIdMappingsCallbackInfo* Data)
+	
+	// Convert array UserIDs of type FString to new array of type EOS_ProductUserId
+	const TSharedPtr<FGetOnlineUserDetailsState> State = MakeShared<FGetOnlineUserDetailsState>();
+	State->UserIDs.Reserve(ProductUserIDList.Num());
+	for (const FString& ID : ProductUserIDList) State->UserIDs.Add(EosProductIDFromString(ID));
+	State->OnlineUsers.SetNum(State->UserIDs.Num());
+	State->ChunksLeft = FMath::DivideAndRoundUp(State->UserIDs.Num(), MaxUsersPerMappingQuery);
+	State->Callback = Callback;
+
+	const EOS_ProductUserId LocalUserID = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	for (int32 Start = 0; Start < State->UserIDs.Num(); Start += MaxUsersPerMappingQuery)
 	{
-		// Cast the ClientData back to its type
-		const FGetOnlineUserDetailsClientData* CD = static_cast<FGetOnlineUserDetailsClientData*>(Data->ClientData);
-		const UConnectSubsystem* ConnectSubsystem = CD->Self;
-		const TArray<EOS_ProductUserId>& UserIDs = CD->UserIDs;
-		const TFunction<void(TArray<UOnlineUser*> OutUserList)> OnCompleteCallback = CD->Callback;
-		
-		if (Data->ResultCode != EOS_EResult::EOS_Success)
+		FGetOnlineUserDetailsClientData* ClientData = new FGetOnlineUserDetailsClientData();
+		ClientData->Self = this;
+		ClientData->State = State;
+		ClientData->Start = Start;
+		ClientData->Count = FMath::Min(MaxUsersPerMappingQuery, State->UserIDs.Num() - Start);
+
+		EOS_Connect_QueryProductUserIdMappingsOptions Options = {};
+		Options.ApiVersion = EOS_CONNECT_QUERYPRODUCTUSERIDMAPPINGS_API_LATEST;
+		Options.LocalUserId = LocalUserID;
+		Options.ProductUserIds = State->UserIDs.GetData() + Start; // The SDK copies the IDs before returning.
+		Options.ProductUserIdCount = ClientData->Count;
+
+		EosManager->BeginAsyncOperation();
+		EOS_Connect_QueryProductUserIdMappings(ConnectHandle, &Options, ClientData, [](const EOS_Connect_QueryProductUserIdMappingsCallbackInfo* Data)
 		{
-			UE_LOG(LogConnectSubsystem, Error, TEXT("EOS_Connect_QueryProductUserIdMappings failed with error code: [%d]"), Data->ResultCode);
-			OnCompleteCallback(TArray<UOnlineUser*>());
-			delete CD;
-			return;
-		}
-		
-		// Iterate over all the users we requested info for and set their properties with the new data
-		TArray<UOnlineUser*> OnlineUsers;
-		for(int32_t UserIndex = 0; UserIndex < UserIDs.Num(); UserIndex++)
-		{
-			const EOS_ProductUserId TargetUserID = UserIDs[UserIndex];
-			EOS_Connect_GetProductUserExternalAccountCountOptions ExternalAccountCountOptions;
-			ExternalAccountCountOptions.ApiVersion = EOS_CONNECT_GETPRODUCTUSEREXTERNALACCOUNTCOUNT_API_LATEST;
-			ExternalAccountCountOptions.TargetUserId = TargetUserID;
-
-			// Get the number of ExternalAccounts of this user
-			const int32_t AccountCount = EOS_Connect_GetProductUserExternalAccountCount(ConnectSubsystem->ConnectHandle, &ExternalAccountCountOptions);
-
-			// For determining the platform the user is using
-			EPlatform MostRecentPlatform = EPlatform::Epic;
-			int64_t MostRecentLoginTime = 0;
-
-			// Iterate over all the accounts for this user and add them to this list
-			TArray<FPlatformUser> ExternalPlatformUserList;
-			for (int32_t AccountIndex = 0; AccountIndex < AccountCount; ++AccountIndex)
+			FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+			const FGetOnlineUserDetailsClientData* ClientData = static_cast<FGetOnlineUserDetailsClientData*>(Data->ClientData);
+			UConnectSubsystem* ConnectSubsystem = ClientData->Self;
+			const TSharedPtr<FGetOnlineUserDetailsState> State = ClientData->State;
+			
+			if(Data->ResultCode == EOS_EResult::EOS_Success)
 			{
-				// Options
-				EOS_Connect_CopyProductUserExternalAccountByIndexOptions CopyOptions;
-				CopyOptions.ApiVersion = EOS_CONNECT_COPYPRODUCTUSEREXTERNALACCOUNTBYINDEX_API_LATEST;
-				CopyOptions.TargetUserId = TargetUserID;
-				CopyOptions.ExternalAccountInfoIndex = AccountIndex;
-
-				// Get the ExternalAccount data
-				EOS_Connect_ExternalAccountInfo* AccountInfo;
-				const EOS_EResult Result = EOS_Connect_CopyProductUserExternalAccountByIndex(ConnectSubsystem->ConnectHandle, &CopyOptions, &AccountInfo);
-				
-				if (Result == EOS_EResult::EOS_Success)
+				for (int32 Index = ClientData->Start; Index < ClientData->Start + ClientData->Count; ++Index)
 				{
-					// Create the platform-user with this received data
-					FPlatformUser ExternalPlatformUser;
-					ExternalPlatformUser.UserID = FString(AccountInfo->AccountId);
-					ExternalPlatformUser.Username = AccountInfo->DisplayName ? AccountInfo->DisplayName : "";
-					ExternalPlatformUser.LastLoginTime = AccountInfo->LastLoginTime;
-
-					// Set the platform to an UE friendly enum type
-					switch (AccountInfo->AccountIdType)
-					{
-						case EOS_EExternalAccountType::EOS_EAT_EPIC:
-							ExternalPlatformUser.Platform = EPlatform::Epic;
-							break;
-						case EOS_EExternalAccountType::EOS_EAT_STEAM:
-							ExternalPlatformUser.Platform = EPlatform::Steam;
-							break;
-						case EOS_EExternalAccountType::EOS_EAT_PSN:
-							ExternalPlatformUser.Platform = EPlatform::Psn;
-							break;
-						case EOS_EExternalAccountType::EOS_EAT_XBL:
-							ExternalPlatformUser.Platform = EPlatform::Xbox;
-							break;
-						default:
-							ExternalPlatformUser.Platform = EPlatform::Epic;
-					}
-
-					// Add this Platform-User to the list
-					ExternalPlatformUserList.Add(ExternalPlatformUser);
-
-					// Check if this platform has recently been logged in with, and use the most recent as the user's local-platform (which is not good but there is no alternative)
-					if (ExternalPlatformUser.LastLoginTime > MostRecentLoginTime)
-					{
-						MostRecentLoginTime = ExternalPlatformUser.LastLoginTime;
-						MostRecentPlatform = ExternalPlatformUser.Platform;
-					}
+					State->OnlineUsers[Index].Reset(ConnectSubsystem->CreateOnlineUser(State->UserIDs[Index]));
 				}
-				else
-					UE_LOG(LogConnectSubsystem, Error, TEXT("Failed to get external account info. Error code: [%hs]"), EOS_EResult_ToString(Result));
-
-				// Release the external account data from memory
-				EOS_Connect_ExternalAccountInfo_Release(AccountInfo);
 			}
+			else UE_LOG(LogConnectSubsystem, Error, TEXT("EOS_Connect_QueryProductUserIdMappings failed for %d user(s) with error code: [%hs]"), ClientData->Count, EOS_EResult_ToString(Data->ResultCode));
+			delete ClientData;
 
-			
-			// Create the Online-User and set its properties
-			UOnlineUser* OnlineUser = NewObject<UOnlineUser>();
-			OnlineUser->SetProductUserID(EosProductIDToString(TargetUserID));
-			OnlineUser->SetEpicAccountID(FString("")); // TODO: this line
-
-			// Add the external accounts to the ExternalPlatformUserMap on the Online-User, and set the Platform-User to the most recent external account
-			TMap<EPlatform, FPlatformUser> ExternalPlatformUserMap;
-			for (FPlatformUser PlatformUser : ExternalPlatformUserList)
-			{
-				ExternalPlatformUserMap.Add(PlatformUser.Platform, PlatformUser);
-				if(PlatformUser.Platform == MostRecentPlatform) OnlineUser->SetPlatformUser(PlatformUser);
-			}
-			OnlineUser->SetExternalPlatformUsers(ExternalPlatformUserMap);
+			if(--State->ChunksLeft == 0) ConnectSubsystem->FetchOnlineUserAvatars(State);
+		});
+	}
+}
 
-			// Add the new user to the list
-			OnlineUsers.Add(OnlineUser);
-		}
+/**
+ * The platform that is shown for a user with several linked accounts, the first one that is linked is used.
+ * Steam comes first because avatars are only fetched from Steam.
+ */
+static constexpr EPlatform PlatformPriority[] = {EPlatform::Steam, EPlatform::Psn, EPlatform::Xbox, EPlatform::Epic};
 
-		
-		/*
-		 * Fetch the avatars for all the users
-		 */
+/**
+ * Creates an online-user from the queried mappings, with all of its linked external accounts.
+ * The platform of the user is picked by PlatformPriority, not by which account was used last, so it does not change between logins.
+ * A user without an external account is still created, with an empty platform-user.
+ */
+UOnlineUser* UConnectSubsystem::CreateOnlineUser(const EOS_ProductUserId TargetUserID) const
+{
+	UOnlineUser* OnlineUser = NewObject<UOnlineUser>();
+	OnlineUser->SetProductUserID(EosProductIDToString(TargetUserID));
+	OnlineUser->SetEpicAccountID(FString("")); // TODO: this line
+	
+	EOS_Connect_GetProductUserExternalAccountCountOptions CountOptions;
+	CountOptions.ApiVersion = EOS_CONNECT_GETPRODUCTUSEREXTERNALACCOUNTCOUNT_API_LATEST;
+	CountOptions.TargetUserId = TargetUserID;
+	const uint32_t AccountCount = EOS_Connect_GetProductUserExternalAccountCount(ConnectHandle, &CountOptions);
 
-		// This variable needs to stay alive when the function goes out of scope, it also needs to be thread-safe
-		TSharedPtr<int32, ESPMode::ThreadSafe> TotalLeftToFetch = MakeShared<int32, ESPMode::ThreadSafe>(OnlineUsers.Num());
-		TSharedPtr<FCriticalSection, ESPMode::ThreadSafe> Mutex = MakeShared<FCriticalSection, ESPMode::ThreadSafe>();
+	TMap<EPlatform, FPlatformUser> PlatformUsers;
+	for (uint32_t Index = 0; Index < AccountCount; ++Index)
+	{
+		EOS_Connect_CopyProductUserExternalAccountByIndexOptions IndexOptions;
+		IndexOptions.ApiVersion = EOS_CONNECT_COPYPRODUCTUSEREXTERNALACCOUNTBYINDEX_API_LATEST;
+		IndexOptions.TargetUserId = TargetUserID;
+		IndexOptions.ExternalAccountInfoIndex = Index;
 		
-		if (TotalLeftToFetch == 0)
+		EOS_Connect_ExternalAccountInfo* AccountInfo = nullptr;
+		if(const EOS_EResult Result = EOS_Connect_CopyProductUserExternalAccountByIndex(ConnectHandle, &IndexOptions, &AccountInfo); Result != EOS_EResult::EOS_Success)
 		{
-			OnCompleteCallback(OnlineUsers);
-			delete CD;
+			UE_LOG(LogConnectSubsystem, Log, TEXT("Failed to copy external account %u of user %s. Error code: [%hs]"), Index, *OnlineUser->GetProductUserID(), EOS_EResult_ToString(Result));
+			continue;
 		}
-		
-		for (auto CurrentUser : OnlineUsers)
-		{
-			USteamOnlineUserSubsystem* SteamOnlineUserSubsystem = ConnectSubsystem->GetGameInstance()->GetSubsystem<USteamOnlineUserSubsystem>();
-			SteamOnlineUserSubsystem->FetchAvatar(FCString::Strtoui64(*CurrentUser->GetUserID(), nullptr, 10), [CD, OnCompleteCallback, CurrentUser, OnlineUsers, TotalLeftToFetch, Mutex](UTexture2D* Avatar)
-			{
-				UE_LOG(LogConnectSubsystem, Log, TEXT("Got texture of user."))
-				CurrentUser->SetAvatar(Avatar);
 
-				Mutex->Lock();
-				if(--(*TotalLeftToFetch) == 0)
-				{
-					delete CD;
-					OnCompleteCallback(OnlineUsers);
-				}
-				Mutex->Unlock();
-			});
+		FPlatformUser PlatformUser;
+		PlatformUser.UserID = FString(AccountInfo->AccountId);
+		PlatformUser.Username = AccountInfo->DisplayName ? AccountInfo->DisplayName : "";
+		PlatformUser.LastLoginTime = AccountInfo->LastLoginTime;
+		PlatformUser.Platform = PlatformFromAccountType(AccountInfo->AccountIdType);
+		PlatformUser.Avatar = nullptr;
+		EOS_Connect_ExternalAccountInfo_Release(AccountInfo);
+
+		// Several account types count as Epic, the first one is kept.
+		if(!PlatformUsers.Contains(PlatformUser.Platform)) PlatformUsers.Add(PlatformUser.Platform, PlatformUser);
+	}
+	
+	if(PlatformUsers.IsEmpty())
+	{
+		UE_LOG(LogConnectSubsystem, Log, TEXT("No external account info for user %s."), *OnlineUser->GetProductUserID());
+		return OnlineUser;
+	}
+
+	for (const EPlatform Platform : PlatformPriority)
+	{
+		if(const FPlatformUser* PlatformUser = PlatformUsers.Find(Platform))
+		{
+			OnlineUser->SetPlatformUser(*PlatformUser);
+			OnlineUser->SetPlatform(Platform);
+			break;
 		}
-		
-	});
+	}
+	OnlineUser->SetExternalPlatformUsers(PlatformUsers);
+	return OnlineUser;
+}
+
+/**
+ * Fetches the avatars of the Steam users, and calls the callback once all of them are done.
+ */
+void UConnectSubsystem::FetchOnlineUserAvatars(const TSharedPtr<FGetOnlineUserDetailsState>& State)
+{
+	State->OnlineUsers.RemoveAll([](const TStrongObjectPtr<UOnlineUser>& OnlineUser){ return !OnlineUser.IsValid(); });
+	
+	TArray<UOnlineUser*> SteamUsers;
+	for (const TStrongObjectPtr<UOnlineUser>& OnlineUser : State->OnlineUsers)
+	{
+		if(OnlineUser->GetPlatform() == EPlatform::Steam && !OnlineUser->GetUserID().IsEmpty()) SteamUsers.Add(OnlineUser.Get());
+	}
+	
+	State->AvatarsLeft = SteamUsers.Num();
+	if(State->AvatarsLeft == 0)
+	{
+		State->Callback(State->GetOnlineUsers());
+		return;
+	}
+
+	USteamOnlineUserSubsystem* SteamOnlineUserSubsystem = GetGameInstance()->GetSubsystem<USteamOnlineUserSubsystem>();
+	for (UOnlineUser* OnlineUser : SteamUsers)
+	{
+		// Steam callbacks are dispatched on the game thread, so the counter needs no lock. The user is kept alive by the state.
+		SteamOnlineUserSubsystem->FetchAvatar(FCString::Strtoui64(*OnlineUser->GetUserID(), nullptr, 10), [State, OnlineUser](UTexture2D* Avatar)
+		{
+			OnlineUser->SetAvatar(Avatar);
+			if(--State->AvatarsLeft == 0) State->Callback(State->GetOnlineUsers());
+		});
+	}
 }
\ No newline at end of file
@@ -14,13 +14,21 @@ UFriendsSubsystem::UFriendsSubsystem() : EosManager(&FEosManager::Get())
 void UFriendsSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
-	
-	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
-	if(!PlatformHandle) return;
-	FriendsHandle = EOS_Platform_GetFriendsInterface(PlatformHandle);
 
 	SteamFriendsSubsystem = Collection.InitializeDependency<USteamFriendsSubsystem>();
 	LocalUserSubsystem = Collection.InitializeDependency<ULocalUserSubsystem>();
+
+	Activation.Initialize(this, [this](){ Activate(); });
+}
+
+/**
+ * Gets the friends interface, deferred until first use when the subsystem is lazy.
+ */
+void UFriendsSubsystem::Activate()
+{
+	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
+	if(!PlatformHandle) return;
+	FriendsHandle = EOS_Platform_GetFriendsInterface(PlatformHandle);
 }
 
 
@@ -29,6 +37,8 @@ void UFriendsSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 
 TArray<FPlatformUser> UFriendsSubsystem::GetFriendList() const
 {
+	Activation.Ensure();
+
 	// TODO: Other platforms.
 	if(LocalUserSubsystem->GetLocalUser()->GetPlatform() == EPlatform::Steam)
 	{
@@ -44,6 +54,8 @@ TArray<FPlatformUser> UFriendsSubsystem::GetFriendList() const
 
 void UFriendsSubsystem::InviteToLobby(const FPlatformUser& PlatformUser) const
 {
+	Activation.Ensure();
+
 	// If both from EOS Send an invite using EOS_Lobby_SendInvite using their product user id.
 	// If both friends from same platform, send invite using that platform.
 
@@ -2,6 +2,7 @@
 
 #include "Subsystems/Friends/SteamFriendsSubsystem.h"
 #include "Subsystems/User/Local/LocalUserSubsystem.h"
+#include "Utils/SteamCallbackDispatcher.h"
 #include <vector>
 
 #pragma warning(push)
@@ -17,6 +18,13 @@
 void USteamFriendsSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	FSteamCallbackDispatcher::Get().RegisterUObject(this, &ThisClass::OnPersonaStateChange);
+}
+
+void USteamFriendsSubsystem::Deinitialize()
+{
+	FSteamCallbackDispatcher::Get().RemoveAll(this);
+	Super::Deinitialize();
 }
 
 
@@ -0,0 +1,436 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Subsystems/Lobby/HostElectionSubsystem.h"
+#include "Subsystems/Lobby/LobbySubsystem.h"
+#include "Subsystems/User/Local/LocalUserSubsystem.h"
+#include "EOSManager.h"
+#include "eos_p2p.h"
+#include "Helpers.h"
+#include "LatentAction/StartListenServer.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+
+
+
+namespace HostProbe
+{
+	constexpr EOS_P2P_SocketId SocketID = { EOS_P2P_SOCKETID_API_LATEST, "HostProbe" };
+	constexpr uint8 Channel = 7;
+	constexpr uint8 Ping = 0;
+	constexpr uint8 Pong = 1;
+	constexpr uint32 PacketSize = sizeof(uint8) + sizeof(double) + sizeof(float); // Type, the send time of the pinging member, and the hold time in ms of the answering member.
+}
+
+UHostElectionSubsystem::UHostElectionSubsystem() : EosManager(&FEosManager::Get())
+{
+}
+
+void UHostElectionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LocalUserSubsystem = Collection.InitializeDependency<ULocalUserSubsystem>();
+	LobbySubsystem = Collection.InitializeDependency<ULobbySubsystem>();
+
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bHostElection"), bElectionEnabled, GGameIni);
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("UploadKbps"), UploadKbps, GGameIni);
+	GConfig->GetString(TEXT("OnlineMultiplayer"), TEXT("UploadProbeURL"), UploadProbeURL, GGameIni);
+	GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("UploadProbeKB"), UploadProbeKB, GGameIni);
+	bUploadMeasured = UploadKbps > 0.0f;
+
+	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
+	if(!PlatformHandle) return;
+	P2PHandle = EOS_Platform_GetP2PInterface(PlatformHandle);
+
+	// Probe while in a lobby, so the profiles are published by the time the owner starts the server.
+	OnCreateLobbyCompleteDelegateHandle = LobbySubsystem->OnCreateLobbyCompleteDelegate.AddUObject(this, &ThisClass::OnCreateLobbyComplete);
+	OnJoinLobbyCompleteDelegateHandle = LobbySubsystem->OnJoinLobbyCompleteDelegate.AddUObject(this, &ThisClass::OnJoinLobbyComplete);
+	OnLeaveLobbyCompleteDelegateHandle = LobbySubsystem->OnLeaveLobbyCompleteDelegate.AddUObject(this, &ThisClass::OnLeaveLobbyComplete);
+	OnLobbyUserPromotedDelegateHandle = LobbySubsystem->OnLobbyUserPromotedDelegate.AddUObject(this, &ThisClass::OnLobbyUserPromoted);
+}
+
+void UHostElectionSubsystem::Deinitialize()
+{
+	StopProbing();
+	LobbySubsystem->OnCreateLobbyCompleteDelegate.Remove(OnCreateLobbyCompleteDelegateHandle);
+	LobbySubsystem->OnJoinLobbyCompleteDelegate.Remove(OnJoinLobbyCompleteDelegateHandle);
+	LobbySubsystem->OnLeaveLobbyCompleteDelegate.Remove(OnLeaveLobbyCompleteDelegateHandle);
+	LobbySubsystem->OnLobbyUserPromotedDelegate.Remove(OnLobbyUserPromotedDelegateHandle);
+	
+	Super::Deinitialize();
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Elects the best host from the profiles the members have published. Members without a profile are still candidates, with unknown measurements.
+ *
+ * @return The Product-User-ID of the elected member.
+ */
+FString UHostElectionSubsystem::RunElection() const
+{
+	const FString LocalProductUserID = LocalUserSubsystem->GetLocalUser()->GetProductUserID();
+	TArray<FString> Members;
+	LobbySubsystem->GetLobby().MemberList.GenerateKeyArray(Members);
+
+	TArray<FHostCandidateProfile> Candidates;
+	for (const FString& Member : Members)
+	{
+		FHostCandidateProfile Profile;
+		if(Member == LocalProductUserID)
+		{
+			Profile = GetLocalProfile();
+		}
+		else
+		{
+			FLobbyAttribute ProfileAttribute;
+			if(!LobbySubsystem->GetMemberAttribute(Member, "HostProfile", ProfileAttribute) || !FHostCandidateProfile::FromString(Member, ProfileAttribute.StringValue, Profile))
+			{
+				Profile.ProductUserID = Member;
+			}
+		}
+		Profile.bIsOwner = Member == LobbySubsystem->GetLobby().OwnerID;
+		Candidates.Add(Profile);
+	}
+
+	const FString ElectedHost = FHostElection::Elect(Candidates);
+	UE_LOG(LogHostElectionSubsystem, Log, TEXT("Elected '%s' as host out of %d members."), *ElectedHost, Candidates.Num());
+	return ElectedHost;
+}
+
+/**
+ * Marks the member as the elected host on the lobby, and promotes it to owner so that it starts the server.
+ */
+void UHostElectionSubsystem::TransferHost(const FString& ProductUserID, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback)
+{
+	FLobbyAttribute ElectedHostAttribute;
+	ElectedHostAttribute.Key = "ElectedHost";
+	ElectedHostAttribute.Type = ELobbyAttributeType::String;
+	ElectedHostAttribute.StringValue = ProductUserID;
+	TWeakObjectPtr<UHostElectionSubsystem> WeakThis(this);
+	LobbySubsystem->SetAttribute(ElectedHostAttribute, [WeakThis, ProductUserID, OnCompleteCallback](const bool bSuccess)
+	{
+		if(!bSuccess || !WeakThis.IsValid())
+		{
+			if(OnCompleteCallback) OnCompleteCallback(false);
+			return;
+		}
+		WeakThis->LobbySubsystem->PromoteMember(ProductUserID, OnCompleteCallback);
+	});
+}
+
+FHostCandidateProfile UHostElectionSubsystem::GetLocalProfile() const
+{
+	FHostCandidateProfile Profile;
+	Profile.ProductUserID = LocalUserSubsystem->GetLocalUser()->GetProductUserID();
+	Profile.RoundTripTimes = RoundTripTimes;
+	Profile.UploadKbps = UploadKbps;
+	Profile.NATType = NATType;
+	return Profile;
+}
+
+
+// --------------------------------------------
+
+
+void UHostElectionSubsystem::StartProbing()
+{
+	if(!bElectionEnabled || !P2PHandle || TickHandle.IsValid()) return;
+	
+	RoundTripTimes.Empty();
+	PublishedProfile.Empty();
+	LastProbeTime = LastPublishTime = 0.0;
+
+	// Only accept probe connections, other sockets are handled elsewhere.
+	EOS_P2P_AddNotifyPeerConnectionRequestOptions ConnectionRequestOptions;
+	ConnectionRequestOptions.ApiVersion = EOS_P2P_ADDNOTIFYPEERCONNECTIONREQUEST_API_LATEST;
+	ConnectionRequestOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	ConnectionRequestOptions.SocketId = &HostProbe::SocketID;
+	ConnectionRequestNotification = EOS_P2P_AddNotifyPeerConnectionRequest(P2PHandle, &ConnectionRequestOptions, this, &ThisClass::OnConnectionRequest);
+
+	constexpr EOS_P2P_QueryNATTypeOptions QueryNATTypeOptions{ EOS_P2P_QUERYNATTYPE_API_LATEST };
+	EosManager->BeginAsyncOperation();
+	EOS_P2P_QueryNATType(P2PHandle, &QueryNATTypeOptions, this, [](const EOS_P2P_OnQueryNATTypeCompleteInfo* Data)
+	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+		UHostElectionSubsystem* HostElectionSubsystem = static_cast<UHostElectionSubsystem*>(Data->ClientData);
+		if(Data->ResultCode == EOS_EResult::EOS_Success) HostElectionSubsystem->NATType = static_cast<uint8>(Data->NATType);
+		else UE_LOG(LogHostElectionSubsystem, Warning, TEXT("Failed to query the NAT type. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+	});
+
+	TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::Tick));
+	MeasureUpload();
+}
+
+/**
+ * Measures the upload capacity by timing a POST of incompressible data, from the first bytes sent until the response.
+ *
+ * Only done once per session, the result is published with the next profile.
+ */
+void UHostElectionSubsystem::MeasureUpload()
+{
+	if(bUploadMeasured || UploadProbeURL.IsEmpty() || UploadProbeKB <= 0) return;
+	
+	FHttpModule* Http = &FHttpModule::Get();
+	if(!Http || !Http->IsHttpEnabled()) return;
+	bUploadMeasured = true;
+
+	TArray<uint8> Payload;
+	Payload.SetNumUninitialized(UploadProbeKB * 1024);
+	for(uint8& Byte : Payload) Byte = static_cast<uint8>(FMath::Rand());
+	
+	const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
+	Request->SetURL(UploadProbeURL);
+	Request->SetVerb(TEXT("POST"));
+	Request->SetHeader(TEXT("Content-Type"), TEXT("application/octet-stream"));
+	Request->SetContent(MoveTemp(Payload));
+	Request->SetTimeout(30);
+
+	// The connection setup is not part of the upload, so start timing at the first progress.
+	const TSharedRef<double> SendStartTime = MakeShared<double>(FPlatformTime::Seconds());
+	const TSharedRef<bool> bSending = MakeShared<bool>(false);
+	Request->OnRequestProgress().BindLambda([SendStartTime, bSending](FHttpRequestPtr, const int32 BytesSent, int32)
+	{
+		if(*bSending || BytesSent <= 0) return;
+		*bSending = true;
+		*SendStartTime = FPlatformTime::Seconds();
+	});
+	
+	TWeakObjectPtr<UHostElectionSubsystem> WeakThis(this);
+	const int32 NumBytes = UploadProbeKB * 1024;
+	Request->OnProcessRequestComplete().BindLambda([WeakThis, SendStartTime, NumBytes](FHttpRequestPtr, const FHttpResponsePtr Response, const bool bWasSuccessful)
+	{
+		if(!WeakThis.IsValid()) return;
+		if(!bWasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+		{
+			UE_LOG(LogHostElectionSubsystem, Warning, TEXT("Failed to measure the upload capacity, it stays unknown."));
+			return;
+		}
+
+		const double Seconds = FMath::Max(FPlatformTime::Seconds() - *SendStartTime, 0.001);
+		WeakThis->UploadKbps = static_cast<float>(NumBytes * 8.0 / 1000.0 / Seconds);
+		UE_LOG(LogHostElectionSubsystem, Log, TEXT("Measured an upload capacity of %.0f kbps."), WeakThis->UploadKbps);
+	});
+
+	if(!Request->ProcessRequest()) bUploadMeasured = false;
+}
+
+void UHostElectionSubsystem::StopProbing()
+{
+	if(!TickHandle.IsValid()) return;
+	
+	FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	TickHandle.Reset();
+	EOS_P2P_RemoveNotifyPeerConnectionRequest(P2PHandle, ConnectionRequestNotification);
+	ConnectionRequestNotification = EOS_INVALID_NOTIFICATIONID;
+
+	EOS_P2P_CloseConnectionsOptions CloseConnectionsOptions;
+	CloseConnectionsOptions.ApiVersion = EOS_P2P_CLOSECONNECTIONS_API_LATEST;
+	CloseConnectionsOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	CloseConnectionsOptions.SocketId = &HostProbe::SocketID;
+	EOS_P2P_CloseConnections(P2PHandle, &CloseConnectionsOptions);
+}
+
+bool UHostElectionSubsystem::Tick(float DeltaTime)
+{
+	if(!LobbySubsystem->ActiveLobby()) return true;
+
+	// Packets are only pumped by the platform tick, which is throttled when idle.
+	EosManager->MarkBusy();
+	ReceiveProbes();
+
+	const double Now = FPlatformTime::Seconds();
+	if(Now - LastProbeTime >= ProbeInterval)
+	{
+		LastProbeTime = Now;
+		SendProbes();
+	}
+	if(Now - LastPublishTime >= PublishInterval)
+	{
+		LastPublishTime = Now;
+		PublishProfile();
+	}
+	return true;
+}
+
+void UHostElectionSubsystem::SendProbes()
+{
+	const FString LocalProductUserID = LocalUserSubsystem->GetLocalUser()->GetProductUserID();
+	
+	uint8 Packet[HostProbe::PacketSize];
+	Packet[0] = HostProbe::Ping;
+	const double SendTime = FPlatformTime::Seconds();
+	constexpr float HoldTime = 0.0f;
+	FMemory::Memcpy(Packet + 1, &SendTime, sizeof(double));
+	FMemory::Memcpy(Packet + 1 + sizeof(double), &HoldTime, sizeof(float));
+	
+	EOS_P2P_SendPacketOptions SendPacketOptions;
+	SendPacketOptions.ApiVersion = EOS_P2P_SENDPACKET_API_LATEST;
+	SendPacketOptions.LocalUserId = EosProductIDFromString(LocalProductUserID);
+	SendPacketOptions.SocketId = &HostProbe::SocketID;
+	SendPacketOptions.Channel = HostProbe::Channel;
+	SendPacketOptions.DataLengthBytes = HostProbe::PacketSize;
+	SendPacketOptions.Data = Packet;
+	SendPacketOptions.bAllowDelayedDelivery = EOS_TRUE;
+	SendPacketOptions.Reliability = EOS_EPacketReliability::EOS_PR_UnreliableUnordered;
+	SendPacketOptions.bDisableAutoAcceptConnection = EOS_FALSE;
+	
+	for (const TPair<FString, UOnlineUser*>& Member : LobbySubsystem->GetLobby().MemberList)
+	{
+		if(Member.Key == LocalProductUserID) continue;
+		SendPacketOptions.RemoteUserId = EosProductIDFromString(Member.Key);
+		EOS_P2P_SendPacket(P2PHandle, &SendPacketOptions);
+	}
+}
+
+/**
+ * Answers pings from other members, and measures the round-trip time from the answers to our own pings.
+ */
+void UHostElectionSubsystem::ReceiveProbes()
+{
+	const EOS_ProductUserId LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	
+	EOS_P2P_ReceivePacketOptions ReceivePacketOptions;
+	ReceivePacketOptions.ApiVersion = EOS_P2P_RECEIVEPACKET_API_LATEST;
+	ReceivePacketOptions.LocalUserId = LocalUserId;
+	ReceivePacketOptions.MaxDataSizeBytes = HostProbe::PacketSize;
+	ReceivePacketOptions.RequestedChannel = &HostProbe::Channel;
+
+	uint8 Packet[HostProbe::PacketSize];
+	EOS_ProductUserId PeerId;
+	EOS_P2P_SocketId SocketId;
+	uint8_t Channel;
+	uint32_t BytesWritten;
+	while(EOS_P2P_ReceivePacket(P2PHandle, &ReceivePacketOptions, &PeerId, &SocketId, &Channel, Packet, &BytesWritten) == EOS_EResult::EOS_Success)
+	{
+		if(BytesWritten != HostProbe::PacketSize || FCStringAnsi::Strcmp(SocketId.SocketName, HostProbe::SocketID.SocketName) != 0) continue;
+
+		if(Packet[0] == HostProbe::Ping)
+		{
+			// Echo the packet, so the pinging member can compare the send time with its own clock.
+			// Include how long the ping waited since EOS pumped it, so the pinging member can subtract it.
+			Packet[0] = HostProbe::Pong;
+			const float HoldTime = static_cast<float>((FPlatformTime::Seconds() - EosManager->GetLastTickTime()) * 1000.0);
+			FMemory::Memcpy(Packet + 1 + sizeof(double), &HoldTime, sizeof(float));
+			
+			EOS_P2P_SendPacketOptions SendPacketOptions;
+			SendPacketOptions.ApiVersion = EOS_P2P_SENDPACKET_API_LATEST;
+			SendPacketOptions.LocalUserId = LocalUserId;
+			SendPacketOptions.RemoteUserId = PeerId;
+			SendPacketOptions.SocketId = &HostProbe::SocketID;
+			SendPacketOptions.Channel = HostProbe::Channel;
+			SendPacketOptions.DataLengthBytes = HostProbe::PacketSize;
+			SendPacketOptions.Data = Packet;
+			SendPacketOptions.bAllowDelayedDelivery = EOS_TRUE;
+			SendPacketOptions.Reliability = EOS_EPacketReliability::EOS_PR_UnreliableUnordered;
+			SendPacketOptions.bDisableAutoAcceptConnection = EOS_FALSE;
+			EOS_P2P_SendPacket(P2PHandle, &SendPacketOptions);
+		}
+		else if(Packet[0] == HostProbe::Pong)
+		{
+			double SendTime;
+			float HoldTime;
+			FMemory::Memcpy(&SendTime, Packet + 1, sizeof(double));
+			FMemory::Memcpy(&HoldTime, Packet + 1 + sizeof(double), sizeof(float));
+
+			// Measured until EOS pumped the answer, not until it is read here, and without the time the other member held the ping.
+			const float Sample = FMath::Max(0.0f, static_cast<float>((EosManager->GetLastTickTime() - SendTime) * 1000.0) - HoldTime);
+
+			// Exponential moving average, so a single spike does not decide the election.
+			const FString PeerID = EosProductIDToString(PeerId);
+			if(float* RoundTripTime = RoundTripTimes.Find(PeerID)) *RoundTripTime += RoundTripTimeSmoothing * (Sample - *RoundTripTime);
+			else RoundTripTimes.Add(PeerID, Sample);
+		}
+	}
+}
+
+void UHostElectionSubsystem::PublishProfile()
+{
+	// Drop measurements to members that have left.
+	for (auto It = RoundTripTimes.CreateIterator(); It; ++It)
+	{
+		if(!LobbySubsystem->GetLobby().MemberList.Contains(It.Key())) It.RemoveCurrent();
+	}
+	
+	const FString Profile = GetLocalProfile().ToString();
+	if(Profile == PublishedProfile) return;
+
+	FLobbyAttribute ProfileAttribute;
+	ProfileAttribute.Key = "HostProfile";
+	ProfileAttribute.Type = ELobbyAttributeType::String;
+	ProfileAttribute.StringValue = Profile;
+	TWeakObjectPtr<UHostElectionSubsystem> WeakThis(this);
+	LobbySubsystem->SetMemberAttribute(ProfileAttribute, [WeakThis, Profile](const bool bSuccess)
+	{
+		if(bSuccess && WeakThis.IsValid()) WeakThis->PublishedProfile = Profile;
+	});
+}
+
+void UHostElectionSubsystem::OnConnectionRequest(const EOS_P2P_OnIncomingConnectionRequestInfo* Data)
+{
+	const UHostElectionSubsystem* HostElectionSubsystem = static_cast<UHostElectionSubsystem*>(Data->ClientData);
+
+	// Only accept probes from members of our lobby.
+	if(!HostElectionSubsystem->LobbySubsystem->GetLobby().MemberList.Contains(EosProductIDToString(Data->RemoteUserId))) return;
+	
+	EOS_P2P_AcceptConnectionOptions AcceptConnectionOptions;
+	AcceptConnectionOptions.ApiVersion = EOS_P2P_ACCEPTCONNECTION_API_LATEST;
+	AcceptConnectionOptions.LocalUserId = Data->LocalUserId;
+	AcceptConnectionOptions.RemoteUserId = Data->RemoteUserId;
+	AcceptConnectionOptions.SocketId = Data->SocketId;
+	EOS_P2P_AcceptConnection(HostElectionSubsystem->P2PHandle, &AcceptConnectionOptions);
+}
+
+
+// --------------------------------------------
+
+
+void UHostElectionSubsystem::OnCreateLobbyComplete(const ECreateLobbyResultCode Result, const FLobby& Lobby)
+{
+	if(Result == ECreateLobbyResultCode::Success) StartProbing();
+}
+
+void UHostElectionSubsystem::OnJoinLobbyComplete(const EJoinLobbyResultCode Result, const FLobby& Lobby)
+{
+	if(Result == EJoinLobbyResultCode::Success) StartProbing();
+}
+
+void UHostElectionSubsystem::OnLeaveLobbyComplete(const ELeaveLobbyResultCode Result)
+{
+	StopProbing();
+}
+
+void UHostElectionSubsystem::OnLobbyUserPromoted(const FString& ProductUserID)
+{
+	if(ProductUserID != LocalUserSubsystem->GetLocalUser()->GetProductUserID()) return;
+
+	// Only start hosting when promoted because of the election, not when the previous owner left.
+	const FLobbyAttribute* ElectedHostAttribute = LobbySubsystem->GetLobby().Attributes.Find("ElectedHost");
+	if(ElectedHostAttribute && ElectedHostAttribute->StringValue == ProductUserID)
+	{
+		UE_LOG(LogHostElectionSubsystem, Log, TEXT("Elected as host, starting the listen server."));
+
+		// The transfer is done, so a later promotion is not mistaken for another election.
+		FLobbyAttribute ElectedHostAttributeCleared;
+		ElectedHostAttributeCleared.Key = "ElectedHost";
+		ElectedHostAttributeCleared.Type = ELobbyAttributeType::String;
+		LobbySubsystem->SetAttribute(ElectedHostAttributeCleared, [](const bool bSuccess)
+		{
+			if(!bSuccess) UE_LOG(LogHostElectionSubsystem, Warning, TEXT("Failed to clear the 'ElectedHost' attribute on the lobby."));
+		});
+
+		// Skip the election, the other members have already agreed on this member.
+		ElectedListenServer = UStartListenServer::StartListenServer(GetGameInstance(), 0, 12.0f, true, true);
+		ElectedListenServer->OnSuccess.AddDynamic(this, &ThisClass::OnElectedListenServerComplete);
+		ElectedListenServer->OnFailure.AddDynamic(this, &ThisClass::OnElectedListenServerComplete);
+		ElectedListenServer->Activate();
+		OnElectedAsHostDelegate.Broadcast(ElectedListenServer);
+	}
+}
+
+void UHostElectionSubsystem::OnElectedListenServerComplete()
+{
+	ElectedListenServer = nullptr;
+}
@@ -34,7 +34,17 @@ void ULobbySubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	default:
 		break;
 	}
-	
+
+	Activation.Initialize(this, [this](){ Activate(); });
+}
+
+/**
+ * Gets the lobby interface and registers the lobby notifications.
+ *
+ * Deferred until first use when the subsystem is lazy, see FLazyActivation.
+ */
+void ULobbySubsystem::Activate()
+{
 	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
 	LobbyHandle = EOS_Platform_GetLobbyInterface(PlatformHandle);
 
@@ -50,8 +60,12 @@ void ULobbySubsystem::Initialize(FSubsystemCollectionBase& Collection)
 
 void ULobbySubsystem::Deinitialize()
 {
-	EOS_Lobby_RemoveNotifyLobbyUpdateReceived(LobbyHandle, OnLobbyUpdateNotification);
-	EOS_Lobby_RemoveNotifyLobbyMemberStatusReceived(LobbyHandle, OnLobbyMemberStatusNotification);
+	if(LobbyHandle)
+	{
+		EOS_Lobby_RemoveNotifyLobbyUpdateReceived(LobbyHandle, OnLobbyUpdateNotification);
+		EOS_Lobby_RemoveNotifyLobbyMemberStatusReceived(LobbyHandle, OnLobbyMemberStatusNotification);
+	}
+	Activation.Reset();
 
 	Super::Deinitialize();
 }
@@ -69,6 +83,8 @@ struct FCreateLobbyClientData
 
 void ULobbySubsystem::CreateLobby(const int32 MaxMembers)
 {
+	Activation.Ensure();
+
 	if(ActiveLobby())
 	{
 		OnCreateLobbyCompleteDelegate.Broadcast(ECreateLobbyResultCode::InLobby, Lobby);
@@ -101,8 +117,10 @@ void ULobbySubsystem::CreateLobby(const int32 MaxMembers)
 	CreateLobbyClientData->MaxMembers = MaxMembers;
 
 	// Create the EOS lobby and handle the result
+	EosManager->BeginAsyncOperation();
 	EOS_Lobby_CreateLobby(LobbyHandle, &CreateLobbyOptions, CreateLobbyClientData, [](const EOS_Lobby_CreateLobbyCallbackInfo* Data)
     {
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		const FCreateLobbyClientData* ClientData = static_cast<FCreateLobbyClientData*>(Data->ClientData);
         ULobbySubsystem* LobbySubsystem = ClientData->Self;
 		const ULocalUserSubsystem* LocalUserSubsystem = ClientData->LocalUserSubsystem;
@@ -147,6 +165,8 @@ void ULobbySubsystem::CreateLobby(const int32 MaxMembers)
 
 void ULobbySubsystem::JoinLobbyByID(const FString& LobbyID)
 {
+	Activation.Ensure();
+
 	// Create the Lobby Search Handle and set the Options
     EOS_Lobby_CreateLobbySearchOptions LobbySearchOptions;
     LobbySearchOptions.ApiVersion = EOS_LOBBY_CREATELOBBYSEARCH_API_LATEST;
@@ -170,7 +190,9 @@ void ULobbySubsystem::JoinLobbyByID(const FString& LobbyID)
     EOS_LobbySearch_FindOptions FindOptions;
     FindOptions.ApiVersion = EOS_LOBBYSEARCH_FIND_API_LATEST;
 	FindOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	EosManager->BeginAsyncOperation();
 	EOS_LobbySearch_Find(LobbySearchByLobbyIDHandle, &FindOptions, this, [] (const EOS_LobbySearch_FindCallbackInfo* Data) {
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		if (Data->ResultCode == EOS_EResult::EOS_Success)
 		{
 			ULobbySubsystem* LobbySubsystem = static_cast<ULobbySubsystem*>(Data->ClientData);
@@ -193,6 +215,8 @@ void ULobbySubsystem::JoinLobbyByID(const FString& LobbyID)
 
 void ULobbySubsystem::JoinLobbyByUserID(const FString& UserID)
 {
+	Activation.Ensure();
+
 	// Create the lobby search handle.
 	EOS_Lobby_CreateLobbySearchOptions LobbySearchOptions;
 	LobbySearchOptions.ApiVersion = EOS_LOBBY_CREATELOBBYSEARCH_API_LATEST;
@@ -215,8 +239,10 @@ void ULobbySubsystem::JoinLobbyByUserID(const FString& UserID)
 	LobbySearchFindOptions.ApiVersion = EOS_LOBBYSEARCH_FIND_API_LATEST;
 	LobbySearchFindOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
 
+	EosManager->BeginAsyncOperation();
 	EOS_LobbySearch_Find(LobbySearchByUserIDHandle, &LobbySearchFindOptions, this, [](const EOS_LobbySearch_FindCallbackInfo* Data)
 	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		ULobbySubsystem* LobbySubsystem = static_cast<ULobbySubsystem*>(Data->ClientData);
 		if(Data->ResultCode == EOS_EResult::EOS_Success)
 		{
@@ -253,6 +279,8 @@ void ULobbySubsystem::JoinLobbyByUserID(const FString& UserID)
 
 void ULobbySubsystem::LeaveLobby()
 {
+	Activation.Ensure();
+
 	if(!ActiveLobby() || !LobbyHandle)
 	{
 		UE_LOG(LogLobbySubsystem, Error, TEXT("Cannot leave a lobby when not in one."));
@@ -265,8 +293,10 @@ void ULobbySubsystem::LeaveLobby()
 	LeaveLobbyOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
 	LeaveLobbyOptions.LobbyId = TCHAR_TO_UTF8(*Lobby.ID);
 	
+	EosManager->BeginAsyncOperation();
 	EOS_Lobby_LeaveLobby(LobbyHandle, &LeaveLobbyOptions, this, [](const EOS_Lobby_LeaveLobbyCallbackInfo* Data)
 	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		ULobbySubsystem* LobbySubsystem = static_cast<ULobbySubsystem*>(Data->ClientData);
 
 		// Clear lobby data
@@ -286,6 +316,41 @@ void ULobbySubsystem::LeaveLobby()
 	});
 }
 
+/**
+ * Transfers the ownership of the lobby to another member. Only the owner can do this.
+ */
+void ULobbySubsystem::PromoteMember(const FString& ProductUserID, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback)
+{
+	Activation.Ensure();
+
+	if(Lobby.OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID())
+	{
+		UE_LOG(LogLobbySubsystem, Error, TEXT("Only the lobby owner can promote a member."));
+		if(OnCompleteCallback) OnCompleteCallback(false);
+		return;
+	}
+
+	const FTCHARToUTF8 ConvertedLobbyID(*Lobby.ID);
+	EOS_Lobby_PromoteMemberOptions PromoteMemberOptions;
+	PromoteMemberOptions.ApiVersion = EOS_LOBBY_PROMOTEMEMBER_API_LATEST;
+	PromoteMemberOptions.LobbyId = ConvertedLobbyID.Get();
+	PromoteMemberOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	PromoteMemberOptions.TargetUserId = EosProductIDFromString(ProductUserID);
+
+	TFunction<void(const bool bWasSuccessful)>* ClientData = new TFunction<void(const bool bWasSuccessful)>(OnCompleteCallback);
+	EosManager->BeginAsyncOperation();
+	EOS_Lobby_PromoteMember(LobbyHandle, &PromoteMemberOptions, ClientData, [](const EOS_Lobby_PromoteMemberCallbackInfo* Data)
+	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+		const TFunction<void(const bool bWasSuccessful)>* Callback = static_cast<TFunction<void(const bool bWasSuccessful)>*>(Data->ClientData);
+		
+		if(Data->ResultCode != EOS_EResult::EOS_Success) UE_LOG(LogLobbySubsystem, Error, TEXT("Failed to promote lobby member. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+		if(*Callback) (*Callback)(Data->ResultCode == EOS_EResult::EOS_Success);
+		
+		delete Callback;
+	});
+}
+
 void ULobbySubsystem::StartListenServer(UObject* WorldContextObject, FLatentActionInfos LatentInfos)
 {
 }
@@ -304,6 +369,7 @@ void ULobbySubsystem::JoinLobbyByHandle(const EOS_HLobbyDetails& LobbyDetailsHan
 	JoinOptions.bPresenceEnabled = true;
 	JoinOptions.LocalRTCOptions = nullptr;
 
+	EosManager->BeginAsyncOperation();
 	EOS_Lobby_JoinLobby(LobbyHandle, &JoinOptions, this, &ULobbySubsystem::OnJoinLobbyComplete);
 
 	// Release the handle after using it
@@ -314,6 +380,7 @@ void ULobbySubsystem::JoinLobbyByHandle(const EOS_HLobbyDetails& LobbyDetailsHan
 
 void ULobbySubsystem::OnJoinLobbyComplete(const EOS_Lobby_JoinLobbyCallbackInfo* Data)
 {
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 	ULobbySubsystem* LobbySubsystem = static_cast<ULobbySubsystem*>(Data->ClientData);
 
 	if(Data->ResultCode == EOS_EResult::EOS_Success || Data->ResultCode == EOS_EResult::EOS_Lobby_PresenceLobbyExists)
@@ -365,6 +432,8 @@ struct FSetAttributeCompleteClientData
  */
 void ULobbySubsystem::SetAttributes(TArray<FLobbyAttribute> Attributes, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback)
 {
+	Activation.Ensure();
+
 	// Can only update the lobby-attributes if owner.
 	if(Lobby.OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID())
 	{
@@ -408,8 +477,10 @@ void ULobbySubsystem::SetAttributes(TArray<FLobbyAttribute> Attributes, TFunctio
 		UpdateLobbyOptions.LobbyModificationHandle = LobbyModificationHandle;
 		
 		FSetAttributeCompleteClientData* SetAttributeCompleteClientData = new FSetAttributeCompleteClientData{this, SuccessfulAttributes, OnCompleteCallback};
+		EosManager->BeginAsyncOperation();
 		EOS_Lobby_UpdateLobby(LobbyHandle, &UpdateLobbyOptions, SetAttributeCompleteClientData, [](const EOS_Lobby_UpdateLobbyCallbackInfo* Data)
 		{
+			FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 			const FSetAttributeCompleteClientData* ClientData = static_cast<FSetAttributeCompleteClientData*>(Data->ClientData);
 			
 			if(Data->ResultCode == EOS_EResult::EOS_Success)
@@ -440,6 +511,138 @@ void ULobbySubsystem::SetAttributes(TArray<FLobbyAttribute> Attributes, TFunctio
 	}
 }
 
+/**
+ * Set/update an attribute on the local user's lobby member. Every member can set its own member attributes.
+ */
+void ULobbySubsystem::SetMemberAttribute(const FLobbyAttribute& Attribute, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback)
+{
+	Activation.Ensure();
+
+	if(!ActiveLobby())
+	{
+		if(OnCompleteCallback) OnCompleteCallback(false);
+		return;
+	}
+	
+	const FTCHARToUTF8 ConvertedLobbyID(*Lobby.ID);
+	EOS_Lobby_UpdateLobbyModificationOptions UpdateLobbyModificationOptions;
+	UpdateLobbyModificationOptions.ApiVersion = EOS_LOBBY_UPDATELOBBYMODIFICATION_API_LATEST;
+	UpdateLobbyModificationOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	UpdateLobbyModificationOptions.LobbyId = ConvertedLobbyID.Get();
+
+	EOS_HLobbyModification LobbyModificationHandle;
+	if(const EOS_EResult Result = EOS_Lobby_UpdateLobbyModification(LobbyHandle, &UpdateLobbyModificationOptions, &LobbyModificationHandle); Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogLobbySubsystem, Error, TEXT("Failed to create the lobby-modification-handle for setting a member attribute. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		if(OnCompleteCallback) OnCompleteCallback(false);
+		return;
+	}
+
+	const FTCHARToUTF8 ConvertedKey(*Attribute.Key);
+	const FTCHARToUTF8 ConvertedStringValue(*Attribute.StringValue);
+	EOS_Lobby_AttributeData EosAttributeData;
+	EosAttributeData.ApiVersion = EOS_LOBBY_ATTRIBUTEDATA_API_LATEST;
+	EosAttributeData.Key = ConvertedKey.Get();
+	switch (Attribute.Type)
+	{
+	case ELobbyAttributeType::Bool:
+		EosAttributeData.ValueType = EOS_ELobbyAttributeType::EOS_AT_BOOLEAN;
+		EosAttributeData.Value.AsBool = Attribute.BoolValue ? EOS_TRUE : EOS_FALSE;
+		break;
+	case ELobbyAttributeType::String:
+		EosAttributeData.ValueType = EOS_ELobbyAttributeType::EOS_AT_STRING;
+		EosAttributeData.Value.AsUtf8 = ConvertedStringValue.Get();
+		break;
+	case ELobbyAttributeType::Int64:
+		EosAttributeData.ValueType = EOS_ELobbyAttributeType::EOS_AT_INT64;
+		EosAttributeData.Value.AsInt64 = Attribute.IntValue;
+		break;
+	case ELobbyAttributeType::Double:
+		EosAttributeData.ValueType = EOS_ELobbyAttributeType::EOS_AT_DOUBLE;
+		EosAttributeData.Value.AsDouble = Attribute.DoubleValue;
+		break;
+	}
+
+	EOS_LobbyModification_AddMemberAttributeOptions AttributeOptions;
+	AttributeOptions.ApiVersion = EOS_LOBBYMODIFICATION_ADDMEMBERATTRIBUTE_API_LATEST;
+	AttributeOptions.Attribute = &EosAttributeData;
+	AttributeOptions.Visibility = EOS_ELobbyAttributeVisibility::EOS_LAT_PUBLIC;
+	if(const EOS_EResult Result = EOS_LobbyModification_AddMemberAttribute(LobbyModificationHandle, &AttributeOptions); Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogLobbySubsystem, Error, TEXT("Failed to add a member attribute to the LobbyModification. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		EOS_LobbyModification_Release(LobbyModificationHandle);
+		if(OnCompleteCallback) OnCompleteCallback(false);
+		return;
+	}
+
+	EOS_Lobby_UpdateLobbyOptions UpdateLobbyOptions;
+	UpdateLobbyOptions.ApiVersion = EOS_LOBBY_UPDATELOBBY_API_LATEST;
+	UpdateLobbyOptions.LobbyModificationHandle = LobbyModificationHandle;
+
+	TFunction<void(const bool bWasSuccessful)>* ClientData = new TFunction<void(const bool bWasSuccessful)>(OnCompleteCallback);
+	EosManager->BeginAsyncOperation();
+	EOS_Lobby_UpdateLobby(LobbyHandle, &UpdateLobbyOptions, ClientData, [](const EOS_Lobby_UpdateLobbyCallbackInfo* Data)
+	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+		const TFunction<void(const bool bWasSuccessful)>* Callback = static_cast<TFunction<void(const bool bWasSuccessful)>*>(Data->ClientData);
+		
+		if(Data->ResultCode != EOS_EResult::EOS_Success) UE_LOG(LogLobbySubsystem, Error, TEXT("Failed to update the lobby with the member attribute. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+		if(*Callback) (*Callback)(Data->ResultCode == EOS_EResult::EOS_Success);
+		
+		delete Callback;
+	});
+	EOS_LobbyModification_Release(LobbyModificationHandle);
+}
+
+/**
+ * Reads an attribute of a lobby member from the local copy of the lobby.
+ */
+bool ULobbySubsystem::GetMemberAttribute(const FString& ProductUserID, const FString& Key, FLobbyAttribute& OutAttribute) const
+{
+	const EOS_HLobbyDetails LobbyDetailsHandle = GetLobbyDetailsHandle();
+	if(!LobbyDetailsHandle) return false;
+
+	const FTCHARToUTF8 ConvertedKey(*Key);
+	EOS_LobbyDetails_CopyMemberAttributeByKeyOptions AttributeOptions;
+	AttributeOptions.ApiVersion = EOS_LOBBYDETAILS_COPYMEMBERATTRIBUTEBYKEY_API_LATEST;
+	AttributeOptions.TargetUserId = EosProductIDFromString(ProductUserID);
+	AttributeOptions.AttrKey = ConvertedKey.Get();
+
+	EOS_Lobby_Attribute* EosAttribute = nullptr;
+	const EOS_EResult Result = EOS_LobbyDetails_CopyMemberAttributeByKey(LobbyDetailsHandle, &AttributeOptions, &EosAttribute);
+	EOS_LobbyDetails_Release(LobbyDetailsHandle);
+	if(Result != EOS_EResult::EOS_Success || !EosAttribute || !EosAttribute->Data)
+	{
+		if(EosAttribute) EOS_Lobby_Attribute_Release(EosAttribute);
+		return false;
+	}
+
+	OutAttribute = FLobbyAttribute();
+	OutAttribute.Key = Key;
+	switch (EosAttribute->Data->ValueType)
+	{
+	case EOS_ELobbyAttributeType::EOS_AT_BOOLEAN:
+		OutAttribute.Type = ELobbyAttributeType::Bool;
+		OutAttribute.BoolValue = EosAttribute->Data->Value.AsBool == EOS_TRUE;
+		break;
+	case EOS_ELobbyAttributeType::EOS_AT_STRING:
+		OutAttribute.Type = ELobbyAttributeType::String;
+		OutAttribute.StringValue = UTF8_TO_TCHAR(EosAttribute->Data->Value.AsUtf8);
+		break;
+	case EOS_ELobbyAttributeType::EOS_AT_INT64:
+		OutAttribute.Type = ELobbyAttributeType::Int64;
+		OutAttribute.IntValue = EosAttribute->Data->Value.AsInt64;
+		break;
+	case EOS_ELobbyAttributeType::EOS_AT_DOUBLE:
+		OutAttribute.Type = ELobbyAttributeType::Double;
+		OutAttribute.DoubleValue = EosAttribute->Data->Value.AsDouble;
+		break;
+	}
+	
+	EOS_Lobby_Attribute_Release(EosAttribute);
+	return true;
+}
+
 TArray<FLobbyAttribute> ULobbySubsystem::FilterAttributes(TArray<FLobbyAttribute>& Attributes)
 {
 	TArray<FLobbyAttribute> ChangedAttributes;
@@ -643,7 +846,19 @@ void ULobbySubsystem::OnLobbyUpdate(const EOS_Lobby_LobbyUpdateReceivedCallbackI
     			if(LobbySubsystem->Lobby.OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID()) LobbySubsystem->OnLobbyStartedDelegate.Broadcast(LatestAttribute.StringValue);
     		}
     		else LobbySubsystem->OnLobbyStoppedDelegate.Broadcast();
-    	}else
+    	}
+    	else if(Key == "SessionID")
+    	{
+    		// The owner has created a session for this lobby, members can join it directly.
+    		if(!LatestAttribute.StringValue.IsEmpty()) LobbySubsystem->OnSessionIDAttributeChanged.Broadcast(LatestAttribute.StringValue);
+    	}
+    	else if(Key == "MapName")
+    	{
+    		// The owner is about to start the server on this map, members can already start loading it. The owner loads it itself.
+    		ULocalUserSubsystem* LocalUserSubsystem = LobbySubsystem->GetGameInstance()->GetSubsystem<ULocalUserSubsystem>();
+    		if(LobbySubsystem->Lobby.OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID()) LobbySubsystem->OnMapNameAttributeChanged.Broadcast(LatestAttribute.StringValue);
+    	}
+    	else
     	{
     		LobbySubsystem->OnLobbyAttributeChanged.Broadcast(LatestAttribute);
     	}
@@ -772,6 +987,9 @@ void ULobbySubsystem::LoadLobby(TFunction<void(bool bSuccess)> OnCompleteCallbac
 		return;
 	}
 
+	// Loading all members causes a burst of callbacks.
+	EosManager->MarkBusy();
+
 	const EOS_HLobbyDetails LobbyDetailsHandle = GetLobbyDetailsHandle();
 	if(!LobbyDetailsHandle) OnCompleteCallback(false);
 	
@@ -905,8 +1123,10 @@ void ULobbySubsystem::AddShadowLobbyIDAttribute(const FString& ShadowLobbyID)
             UpdateLobbyOptions.ApiVersion = EOS_LOBBY_UPDATELOBBY_API_LATEST;
             UpdateLobbyOptions.LobbyModificationHandle = LobbyModificationHandle;
         	
+            EosManager->BeginAsyncOperation();
             EOS_Lobby_UpdateLobby(LobbyHandle, &UpdateLobbyOptions, nullptr, [](const EOS_Lobby_UpdateLobbyCallbackInfo* Data)
             {
+            	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
             	if(Data->ResultCode == EOS_EResult::EOS_Success)
             	{
 					UE_LOG(LogLobbySubsystem, Log, TEXT("Shadow-Lobby-ID added to EOS-Lobby attributes."));
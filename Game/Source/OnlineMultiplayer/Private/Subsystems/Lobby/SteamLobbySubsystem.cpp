@@ -3,6 +3,7 @@
 #include "Subsystems/Lobby/SteamLobbySubsystem.h"
 #include "Subsystems/Lobby/LobbySubsystem.h"
 #include "Subsystems/User/Local/LocalUserSubsystem.h"
+#include "Utils/SteamCallbackDispatcher.h"
 
 #pragma warning(push)
 #pragma warning(disable: 4996)
@@ -20,16 +21,26 @@ void USteamLobbySubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	LocalUserSubsystem = Collection.InitializeDependency<ULocalUserSubsystem>();
 	LobbySubsystem = Collection.InitializeDependency<ULobbySubsystem>();
 
-	// OnLobbyDataUpdateCompleteCallback.Register(this, &ThisClass::OnLobbyDataUpdateComplete);
-	// OnJoinLobbyRequestCallback.Register(this, &ThisClass::OnJoinLobbyRequest);
-	// OnJoinRichPresenceRequestCallback.Register(this, &ThisClass::OnJoinRichPresenceRequest);
+	Activation.Initialize(this, [this](){ Activate(); });
+}
+
+/**
+ * Registers the Steam lobby callbacks, deferred until first use when the subsystem is lazy.
+ *
+ * Join requests from the Steam overlay are only received once this has run.
+ */
+void USteamLobbySubsystem::Activate()
+{
+	FSteamCallbackDispatcher& Dispatcher = FSteamCallbackDispatcher::Get();
+	Dispatcher.RegisterUObject(this, &ThisClass::OnLobbyDataUpdateComplete);
+	Dispatcher.RegisterUObject(this, &ThisClass::OnJoinLobbyRequest);
+	Dispatcher.RegisterUObject(this, &ThisClass::OnJoinRichPresenceRequest);
 }
 
 void USteamLobbySubsystem::Deinitialize()
 {
-	// OnLobbyDataUpdateCompleteCallback.Unregister();
-	// OnJoinLobbyRequestCallback.Unregister();
-	// OnJoinRichPresenceRequestCallback.Unregister();
+	FSteamCallbackDispatcher::Get().RemoveAll(this);
+	Activation.Reset();
 	
 	Super::Deinitialize();
 }
@@ -49,6 +60,8 @@ void USteamLobbySubsystem::Deinitialize()
  */
 void USteamLobbySubsystem::CreateLobby()
 {
+	Activation.Ensure();
+
 	if(!LobbySubsystem->ActiveLobby())
 	{
 		UE_LOG(LogSteamLobbySubsystem, Warning, TEXT("Not in an EOS-lobby. Cannot create Shadow-Lobby without being in an EOS-lobby."));
@@ -72,7 +85,7 @@ void USteamLobbySubsystem::CreateLobby()
 	}
 	
 	const SteamAPICall_t SteamCreateShadowLobbyAPICall = SteamMatchmaking()->CreateLobby(k_ELobbyTypeFriendsOnly, 4);
-	OnCreateShadowLobbyCallResult.Set(SteamCreateShadowLobbyAPICall, this, &USteamLobbySubsystem::OnCreateLobbyComplete);
+	FSteamCallbackDispatcher::Get().CallUObject(SteamCreateShadowLobbyAPICall, this, &USteamLobbySubsystem::OnCreateLobbyComplete);
 }
 
 void USteamLobbySubsystem::OnCreateLobbyComplete(LobbyCreated_t* Data, bool bIOFailure)
@@ -111,8 +124,10 @@ void USteamLobbySubsystem::OnLobbyDataUpdateComplete(LobbyDataUpdate_t* Data)
 
 void USteamLobbySubsystem::JoinLobby(const FString& LobbyID)
 {
+	Activation.Ensure();
+
 	const SteamAPICall_t SteamJoinShadowLobbyAPICall = SteamMatchmaking()->JoinLobby(FCString::Strtoui64(*LobbyID, nullptr, 10));
-	OnShadowLobbyEnterCallResult.Set(SteamJoinShadowLobbyAPICall, this, &USteamLobbySubsystem::OnJoinLobbyComplete);
+	FSteamCallbackDispatcher::Get().CallUObject(SteamJoinShadowLobbyAPICall, this, &USteamLobbySubsystem::OnJoinLobbyComplete);
 }
 
 void USteamLobbySubsystem::OnJoinLobbyComplete(LobbyEnter_t* Data, bool bIOFailure)
@@ -138,6 +153,8 @@ void USteamLobbySubsystem::OnJoinLobbyComplete(LobbyEnter_t* Data, bool bIOFailu
 
 void USteamLobbySubsystem::LeaveLobby()
 {
+	Activation.Ensure();
+
 	SteamMatchmaking()->LeaveLobby(FCString::Strtoui64(*LobbyDetails.LobbyID, nullptr, 10));
 	LobbyDetails.Reset();
 	UE_LOG(LogSteamLobbySubsystem, Log, TEXT("Left the shadow-lobby."));
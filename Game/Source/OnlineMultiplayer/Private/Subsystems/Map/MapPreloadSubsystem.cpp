@@ -0,0 +1,174 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Subsystems/Map/MapPreloadSubsystem.h"
+#include "Subsystems/Lobby/LobbySubsystem.h"
+#include "Subsystems/User/Local/LocalUserSubsystem.h"
+#include "UObject/UObjectGlobals.h"
+#include "Misc/PackageName.h"
+
+
+
+void UMapPreloadSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LobbySubsystem = Collection.InitializeDependency<ULobbySubsystem>();
+	LocalUserSubsystem = Collection.InitializeDependency<ULocalUserSubsystem>();
+
+	GConfig->GetString(TEXT("OnlineMultiplayer"), TEXT("ListenServerMap"), ListenServerMap, GGameIni);
+
+	// The host starts loading the listen-server map while members are still joining the lobby.
+	OnCreateLobbyCompleteDelegateHandle = LobbySubsystem->OnCreateLobbyCompleteDelegate.AddUObject(this, &ThisClass::OnCreateLobbyComplete);
+	OnLobbyUserPromotedDelegateHandle = LobbySubsystem->OnLobbyUserPromotedDelegate.AddUObject(this, &ThisClass::OnLobbyUserPromoted);
+
+	// Members start loading the map as soon as the host announces it.
+	OnMapNameAttributeChangedDelegateHandle = LobbySubsystem->OnMapNameAttributeChanged.AddUObject(this, &ThisClass::PreloadMap);
+	OnLobbyStoppedDelegateHandle = LobbySubsystem->OnLobbyStoppedDelegate.AddUObject(this, &ThisClass::CancelPreload);
+	
+	PreLoadMapDelegateHandle = FCoreUObjectDelegates::PreLoadMap.AddUObject(this, &ThisClass::OnPreLoadMap);
+	PostLoadMapDelegateHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ThisClass::OnPostLoadMap);
+}
+
+void UMapPreloadSubsystem::Deinitialize()
+{
+	LobbySubsystem->OnMapNameAttributeChanged.Remove(OnMapNameAttributeChangedDelegateHandle);
+	LobbySubsystem->OnLobbyStoppedDelegate.Remove(OnLobbyStoppedDelegateHandle);
+	LobbySubsystem->OnCreateLobbyCompleteDelegate.Remove(OnCreateLobbyCompleteDelegateHandle);
+	LobbySubsystem->OnLobbyUserPromotedDelegate.Remove(OnLobbyUserPromotedDelegateHandle);
+	FCoreUObjectDelegates::PreLoadMap.Remove(PreLoadMapDelegateHandle);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapDelegateHandle);
+	CancelPreload();
+	
+	Super::Deinitialize();
+}
+
+/**
+ * Publishes the map that is about to be traveled to on the lobby, and starts loading it locally.
+ *
+ * Should be called by the host before starting the server.
+ */
+void UMapPreloadSubsystem::AnnounceMap(const FString& InMapName)
+{
+	PreloadMap(InMapName);
+	if(!LobbySubsystem->ActiveLobby()) return;
+	
+	FLobbyAttribute MapNameAttribute;
+	MapNameAttribute.Key = "MapName";
+	MapNameAttribute.Type = ELobbyAttributeType::String;
+	MapNameAttribute.StringValue = InMapName;
+	LobbySubsystem->SetAttribute(MapNameAttribute, [InMapName](const bool bSuccess)
+	{
+		if(!bSuccess) UE_LOG(LogMapPreloadSubsystem, Warning, TEXT("Failed to announce map '%s' on the lobby, members will load it after joining."), *InMapName);
+	});
+}
+
+void UMapPreloadSubsystem::PreloadMap(const FString& InMapName)
+{
+	if(InMapName.IsEmpty() || InMapName == MapName) return;
+	CancelPreload();
+
+	// Strip travel options like '?listen' from the name.
+	FString PackageName;
+	if(!InMapName.Split(TEXT("?"), &PackageName, nullptr)) PackageName = InMapName;
+	if(!FPackageName::IsValidLongPackageName(PackageName))
+	{
+		UE_LOG(LogMapPreloadSubsystem, Warning, TEXT("Cannot preload map '%s', it is not a valid package name."), *InMapName);
+		return;
+	}
+
+	// The live world is torn down by the travel, holding it would leak it. In PIE the live world is a duplicate, and the map can be preloaded.
+	if(UPackage* ExistingPackage = FindPackage(nullptr, *PackageName))
+	{
+		if(UWorld::FindWorldInPackage(ExistingPackage) == GetGameInstance()->GetWorld())
+		{
+			UE_LOG(LogMapPreloadSubsystem, Log, TEXT("Not preloading map '%s', it is the live world and is loaded again by the travel."), *PackageName);
+			return;
+		}
+	}
+	
+	MapName = InMapName;
+	PreloadedPackageName = PackageName;
+	PreloadStartTime = FPlatformTime::Seconds();
+	PreloadCompleteTime = 0.0;
+	TravelStartTime = 0.0;
+
+	UE_LOG(LogMapPreloadSubsystem, Log, TEXT("Preloading map '%s'..."), *PackageName);
+	LoadRequestID = LoadPackageAsync(PackageName, FLoadPackageAsyncDelegate::CreateUObject(this, &ThisClass::OnPackageLoaded));
+}
+
+/**
+ * Loads the listen-server map with its hard references ahead of time, without announcing it to the lobby.
+ */
+void UMapPreloadSubsystem::PrewarmListenServerMap()
+{
+	UE_LOG(LogMapPreloadSubsystem, Log, TEXT("Pre-warming the listen-server map for hosting."));
+	PreloadMap(ListenServerMap);
+}
+
+void UMapPreloadSubsystem::CancelPreload()
+{
+	// A pending request cannot be cancelled, its result is ignored instead.
+	LoadRequestID = INDEX_NONE;
+	PreloadedWorld = nullptr;
+	PreloadedPackageName.Empty();
+	MapName.Empty();
+}
+
+void UMapPreloadSubsystem::OnPackageLoaded(const FName& PackageName, UPackage* LoadedPackage, const EAsyncLoadingResult::Type Result, const int32 RequestID)
+{
+	if(RequestID != LoadRequestID) return;
+	LoadRequestID = INDEX_NONE;
+	
+	UWorld* LoadedWorld = Result == EAsyncLoadingResult::Succeeded && LoadedPackage ? UWorld::FindWorldInPackage(LoadedPackage) : nullptr;
+	if(!LoadedWorld)
+	{
+		UE_LOG(LogMapPreloadSubsystem, Warning, TEXT("Failed to preload map '%s'."), *PackageName.ToString());
+		OnMapPreloadCompleteDelegate.Broadcast(MapName, false);
+		MapName.Empty();
+		return;
+	}
+
+	PreloadedWorld = LoadedWorld;
+	PreloadCompleteTime = FPlatformTime::Seconds();
+	UE_LOG(LogMapPreloadSubsystem, Log, TEXT("Preloaded map '%s' in %.2fs."), *PackageName.ToString(), PreloadCompleteTime - PreloadStartTime);
+	OnMapPreloadCompleteDelegate.Broadcast(MapName, true);
+}
+
+void UMapPreloadSubsystem::OnPreLoadMap(const FString& TravelURL)
+{
+	if(MapName.IsEmpty()) return;
+	TravelStartTime = FPlatformTime::Seconds();
+
+	// The preloaded world stays referenced through the travel's garbage collection, and is released in OnPostLoadMap.
+}
+
+void UMapPreloadSubsystem::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if(MapName.IsEmpty() || TravelStartTime == 0.0) return;
+
+	// Only a travel to the preloaded map used it. In PIE the loaded world is a duplicate of the preloaded one, so the names are compared.
+	if(LoadedWorld && UWorld::RemovePIEPrefix(LoadedWorld->GetOutermost()->GetName()) == PreloadedPackageName)
+	{
+		// The part of the load that happened before the travel started is the time saved.
+		const double LoadedUntil = PreloadCompleteTime > 0.0 ? FMath::Min(PreloadCompleteTime, TravelStartTime) : TravelStartTime;
+		LastTimeSaved = FMath::Max(0.0, LoadedUntil - PreloadStartTime);
+		UE_LOG(LogMapPreloadSubsystem, Log, TEXT("Traveled to preloaded map '%s', saved %.2fs of loading."), *MapName, LastTimeSaved);
+	}
+	else
+	{
+		LastTimeSaved = 0.0;
+		UE_LOG(LogMapPreloadSubsystem, Log, TEXT("Traveled to another map than the preloaded '%s'."), *MapName);
+	}
+
+	CancelPreload();
+}
+
+void UMapPreloadSubsystem::OnCreateLobbyComplete(const ECreateLobbyResultCode Result, const FLobby& Lobby)
+{
+	if(Result == ECreateLobbyResultCode::Success) PrewarmListenServerMap();
+}
+
+void UMapPreloadSubsystem::OnLobbyUserPromoted(const FString& ProductUserID)
+{
+	if(ProductUserID == LocalUserSubsystem->GetLocalUser()->GetProductUserID()) PrewarmListenServerMap();
+}
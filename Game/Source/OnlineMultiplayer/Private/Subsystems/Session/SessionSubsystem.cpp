@@ -7,6 +7,10 @@
 #include "eos_sessions.h"
 #include "Helpers.h"
 #include "GameModes/MultiplayerGameMode.h"
+#include "TimerManager.h"
+#include "Algo/StableSort.h"
+#include "Algo/AnyOf.h"
+#include "Icmp.h"
 
 
 
@@ -19,6 +23,20 @@ void USessionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	LobbySubsystem = Collection.InitializeDependency<ULobbySubsystem>();
 
 	EosManager = &FEosManager::Get();
+
+	// Lobby members join the session as soon as the owner publishes its ID on the lobby.
+	OnSessionIDAttributeChangedDelegateHandle = LobbySubsystem->OnSessionIDAttributeChanged.AddUObject(this, &ThisClass::OnLobbySessionIDChanged);
+
+	Activation.Initialize(this, [this](){ Activate(); });
+}
+
+/**
+ * Gets the sessions interface and registers the invite notification.
+ *
+ * Deferred until first use when the subsystem is lazy, see FLazyActivation.
+ */
+void USessionSubsystem::Activate()
+{
 	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
 	if(!PlatformHandle) return;
 	SessionHandle = EOS_Platform_GetSessionsInterface(PlatformHandle);
@@ -31,7 +49,14 @@ void USessionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 
 void USessionSubsystem::Deinitialize()
 {
-	EOS_Sessions_RemoveNotifySessionInviteReceived(SessionHandle, OnSessionInviteNotification);
+	if(SessionHandle) EOS_Sessions_RemoveNotifySessionInviteReceived(SessionHandle, OnSessionInviteNotification);
+	Activation.Reset();
+	LobbySubsystem->OnSessionIDAttributeChanged.Remove(OnSessionIDAttributeChangedDelegateHandle);
+	SessionSearchByIDHandle = nullptr; // Released by the callback of its search, which then ignores the result.
+	CancelFindSessions();
+	ResetSearchResults();
+	SessionDetailsHandle.Reset();
+	if(const UGameInstance* GameInstance = GetGameInstance()) GameInstance->GetTimerManager().ClearTimer(PlayerRegistrationTimerHandle);
 	
 	Super::Deinitialize();
 }
@@ -42,10 +67,13 @@ void USessionSubsystem::Deinitialize()
 struct FCreateSessionClientData
 {
 	USessionSubsystem* Self;
+	FSessionSettings Settings;
 };
 
 void USessionSubsystem::CreateSession(const FSessionSettings& Settings)
 {
+	Activation.Ensure();
+
 	if(LobbySubsystem->ActiveLobby())
 	{
 		if(LobbySubsystem->GetLobby().OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID())
@@ -77,8 +105,10 @@ void USessionSubsystem::CreateSession(const FSessionSettings& Settings)
 
 	EOS_Sessions_CreateSessionModificationOptions CreateSessionOptions;
 	CreateSessionOptions.ApiVersion = EOS_SESSIONS_CREATESESSIONMODIFICATION_API_LATEST;
-	CreateSessionOptions.SessionName = TCHAR_TO_UTF8(*Settings.Name);
-	CreateSessionOptions.BucketId = "Game:1.0.0";
+	const FTCHARToUTF8 SessionName(*Settings.Name);
+	const FTCHARToUTF8 BucketID(*Settings.BucketID);
+	CreateSessionOptions.SessionName = SessionName.Get();
+	CreateSessionOptions.BucketId = BucketID.Get();
 	CreateSessionOptions.MaxPlayers = Settings.MaxMembers;
 	CreateSessionOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
 	CreateSessionOptions.bPresenceEnabled = true;
@@ -88,13 +118,21 @@ void USessionSubsystem::CreateSession(const FSessionSettings& Settings)
 	const EOS_EResult Result = EOS_Sessions_CreateSessionModification(SessionHandle, &CreateSessionOptions, &SessionModification);
 	if (Result == EOS_EResult::EOS_Success)
 	{
+		// Settings that are not part of the creation options.
+		const EOS_SessionModification_SetJoinInProgressAllowedOptions JoinInProgressOptions{EOS_SESSIONMODIFICATION_SETJOININPROGRESSALLOWED_API_LATEST, Settings.bAllowJoinInProgress ? EOS_TRUE : EOS_FALSE};
+		EOS_SessionModification_SetJoinInProgressAllowed(SessionModification, &JoinInProgressOptions);
+		const EOS_SessionModification_SetInvitesAllowedOptions InvitesAllowedOptions{EOS_SESSIONMODIFICATION_SETINVITESALLOWED_API_LATEST, Settings.bInvitesAllowed ? EOS_TRUE : EOS_FALSE};
+		EOS_SessionModification_SetInvitesAllowed(SessionModification, &InvitesAllowedOptions);
+		
 		EOS_Sessions_UpdateSessionOptions UpdateSessionOptions;
 		UpdateSessionOptions.ApiVersion = EOS_SESSIONS_UPDATESESSION_API_LATEST;
 		UpdateSessionOptions.SessionModificationHandle = SessionModification;
 
-		FCreateSessionClientData* CreateSessionClientData = new FCreateSessionClientData{this};
-		EOS_Sessions_UpdateSession(SessionHandle, &UpdateSessionOptions, this, [](const EOS_Sessions_UpdateSessionCallbackInfo* Data)
+		FCreateSessionClientData* CreateSessionClientData = new FCreateSessionClientData{this, Settings};
+		EosManager->BeginAsyncOperation();
+		EOS_Sessions_UpdateSession(SessionHandle, &UpdateSessionOptions, CreateSessionClientData, [](const EOS_Sessions_UpdateSessionCallbackInfo* Data)
 		{
+			FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 			const FCreateSessionClientData* ClientData = static_cast<FCreateSessionClientData*>(Data->ClientData);
 			USessionSubsystem* SessionSubsystem = ClientData->Self;
 			
@@ -102,25 +140,26 @@ void USessionSubsystem::CreateSession(const FSessionSettings& Settings)
 			{
 				SessionSubsystem->Session.Reset(); // Set everything to default to be sure.
 				SessionSubsystem->Session.ID = Data->SessionId;
+				SessionSubsystem->Session.Name = Data->SessionName;
+				SessionSubsystem->Session.Settings = ClientData->Settings;
 				SessionSubsystem->Session.Settings.Name = Data->SessionName;
+				SessionSubsystem->Session.OwnerID = SessionSubsystem->LocalUserSubsystem->GetLocalUser()->GetProductUserID();
+				SessionSubsystem->RefreshSession();
+				SessionSubsystem->SchedulePlayerRegistrationFlush(); // Players that logged in before the session existed.
 				
 				UE_LOG(LogSessionSubsystem, Warning, TEXT("Session created successfully."));
 				SessionSubsystem->OnCreateSessionCompleteDelegate.Broadcast(ECreateSessionResultCode::Success, SessionSubsystem->Session);
 
-				// If in a lobby, invite all its members to this session.
-				if(ULobbySubsystem* LobbySubsystem = SessionSubsystem->LobbySubsystem; LobbySubsystem->ActiveLobby())
-				{
-					for (UOnlineUser* LobbyMember : LobbySubsystem->GetLobby().GetMemberList())
-					{
-						SessionSubsystem->InvitePlayer(LobbyMember->GetProductUserID());
-					}
-				}
+				// If in a lobby, let all its members know about this session.
+				SessionSubsystem->PublishSessionToLobby();
 			}
 			else
 			{
 				UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to create session. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
 				SessionSubsystem->OnCreateSessionCompleteDelegate.Broadcast(ECreateSessionResultCode::Failure, SessionSubsystem->Session);
 			}
+
+			delete ClientData;
 		});
 
 		// Release the session modification handle
@@ -133,6 +172,142 @@ void USessionSubsystem::CreateSession(const FSessionSettings& Settings)
 	}
 }
 
+/**
+ * Publishes the ID of the newly created session on the lobby, so all members can join it at once.
+ * One lobby update reaches every member, instead of an invite that each member has to receive and accept.
+ */
+void USessionSubsystem::PublishSessionToLobby()
+{
+	if(!LobbySubsystem->ActiveLobby()) return;
+
+	FLobbyAttribute SessionIDAttribute;
+	SessionIDAttribute.Key = "SessionID";
+	SessionIDAttribute.Type = ELobbyAttributeType::String;
+	SessionIDAttribute.StringValue = Session.ID;
+	LobbySubsystem->SetAttribute(SessionIDAttribute, [this](const bool bWasSuccessful)
+	{
+		if(bWasSuccessful)
+		{
+			UE_LOG(LogSessionSubsystem, Log, TEXT("Session-ID published on the lobby."));
+			return;
+		}
+
+		// Fall back to inviting every member separately.
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to publish the Session-ID on the lobby, inviting the lobby members instead."));
+		for (const UOnlineUser* LobbyMember : LobbySubsystem->GetLobby().GetMemberList())
+		{
+			InvitePlayer(LobbyMember->GetProductUserID());
+		}
+	});
+}
+
+/**
+ * Called when the 'SessionID' attribute on the lobby changes.
+ * Members that are not the owner will directly join the published session.
+ */
+void USessionSubsystem::OnLobbySessionIDChanged(const FString& SessionID)
+{
+	if(SessionID.IsEmpty() || SessionID == Session.ID) return;
+
+	// The owner has created the session, so is already in it.
+	if(LobbySubsystem->GetLobby().OwnerID == LocalUserSubsystem->GetLocalUser()->GetProductUserID()) return;
+
+	JoinSessionByID(SessionID);
+}
+
+struct FJoinSessionByIDClientData
+{
+	USessionSubsystem* Self;
+	EOS_HSessionSearch SearchHandle;
+};
+
+/**
+ * Searches for the session with the given ID and joins it.
+ * A search that is still in flight is superseded, its result is ignored.
+ */
+void USessionSubsystem::JoinSessionByID(const FString& SessionID)
+{
+	Activation.Ensure();
+
+	if(ActiveSession())
+	{
+		UE_LOG(LogSessionSubsystem, Log, TEXT("Cannot join a session when already in one."));
+		OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::InSession, Session);
+		return;
+	}
+
+	// Create the Session Search Handle.
+	EOS_Sessions_CreateSessionSearchOptions SessionSearchOptions;
+	SessionSearchOptions.ApiVersion = EOS_SESSIONS_CREATESESSIONSEARCH_API_LATEST;
+	SessionSearchOptions.MaxSearchResults = 1;
+	EOS_HSessionSearch SearchHandle;
+	if(const EOS_EResult Result = EOS_Sessions_CreateSessionSearch(SessionHandle, &SessionSearchOptions, &SearchHandle); Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to create session search handle. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::EosFailure, Session);
+		return;
+	}
+
+	const FTCHARToUTF8 ConvertedSessionID(*SessionID);
+	EOS_SessionSearch_SetSessionIdOptions SetSessionIdOptions;
+	SetSessionIdOptions.ApiVersion = EOS_SESSIONSEARCH_SETSESSIONID_API_LATEST;
+	SetSessionIdOptions.SessionId = ConvertedSessionID.Get();
+	if(const EOS_EResult Result = EOS_SessionSearch_SetSessionId(SearchHandle, &SetSessionIdOptions); Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to set the Session-ID on the search handle. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		EOS_SessionSearch_Release(SearchHandle);
+		OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::EosFailure, Session);
+		return;
+	}
+
+	// Find the session.
+	EOS_SessionSearch_FindOptions FindOptions;
+	FindOptions.ApiVersion = EOS_SESSIONSEARCH_FIND_API_LATEST;
+	FindOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+	SessionSearchByIDHandle = SearchHandle;
+	FJoinSessionByIDClientData* JoinSessionByIDClientData = new FJoinSessionByIDClientData{this, SearchHandle};
+	EosManager->BeginAsyncOperation();
+	EOS_SessionSearch_Find(SearchHandle, &FindOptions, JoinSessionByIDClientData, [](const EOS_SessionSearch_FindCallbackInfo* Data)
+	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+		const FJoinSessionByIDClientData* ClientData = static_cast<FJoinSessionByIDClientData*>(Data->ClientData);
+		USessionSubsystem* SessionSubsystem = ClientData->Self;
+		const EOS_HSessionSearch CompletedSearchHandle = ClientData->SearchHandle;
+		delete ClientData;
+
+		// Ignore a search that has been superseded, or whose subsystem is deinitialized.
+		if(SessionSubsystem->SessionSearchByIDHandle != CompletedSearchHandle)
+		{
+			EOS_SessionSearch_Release(CompletedSearchHandle);
+			return;
+		}
+		SessionSubsystem->SessionSearchByIDHandle = nullptr;
+		
+		if(Data->ResultCode != EOS_EResult::EOS_Success)
+		{
+			UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to find the session. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+			EOS_SessionSearch_Release(CompletedSearchHandle);
+			SessionSubsystem->OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::NotFound, SessionSubsystem->Session);
+			return;
+		}
+
+		// Retrieve the session details handle and join using it. The details are a copy, so the search can be released.
+		EOS_HSessionDetails DetailsHandle;
+		constexpr EOS_SessionSearch_CopySearchResultByIndexOptions CopyOptions = { EOS_SESSIONSEARCH_COPYSEARCHRESULTBYINDEX_API_LATEST, 0 };
+		const EOS_EResult Result = EOS_SessionSearch_CopySearchResultByIndex(CompletedSearchHandle, &CopyOptions, &DetailsHandle);
+		EOS_SessionSearch_Release(CompletedSearchHandle);
+		if(Result == EOS_EResult::EOS_Success)
+		{
+			SessionSubsystem->JoinSessionByHandle(DetailsHandle);
+		}
+		else
+		{
+			UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to retrieve the session details. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+			SessionSubsystem->OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::NotFound, SessionSubsystem->Session);
+		}
+	});
+}
+
 struct FJoinSessionCompleteClientData
 {
 	USessionSubsystem* Self;
@@ -149,47 +324,58 @@ void USessionSubsystem::JoinSessionByHandle(const EOS_HSessionDetails& DetailsHa
 	Options.bPresenceEnabled = true;
 
 	FJoinSessionCompleteClientData* JoinSessionCompleteClientData = new FJoinSessionCompleteClientData{this, DetailsHandle};
+	EosManager->BeginAsyncOperation();
 	EOS_Sessions_JoinSession(SessionHandle, &Options, JoinSessionCompleteClientData, &ThisClass::OnJoinSessionComplete);
 }
 
 void USessionSubsystem::OnJoinSessionComplete(const EOS_Sessions_JoinSessionCallbackInfo* Data)
 {
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 	const FJoinSessionCompleteClientData* ClientData = static_cast<FJoinSessionCompleteClientData*>(Data->ClientData);
 	USessionSubsystem* SessionSubsystem = ClientData->Self;
 	
 	if(Data->ResultCode == EOS_EResult::EOS_Success)
 	{
-		SessionSubsystem->SessionDetailsHandle = ClientData->SessionDetailsHandle;
+		SessionSubsystem->SessionDetailsHandle.Reset(ClientData->SessionDetailsHandle);
 		SessionSubsystem->LoadSession([SessionSubsystem](const bool bSuccess)
 		{
 			if(bSuccess)
 			{
-				// SessionSubsystem->OnJoinLobbyCompleteDelegate.Broadcast(EJoinLobbyResultCode::Success, SessionSubsystem->Session);
+				SessionSubsystem->OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::Success, SessionSubsystem->Session);
 			}
 			else
 			{
 				// TODO: Why did this fail?
 				UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to load the details about this session."));
-				// SessionSubsystem->OnJoinLobbyCompleteDelegate.Broadcast(EJoinLobbyResultCode::Failure, SessionSubsystem->Session);
-				// SessionSubsystem->LeaveLobby();
+				SessionSubsystem->OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::Failure, SessionSubsystem->Session);
 			}
 		});
 	}
-	else UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to join the session. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+	else
+	{
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to join the session. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+		EOS_SessionDetails_Release(ClientData->SessionDetailsHandle);
+		SessionSubsystem->OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::Failure, SessionSubsystem->Session);
+	}
 
 	delete ClientData;
 }
 
 void USessionSubsystem::InvitePlayer(const FString& ProductUserID)
 {
+	Activation.Ensure();
+
+	const FTCHARToUTF8 SessionName(*Session.Settings.Name);
 	EOS_Sessions_SendInviteOptions SendInviteOptions;
 	SendInviteOptions.ApiVersion = EOS_SESSIONS_SENDINVITE_API_LATEST;
-	SendInviteOptions.SessionName = TCHAR_TO_UTF8(*Session.Settings.Name);
+	SendInviteOptions.SessionName = SessionName.Get();
 	SendInviteOptions.LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
 	SendInviteOptions.TargetUserId = EosProductIDFromString(ProductUserID);
 	
+	EosManager->BeginAsyncOperation();
 	EOS_Sessions_SendInvite(SessionHandle, &SendInviteOptions, nullptr, [](const EOS_Sessions_SendInviteCallbackInfo* Data)
 	{
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
 		if(Data->ResultCode != EOS_EResult::EOS_Success) UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to send a session invite. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
 	});
 }
@@ -208,60 +394,584 @@ void USessionSubsystem::OnInviteReceived(const EOS_Sessions_SessionInviteReceive
 
 		EOS_HSessionDetails SessionDetails;
 		const EOS_EResult Result = EOS_Sessions_CopySessionHandleByInviteId(SessionSubsystem->SessionHandle, &Options, &SessionDetails);
-		if(Result == EOS_EResult::EOS_Success)
-		{
-			SessionSubsystem->JoinSessionByHandle(SessionDetails);
-			EOS_SessionDetails_Release(SessionDetails);
-		}
+		if(Result == EOS_EResult::EOS_Success) SessionSubsystem->JoinSessionByHandle(SessionDetails);
 		else UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to 'Copy Session Handle By Invite ID'. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
 	}
 
 	// TODO: when being invited to a session by someone outside your lobby.
 }
 
+// --------------------------------------------
+
+struct FFindSessionsClientData
+{
+	USessionSubsystem* Self;
+	uint32 SearchID;
+	FString BucketID;
+	EOS_HSessionSearch SearchHandle;
+};
+
 /**
- * Returns a new list of attributes which only includes the one's that have actually changed.
- * Will skip special attributes since they are reserved for specific functionality.
+ * Searches all buckets in the settings in parallel.
+ * Results are merged and ranked by ping as each bucket's search completes, see OnFindSessionsUpdateDelegate.
  */
-TArray<FSessionAttribute> USessionSubsystem::FilterAttributes(TArray<FSessionAttribute> Attributes)
+void USessionSubsystem::FindSessions(const FSessionSearchSettings& Settings)
 {
-	TArray<FSessionAttribute> FilteredAttributes;
-	for (const auto& Attribute : Attributes)
+	Activation.Ensure();
+
+	CancelFindSessions();
+	ResetSearchResults();
+
+	if(!Settings.BucketIDs.Num())
 	{
-		// Skip if it is a special attribute.
-		if (SpecialAttributes.Contains(Attribute.Key))
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("Cannot search for sessions without any bucket to search in."));
+		OnFindSessionsCompleteDelegate.Broadcast(EFindSessionsResultCode::Failure, SearchResults);
+		return;
+	}
+
+	SearchSettings = Settings;
+	bSearching = true;
+	const EOS_ProductUserId LocalUserId = EosProductIDFromString(LocalUserSubsystem->GetLocalUser()->GetProductUserID());
+
+	for (const FString& BucketID : Settings.BucketIDs)
+	{
+		EOS_Sessions_CreateSessionSearchOptions SessionSearchOptions;
+		SessionSearchOptions.ApiVersion = EOS_SESSIONS_CREATESESSIONSEARCH_API_LATEST;
+		SessionSearchOptions.MaxSearchResults = FMath::Clamp(Settings.MaxResultsPerBucket, 1, EOS_SESSIONS_MAX_SEARCH_RESULTS);
+
+		EOS_HSessionSearch SearchHandle;
+		if(const EOS_EResult Result = EOS_Sessions_CreateSessionSearch(SessionHandle, &SessionSearchOptions, &SearchHandle); Result != EOS_EResult::EOS_Success)
 		{
-			UE_LOG(LogSessionSubsystem, Warning, TEXT("%s is a special attribute that should not be set using ::SetAttributes, use the corresponding method for it instead."), *Attribute.Key);
+			UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to create session search handle for bucket '%s'. Result-Code: [%s]"), *BucketID, *FString(EOS_EResult_ToString(Result)));
+			continue;
+		}
+
+		// Only search in this bucket.
+		const FTCHARToUTF8 BucketIDUtf8(*BucketID);
+		EOS_Sessions_AttributeData BucketParameter;
+		BucketParameter.ApiVersion = EOS_SESSIONS_ATTRIBUTEDATA_API_LATEST;
+		BucketParameter.Key = EOS_SESSIONS_SEARCH_BUCKET_ID;
+		BucketParameter.Value.AsUtf8 = BucketIDUtf8.Get();
+		BucketParameter.ValueType = EOS_ESessionAttributeType::EOS_AT_STRING;
+
+		// Skip sessions that are full.
+		EOS_Sessions_AttributeData SlotsParameter;
+		SlotsParameter.ApiVersion = EOS_SESSIONS_ATTRIBUTEDATA_API_LATEST;
+		SlotsParameter.Key = EOS_SESSIONS_SEARCH_MINSLOTSAVAILABLE;
+		SlotsParameter.Value.AsInt64 = 1;
+		SlotsParameter.ValueType = EOS_ESessionAttributeType::EOS_AT_INT64;
+
+		const EOS_SessionSearch_SetParameterOptions BucketParameterOptions{EOS_SESSIONSEARCH_SETPARAMETER_API_LATEST, &BucketParameter, EOS_EComparisonOp::EOS_CO_EQUAL};
+		const EOS_SessionSearch_SetParameterOptions SlotsParameterOptions{EOS_SESSIONSEARCH_SETPARAMETER_API_LATEST, &SlotsParameter, EOS_EComparisonOp::EOS_CO_GREATERTHANOREQUAL};
+		if(EOS_SessionSearch_SetParameter(SearchHandle, &BucketParameterOptions) != EOS_EResult::EOS_Success ||
+			EOS_SessionSearch_SetParameter(SearchHandle, &SlotsParameterOptions) != EOS_EResult::EOS_Success)
+		{
+			UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to set the search parameters for bucket '%s'."), *BucketID);
+			EOS_SessionSearch_Release(SearchHandle);
 			continue;
 		}
+
+		EOS_SessionSearch_FindOptions FindOptions;
+		FindOptions.ApiVersion = EOS_SESSIONSEARCH_FIND_API_LATEST;
+		FindOptions.LocalUserId = LocalUserId;
+
+		FFindSessionsClientData* FindSessionsClientData = new FFindSessionsClientData{this, ActiveSearchID, BucketID, SearchHandle};
+		EosManager->BeginAsyncOperation();
+		EOS_SessionSearch_Find(SearchHandle, &FindOptions, FindSessionsClientData, &ThisClass::OnFindSessionsComplete);
+		PendingSearches++;
+	}
+
+	if(!PendingSearches)
+	{
+		bSearching = false;
+		OnFindSessionsCompleteDelegate.Broadcast(EFindSessionsResultCode::EosFailure, SearchResults);
+		return;
+	}
+
+	if(Settings.Timeout > 0.0f)
+	{
+		GetGameInstance()->GetTimerManager().SetTimer(FindSessionsTimeoutHandle, FTimerDelegate::CreateUObject(this, &ThisClass::FinishFindSessions), Settings.Timeout, false);
+	}
+}
+
+void USessionSubsystem::OnFindSessionsComplete(const EOS_SessionSearch_FindCallbackInfo* Data)
+{
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+	const FFindSessionsClientData* ClientData = static_cast<FFindSessionsClientData*>(Data->ClientData);
+	USessionSubsystem* SessionSubsystem = ClientData->Self;
+
+	// Ignore searches that have been cancelled or already finished early.
+	if(SessionSubsystem->bSearching && ClientData->SearchID == SessionSubsystem->ActiveSearchID)
+	{
+		SessionSubsystem->PendingSearches--;
 		
-		const FSessionAttribute* ExistingAttribute = Session.Attributes.Find(Attribute.Key);
+		if(Data->ResultCode == EOS_EResult::EOS_Success)
+		{
+			SessionSubsystem->AddSearchResults(ClientData->SearchHandle, ClientData->BucketID);
+			SessionSubsystem->RankSearchResults();
+			SessionSubsystem->OnFindSessionsUpdateDelegate.Broadcast(SessionSubsystem->SearchResults);
+		}
+		else if(Data->ResultCode != EOS_EResult::EOS_NotFound)
+		{
+			UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to search for sessions in bucket '%s'. Result-Code: [%s]"), *ClientData->BucketID, *FString(EOS_EResult_ToString(Data->ResultCode)));
+		}
 
-		// Add if it does not exist in the cache.
-		if (!ExistingAttribute)
+		// Finish when every bucket has been searched, or when enough results are found.
+		const int32 MinResults = SessionSubsystem->SearchSettings.MinResults;
+		if(!SessionSubsystem->PendingSearches || (MinResults > 0 && SessionSubsystem->SearchResults.Num() >= MinResults))
 		{
-			FilteredAttributes.Add(Attribute);
+			SessionSubsystem->FinishFindSessions();
+		}
+	}
+
+	EOS_SessionSearch_Release(ClientData->SearchHandle);
+	delete ClientData;
+}
+
+/**
+ * Copies the results of a completed search into SearchResults.
+ * The details handles are kept so a result can be joined.
+ */
+void USessionSubsystem::AddSearchResults(const EOS_HSessionSearch& SearchHandle, const FString& BucketID)
+{
+	constexpr EOS_SessionSearch_GetSearchResultCountOptions CountOptions{EOS_SESSIONSEARCH_GETSEARCHRESULTCOUNT_API_LATEST};
+	const uint32_t ResultCount = EOS_SessionSearch_GetSearchResultCount(SearchHandle, &CountOptions);
+
+	for (uint32_t ResultIndex = 0; ResultIndex < ResultCount; ++ResultIndex)
+	{
+		EOS_HSessionDetails DetailsHandle;
+		const EOS_SessionSearch_CopySearchResultByIndexOptions CopyOptions{EOS_SESSIONSEARCH_COPYSEARCHRESULTBYINDEX_API_LATEST, ResultIndex};
+		if(EOS_SessionSearch_CopySearchResultByIndex(SearchHandle, &CopyOptions, &DetailsHandle) != EOS_EResult::EOS_Success) continue;
+
+		constexpr EOS_SessionDetails_CopyInfoOptions CopyInfoOptions{EOS_SESSIONDETAILS_COPYINFO_API_LATEST};
+		EOS_SessionDetails_Info* SessionInfo;
+		if(EOS_SessionDetails_CopyInfo(DetailsHandle, &CopyInfoOptions, &SessionInfo) != EOS_EResult::EOS_Success)
+		{
+			EOS_SessionDetails_Release(DetailsHandle);
+			continue;
+		}
+
+		const FString SessionID = FString(SessionInfo->SessionId);
+		if(SearchResultDetailsHandles.Contains(SessionID) || SessionID == Session.ID)
+		{
+			EOS_SessionDetails_Info_Release(SessionInfo);
+			EOS_SessionDetails_Release(DetailsHandle);
 			continue;
 		}
 
-		// Add if value has differs from what is cached.
-		bool bShouldAdd = false;
-		switch (ExistingAttribute->Type)
+		FSessionSearchResult SearchResult;
+		SearchResult.ID = SessionID;
+		SearchResult.BucketID = BucketID;
+		if(SessionInfo->HostAddress) SearchResult.HostAddress = FString(SessionInfo->HostAddress);
+		SearchResult.OwnerID = EosProductIDToString(SessionInfo->OwnerUserId);
+		SearchResult.OpenSlots = SessionInfo->NumOpenPublicConnections;
+		if(SessionInfo->Settings) SearchResult.MaxMembers = SessionInfo->Settings->NumPublicConnections;
+		for (const FSessionAttribute& Attribute : GetAttributesFromDetailsHandle(DetailsHandle)) SearchResult.Attributes.Add(Attribute.Key, Attribute);
+		
+		SearchResults.Add(SearchResult);
+		SearchResultDetailsHandles.Add(SessionID, DetailsHandle);
+		EOS_SessionDetails_Info_Release(SessionInfo);
+
+		ProbeHostPing(SearchResult.HostAddress);
+	}
+}
+
+/**
+ * Sorts the search results on their cached ping, lowest first. Results without a known ping go last in the order they were found.
+ */
+void USessionSubsystem::RankSearchResults()
+{
+	for (FSessionSearchResult& SearchResult : SearchResults)
+	{
+		const float* PingEstimate = PingEstimates.Find(SearchResult.HostAddress);
+		SearchResult.Ping = PingEstimate ? *PingEstimate : -1.0f;
+	}
+
+	Algo::StableSort(SearchResults, [](const FSessionSearchResult& A, const FSessionSearchResult& B)
+	{
+		if(A.Ping < 0.0f) return false;
+		if(B.Ping < 0.0f) return true;
+		return A.Ping < B.Ping;
+	});
+}
+
+/**
+ * Measures the round-trip time to a host with an ICMP echo, unless its ping is already known or being measured.
+ * The results are re-ranked and broadcast as an update when the echo returns.
+ */
+void USessionSubsystem::ProbeHostPing(const FString& HostAddress)
+{
+	if(HostAddress.IsEmpty() || PingEstimates.Contains(HostAddress) || PingProbesInFlight.Contains(HostAddress)) return;
+	PingProbesInFlight.Add(HostAddress);
+
+	// The host address is published as 'IP:Port', the echo only needs the IP.
+	FString IP = HostAddress;
+	HostAddress.Split(TEXT(":"), &IP, nullptr, ESearchCase::IgnoreCase, ESearchDir::FromEnd);
+	
+	FIcmp::IcmpEcho(IP, PingProbeTimeout, [WeakThis = TWeakObjectPtr<USessionSubsystem>(this), HostAddress](const FIcmpEchoResult Result)
+	{
+		USessionSubsystem* SessionSubsystem = WeakThis.Get();
+		if(!SessionSubsystem) return;
+		
+		SessionSubsystem->PingProbesInFlight.Remove(HostAddress);
+		if(Result.Status != EIcmpResponseStatus::Success)
 		{
-		case ESessionAttributeType::Bool:
-			bShouldAdd = ExistingAttribute->BoolValue != Attribute.BoolValue;
+			UE_LOG(LogSessionSubsystem, Verbose, TEXT("Could not measure the ping to '%s'."), *HostAddress);
+			return;
+		}
+
+		SessionSubsystem->UpdatePingEstimate(HostAddress, Result.Time * 1000.0f);
+		SessionSubsystem->RankSearchResults();
+		SessionSubsystem->OnFindSessionsUpdateDelegate.Broadcast(SessionSubsystem->SearchResults);
+	});
+}
+
+void USessionSubsystem::FinishFindSessions()
+{
+	if(!bSearching) return;
+	bSearching = false;
+	GetGameInstance()->GetTimerManager().ClearTimer(FindSessionsTimeoutHandle);
+
+	UE_LOG(LogSessionSubsystem, Log, TEXT("Session search finished with %d result(s), %d bucket search(es) still pending."), SearchResults.Num(), PendingSearches);
+	OnFindSessionsCompleteDelegate.Broadcast(SearchResults.Num() ? EFindSessionsResultCode::Success : EFindSessionsResultCode::NoResults, SearchResults);
+}
+
+/**
+ * Stops the active search. Results found so far are kept, searches still in progress are ignored when they complete.
+ */
+void USessionSubsystem::CancelFindSessions()
+{
+	bSearching = false;
+	ActiveSearchID++;
+	PendingSearches = 0;
+	if(const UGameInstance* GameInstance = GetGameInstance()) GameInstance->GetTimerManager().ClearTimer(FindSessionsTimeoutHandle);
+}
+
+void USessionSubsystem::ResetSearchResults()
+{
+	for (const TPair<FString, EOS_HSessionDetails>& DetailsHandle : SearchResultDetailsHandles) EOS_SessionDetails_Release(DetailsHandle.Value);
+	SearchResultDetailsHandles.Empty();
+	SearchResults.Empty();
+}
+
+/**
+ * Joins a session that was found by ::FindSessions.
+ */
+void USessionSubsystem::JoinSearchResult(const FString& SessionID)
+{
+	Activation.Ensure();
+
+	if(ActiveSession())
+	{
+		UE_LOG(LogSessionSubsystem, Log, TEXT("Cannot join a session when already in one."));
+		OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::InSession, Session);
+		return;
+	}
+
+	EOS_HSessionDetails DetailsHandle;
+	if(!SearchResultDetailsHandles.RemoveAndCopyValue(SessionID, DetailsHandle))
+	{
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("No search result found with Session-ID '%s'."), *SessionID);
+		OnJoinSessionCompleteDelegate.Broadcast(EJoinSessionResultCode::NotFound, Session);
+		return;
+	}
+	
+	JoinSessionByHandle(DetailsHandle);
+}
+
+/**
+ * Updates the cached ping to a host, which is used to rank search results.
+ * Smoothed to prevent a single spike from changing the ranking.
+ */
+void USessionSubsystem::UpdatePingEstimate(const FString& HostAddress, const float Ping)
+{
+	if(HostAddress.IsEmpty() || Ping < 0.0f) return;
+	
+	if(float* PingEstimate = PingEstimates.Find(HostAddress)) *PingEstimate = *PingEstimate * 0.75f + Ping * 0.25f;
+	else PingEstimates.Add(HostAddress, Ping);
+}
+
+TArray<FSessionAttribute> USessionSubsystem::GetAttributesFromDetailsHandle(const EOS_HSessionDetails& DetailsHandle) const
+{
+	constexpr EOS_SessionDetails_GetSessionAttributeCountOptions AttributeCountOptions{EOS_SESSIONDETAILS_GETSESSIONATTRIBUTECOUNT_API_LATEST};
+	const uint32_t AttributeCount = EOS_SessionDetails_GetSessionAttributeCount(DetailsHandle, &AttributeCountOptions);
+
+	TArray<FSessionAttribute> SessionAttributes;
+	SessionAttributes.Reserve(AttributeCount);
+	for (uint32_t AttributeIndex = 0; AttributeIndex < AttributeCount; ++AttributeIndex)
+	{
+		const EOS_SessionDetails_CopySessionAttributeByIndexOptions AttributeOptions{EOS_SESSIONDETAILS_COPYSESSIONATTRIBUTEBYINDEX_API_LATEST, AttributeIndex};
+		EOS_SessionDetails_Attribute* EosAttribute;
+		if(EOS_SessionDetails_CopySessionAttributeByIndex(DetailsHandle, &AttributeOptions, &EosAttribute) != EOS_EResult::EOS_Success || !EosAttribute || !EosAttribute->Data)
+		{
+			UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to copy an Attribute by Index in ::GetAttributesFromDetailsHandle."));
+			continue;
+		}
+
+		FSessionAttribute SessionAttribute;
+		SessionAttribute.Key = EosAttribute->Data->Key;
+		switch (EosAttribute->Data->ValueType)
+		{
+		case EOS_ESessionAttributeType::EOS_AT_BOOLEAN:
+			SessionAttribute.Type = ESessionAttributeType::Bool;
+			SessionAttribute.BoolValue = EosAttribute->Data->Value.AsBool == EOS_TRUE;
 			break;
-		case ESessionAttributeType::String:
-			bShouldAdd = ExistingAttribute->StringValue != Attribute.StringValue;
+		case EOS_ESessionAttributeType::EOS_AT_STRING:
+			SessionAttribute.Type = ESessionAttributeType::String;
+			SessionAttribute.StringValue = UTF8_TO_TCHAR(EosAttribute->Data->Value.AsUtf8);
 			break;
-		case ESessionAttributeType::Int64:
-			bShouldAdd = ExistingAttribute->IntValue != Attribute.IntValue;
+		case EOS_ESessionAttributeType::EOS_AT_INT64:
+			SessionAttribute.Type = ESessionAttributeType::Int64;
+			SessionAttribute.IntValue = EosAttribute->Data->Value.AsInt64;
 			break;
-		case ESessionAttributeType::Double:
-			bShouldAdd = ExistingAttribute->DoubleValue != Attribute.DoubleValue;
+		case EOS_ESessionAttributeType::EOS_AT_DOUBLE:
+			SessionAttribute.Type = ESessionAttributeType::Double;
+			SessionAttribute.DoubleValue = EosAttribute->Data->Value.AsDouble;
 			break;
 		}
-		if (bShouldAdd) FilteredAttributes.Add(Attribute);
+		SessionAttributes.Add(SessionAttribute);
+		
+		EOS_SessionDetails_Attribute_Release(EosAttribute);
+	}
+	return SessionAttributes;
+}
+
+
+// --------------------------------------------
+
+/**
+ * Queues a player to be registered in the session.
+ * Players queued within a short window are registered in a single call.
+ */
+void USessionSubsystem::RegisterPlayer(const FString& ProductUserID)
+{
+	Activation.Ensure();
+
+	if(ProductUserID.IsEmpty()) return;
+
+	// Cancels out a pending unregistration, e.g. when reconnecting.
+	// While an unregistration is in flight the session still lists the player, so it is registered again after that completes.
+	if(PendingUnregistrations.Remove(ProductUserID)) RegistrationAttempts.Remove(ProductUserID);
+	if(Session.IsPlayerRegistered(ProductUserID) && !PlayersInFlight.Contains(ProductUserID)) return;
+	
+	PendingRegistrations.Add(ProductUserID);
+	SchedulePlayerRegistrationFlush();
+}
+
+/**
+ * Queues a player to be unregistered from the session.
+ */
+void USessionSubsystem::UnregisterPlayer(const FString& ProductUserID)
+{
+	Activation.Ensure();
+
+	if(ProductUserID.IsEmpty()) return;
+
+	// Never sent, so no need to unregister. Unless a registration is still in flight.
+	if(PendingRegistrations.Remove(ProductUserID))
+	{
+		RegistrationAttempts.Remove(ProductUserID);
+		if(!Session.IsPlayerRegistered(ProductUserID) && !PlayersInFlight.Contains(ProductUserID)) return;
+	}
+
+	PendingUnregistrations.Add(ProductUserID);
+	SchedulePlayerRegistrationFlush();
+}
+
+void USessionSubsystem::SchedulePlayerRegistrationFlush()
+{
+	// Players that are in flight are flushed again when their call completes.
+	const auto IsSendable = [this](const FString& Player) { return !PlayersInFlight.Contains(Player); };
+	if(!Algo::AnyOf(PendingRegistrations, IsSendable) && !Algo::AnyOf(PendingUnregistrations, IsSendable)) return;
+	
+	FTimerManager& TimerManager = GetGameInstance()->GetTimerManager();
+	if(TimerManager.IsTimerActive(PlayerRegistrationTimerHandle)) return;
+	TimerManager.SetTimer(PlayerRegistrationTimerHandle, FTimerDelegate::CreateUObject(this, &ThisClass::FlushPlayerRegistrations), PlayerRegistrationWindow, false);
+}
+
+struct FPlayerRegistrationClientData
+{
+	USessionSubsystem* Self;
+	TArray<FString> Players;
+};
+
+/**
+ * Sends all queued (un)registrations, one call each.
+ * Players stay queued while there is no session yet, or while their previous (un)registration is still in flight.
+ */
+void USessionSubsystem::FlushPlayerRegistrations()
+{
+	Activation.Ensure();
+
+	GetGameInstance()->GetTimerManager().ClearTimer(PlayerRegistrationTimerHandle);
+	if(!ActiveSession()) return;
+
+	const FTCHARToUTF8 SessionName(*Session.Name);
+
+	// Takes the players that can be sent from the queue, up to the per-call limit.
+	const auto TakeBatch = [this](TSet<FString>& Pending)
+	{
+		TArray<FString> Players;
+		for (const FString& Player : Pending)
+		{
+			if(Players.Num() == EOS_SESSIONS_MAXREGISTEREDPLAYERS) break;
+			if(!PlayersInFlight.Contains(Player)) Players.Add(Player);
+		}
+		for (const FString& Player : Players)
+		{
+			Pending.Remove(Player);
+			PlayersInFlight.Add(Player);
+		}
+		return Players;
+	};
+	
+	if(TArray<FString> Players = TakeBatch(PendingRegistrations); Players.Num())
+	{
+		TArray<EOS_ProductUserId> PlayerIDs;
+		PlayerIDs.Reserve(Players.Num());
+		for (const FString& Player : Players) PlayerIDs.Add(EosProductIDFromString(Player));
+
+		EOS_Sessions_RegisterPlayersOptions RegisterPlayersOptions;
+		RegisterPlayersOptions.ApiVersion = EOS_SESSIONS_REGISTERPLAYERS_API_LATEST;
+		RegisterPlayersOptions.SessionName = SessionName.Get();
+		RegisterPlayersOptions.PlayersToRegister = PlayerIDs.GetData();
+		RegisterPlayersOptions.PlayersToRegisterCount = PlayerIDs.Num();
+
+		UE_LOG(LogSessionSubsystem, Log, TEXT("Registering %d player(s) in the session."), Players.Num());
+		FPlayerRegistrationClientData* RegisterPlayersClientData = new FPlayerRegistrationClientData{this, MoveTemp(Players)};
+		EosManager->BeginAsyncOperation();
+		EOS_Sessions_RegisterPlayers(SessionHandle, &RegisterPlayersOptions, RegisterPlayersClientData, &ThisClass::OnRegisterPlayersComplete);
+	}
+
+	if(TArray<FString> Players = TakeBatch(PendingUnregistrations); Players.Num())
+	{
+		TArray<EOS_ProductUserId> PlayerIDs;
+		PlayerIDs.Reserve(Players.Num());
+		for (const FString& Player : Players) PlayerIDs.Add(EosProductIDFromString(Player));
+
+		EOS_Sessions_UnregisterPlayersOptions UnregisterPlayersOptions;
+		UnregisterPlayersOptions.ApiVersion = EOS_SESSIONS_UNREGISTERPLAYERS_API_LATEST;
+		UnregisterPlayersOptions.SessionName = SessionName.Get();
+		UnregisterPlayersOptions.PlayersToUnregister = PlayerIDs.GetData();
+		UnregisterPlayersOptions.PlayersToUnregisterCount = PlayerIDs.Num();
+
+		UE_LOG(LogSessionSubsystem, Log, TEXT("Unregistering %d player(s) from the session."), Players.Num());
+		FPlayerRegistrationClientData* UnregisterPlayersClientData = new FPlayerRegistrationClientData{this, MoveTemp(Players)};
+		EosManager->BeginAsyncOperation();
+		EOS_Sessions_UnregisterPlayers(SessionHandle, &UnregisterPlayersOptions, UnregisterPlayersClientData, &ThisClass::OnUnregisterPlayersComplete);
+	}
+
+	// Anything left over the per-call limit goes in the next batch.
+	SchedulePlayerRegistrationFlush();
+}
+
+void USessionSubsystem::OnRegisterPlayersComplete(const EOS_Sessions_RegisterPlayersCallbackInfo* Data)
+{
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+	const FPlayerRegistrationClientData* ClientData = static_cast<FPlayerRegistrationClientData*>(Data->ClientData);
+	USessionSubsystem* SessionSubsystem = ClientData->Self;
+	for (const FString& Player : ClientData->Players) SessionSubsystem->PlayersInFlight.Remove(Player);
+
+	if(Data->ResultCode == EOS_EResult::EOS_Success)
+	{
+		TSet<FString> Handled;
+		for (uint32_t Index = 0; Index < Data->RegisteredPlayersCount; ++Index) Handled.Add(EosProductIDToString(Data->RegisteredPlayers[Index]));
+		for (uint32_t Index = 0; Index < Data->SanctionedPlayersCount; ++Index)
+		{
+			const FString SanctionedPlayer = EosProductIDToString(Data->SanctionedPlayers[Index]);
+			UE_LOG(LogSessionSubsystem, Warning, TEXT("Player '%s' could not be registered because of a sanction."), *SanctionedPlayer);
+			Handled.Add(SanctionedPlayer);
+		}
+
+		// Reconcile the players that were neither registered nor sanctioned.
+		for (const FString& Player : ClientData->Players)
+		{
+			if(Handled.Contains(Player)) SessionSubsystem->RegistrationAttempts.Remove(Player);
+			else SessionSubsystem->RetryPlayerRegistration(Player, true);
+		}
+		SessionSubsystem->RefreshSession();
+	}
+	else
+	{
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to register %d player(s) in the session. Result-Code: [%s]"), ClientData->Players.Num(), *FString(EOS_EResult_ToString(Data->ResultCode)));
+		for (const FString& Player : ClientData->Players) SessionSubsystem->RetryPlayerRegistration(Player, true);
+	}
+
+	// Send what was held back for these players.
+	SessionSubsystem->SchedulePlayerRegistrationFlush();
+	
+	delete ClientData;
+}
+
+void USessionSubsystem::OnUnregisterPlayersComplete(const EOS_Sessions_UnregisterPlayersCallbackInfo* Data)
+{
+	FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+	const FPlayerRegistrationClientData* ClientData = static_cast<FPlayerRegistrationClientData*>(Data->ClientData);
+	USessionSubsystem* SessionSubsystem = ClientData->Self;
+	for (const FString& Player : ClientData->Players) SessionSubsystem->PlayersInFlight.Remove(Player);
+
+	if(Data->ResultCode == EOS_EResult::EOS_Success)
+	{
+		TSet<FString> Unregistered;
+		for (uint32_t Index = 0; Index < Data->UnregisteredPlayersCount; ++Index) Unregistered.Add(EosProductIDToString(Data->UnregisteredPlayers[Index]));
+
+		for (const FString& Player : ClientData->Players)
+		{
+			if(Unregistered.Contains(Player)) SessionSubsystem->RegistrationAttempts.Remove(Player);
+			else SessionSubsystem->RetryPlayerRegistration(Player, false);
+		}
+		SessionSubsystem->RefreshSession();
+	}
+	else
+	{
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to unregister %d player(s) from the session. Result-Code: [%s]"), ClientData->Players.Num(), *FString(EOS_EResult_ToString(Data->ResultCode)));
+		for (const FString& Player : ClientData->Players) SessionSubsystem->RetryPlayerRegistration(Player, false);
+	}
+
+	// Send what was held back for these players.
+	SessionSubsystem->SchedulePlayerRegistrationFlush();
+	
+	delete ClientData;
+}
+
+/**
+ * Queues a failed (un)registration again, unless the player has changed direction in the meantime or it failed too often.
+ */
+void USessionSubsystem::RetryPlayerRegistration(const FString& ProductUserID, const bool bRegister)
+{
+	// A newer (un)registration is already queued for this player.
+	if(PendingRegistrations.Contains(ProductUserID) || PendingUnregistrations.Contains(ProductUserID)) return;
+
+	int32& Attempts = RegistrationAttempts.FindOrAdd(ProductUserID);
+	if(++Attempts >= MaxPlayerRegistrationAttempts)
+	{
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Giving up on %s player '%s' after %d attempts."), bRegister ? TEXT("registering") : TEXT("unregistering"), *ProductUserID, Attempts);
+		RegistrationAttempts.Remove(ProductUserID);
+		return;
+	}
+
+	if(bRegister) PendingRegistrations.Add(ProductUserID);
+	else PendingUnregistrations.Add(ProductUserID);
+	SchedulePlayerRegistrationFlush();
+}
+
+
+// --------------------------------------------
+
+/**
+ * Returns a new list of attributes which only includes the one's that differ from the session.
+ * Compares against the acknowledged attributes, or the in-flight value when an update is being sent.
+ */
+TArray<FSessionAttribute> USessionSubsystem::FilterAttributes(TArray<FSessionAttribute> Attributes)
+{
+	TArray<FSessionAttribute> FilteredAttributes;
+	for (const auto& Attribute : Attributes)
+	{
+		const FSessionAttribute* ExistingAttribute = InFlightAttributes.Find(Attribute.Key);
+		if(!ExistingAttribute) ExistingAttribute = Session.Attributes.Find(Attribute.Key);
+
+		// Add if it does not exist in the cache, or if the value differs from what is cached.
+		if (!ExistingAttribute || !ExistingAttribute->HasSameValue(Attribute)) FilteredAttributes.Add(Attribute);
 	}
 	return FilteredAttributes;
 }
@@ -272,9 +982,13 @@ TArray<FSessionAttribute> USessionSubsystem::FilterAttributes(TArray<FSessionAtt
  */
 bool USessionSubsystem::AddAttributeToHandle(EOS_HSessionModification& Handle, const FSessionAttribute& Attribute)
 {
+	// Converted strings have to outlive the call that adds the attribute.
+	const FTCHARToUTF8 Key(*Attribute.Key);
+	const FTCHARToUTF8 StringValue(*Attribute.StringValue);
+	
 	EOS_Sessions_AttributeData EosAttributeData;
 	EosAttributeData.ApiVersion = EOS_SESSIONS_ATTRIBUTEDATA_API_LATEST;
-	EosAttributeData.Key = TCHAR_TO_ANSI(*Attribute.Key);
+	EosAttributeData.Key = Key.Get();
 			
 	switch (Attribute.Type)
 	{
@@ -284,7 +998,7 @@ bool USessionSubsystem::AddAttributeToHandle(EOS_HSessionModification& Handle, c
 		break;
 	case ESessionAttributeType::String:
 		EosAttributeData.ValueType = EOS_ESessionAttributeType::EOS_AT_STRING;
-		EosAttributeData.Value.AsUtf8 = TCHAR_TO_UTF8(*Attribute.StringValue);
+		EosAttributeData.Value.AsUtf8 = StringValue.Get();
 		break;
 	case ESessionAttributeType::Int64:
 		EosAttributeData.ValueType = EOS_ESessionAttributeType::EOS_AT_INT64;
@@ -304,7 +1018,7 @@ bool USessionSubsystem::AddAttributeToHandle(EOS_HSessionModification& Handle, c
 	// Add the change to the Handle.
 	if (const EOS_EResult Result = EOS_SessionModification_AddAttribute(Handle, &AttributeOptions); Result != EOS_EResult::EOS_Success)
 	{
-		UE_LOG(LogSessionSubsystem, Log, TEXT("Failed to add an attribute to the SessionModification-Handle. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to add the attribute '%s' to the SessionModification-Handle. Result-Code: [%s]"), *Attribute.Key, *FString(EOS_EResult_ToString(Result)));
 		return false;
 	}
 	
@@ -312,175 +1026,226 @@ bool USessionSubsystem::AddAttributeToHandle(EOS_HSessionModification& Handle, c
 }
 
 /**
- * Data needed in EOS_Sessions_UpdateSession after updating an attribute.
+ * Set/update multiple attributes on the session.
+ *
+ * Attributes set within the same frame are sent as one update, and only if they differ from the session.
  */
-struct FSetAttributesClientData
+void USessionSubsystem::SetAttributes(const TArray<FSessionAttribute>& Attributes, const TFunction<void(bool bWasSuccessful)>& Callback)
 {
-	USessionSubsystem* Self;
-	TArray<FSessionAttribute> ChangedAttributes;
-};
+	Activation.Ensure();
+
+	// Skip the special attributes since they are reserved for specific functionality.
+	TArray<FSessionAttribute> CustomAttributes;
+	for (const FSessionAttribute& Attribute : Attributes)
+	{
+		if (SpecialAttributes.Contains(Attribute.Key))
+		{
+			UE_LOG(LogSessionSubsystem, Warning, TEXT("%s is a special attribute that should not be set using ::SetAttributes, use the corresponding method for it instead."), *Attribute.Key);
+			continue;
+		}
+		CustomAttributes.Add(Attribute);
+	}
+
+	QueueAttributes(CustomAttributes, Callback);
+}
+
+void USessionSubsystem::SetSpecialAttribute(const FSessionAttribute& Attribute, const TFunction<void(bool bWasSuccessful)>& Callback)
+{
+	Activation.Ensure();
+
+	if(!SpecialAttributes.Contains(Attribute.Key))
+	{
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Custom session-attributes should be set using the ::SetAttributes method."));
+		if(Callback) Callback(false);
+		return;
+	}
+
+	QueueAttributes(TArray<FSessionAttribute>{Attribute}, Callback);
+}
 
 /**
- * Set/update multiple attributes on the session.
+ * Adds the changed attributes to the pending delta, which is sent at the end of this frame.
+ * When an update is in flight, the delta is held until that update completes.
  */
-void USessionSubsystem::SetAttributes(const TArray<FSessionAttribute>& Attributes)
+void USessionSubsystem::QueueAttributes(const TArray<FSessionAttribute>& Attributes, const TFunction<void(bool bWasSuccessful)>& Callback)
 {
 	// Can only update the session-attributes if owner.
 	if(Session.OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID())
 	{
 		UE_LOG(LogSessionSubsystem, Error, TEXT("Only the session owner can set its attributes."));
+		if(Callback) Callback(false);
 		return;
 	}
 
-	// Filter out the attributes that have changed and are non-special.
+	// An attribute that has been set back to the value on the session no longer has to be sent.
 	const TArray<FSessionAttribute> ChangedAttributes = FilterAttributes(Attributes);
-	if (!ChangedAttributes.Num()) return;
-
-	// Options for creating the Modification-Handle
-	EOS_Sessions_UpdateSessionModificationOptions UpdateSessionModificationOptions;
-	UpdateSessionModificationOptions.ApiVersion = EOS_SESSIONS_UPDATESESSIONMODIFICATION_API_LATEST;
-	UpdateSessionModificationOptions.SessionName = TCHAR_TO_UTF8(*Session.Name);
-
-	EOS_HSessionModification SessionModificationHandle;
-	if (const EOS_EResult Result = EOS_Sessions_UpdateSessionModification(SessionHandle, &UpdateSessionModificationOptions, &SessionModificationHandle); Result == EOS_EResult::EOS_Success)
+	for (const FSessionAttribute& Attribute : Attributes)
 	{
-		// Loop through all attributes and add them to the Handle
-		TArray<FSessionAttribute> SuccessfulAttributes;
-		for (const FSessionAttribute Attribute : ChangedAttributes)
-		{
-			if(AddAttributeToHandle(SessionModificationHandle, Attribute)) SuccessfulAttributes.Add(Attribute);
-		}
-			
-		// Update the session with the Handle.
-		EOS_Sessions_UpdateSessionOptions UpdateSessionOptions;
-		UpdateSessionOptions.ApiVersion = EOS_SESSIONS_UPDATESESSION_API_LATEST;
-		UpdateSessionOptions.SessionModificationHandle = SessionModificationHandle;
-		
-		FSetAttributesClientData* SetAttributeCompleteClientData = new FSetAttributesClientData{this, SuccessfulAttributes};
-		EOS_Sessions_UpdateSession(SessionHandle, &UpdateSessionOptions, SetAttributeCompleteClientData, [](const EOS_Sessions_UpdateSessionCallbackInfo* Data)
-		{
-			const FSetAttributesClientData* ClientData = static_cast<FSetAttributesClientData*>(Data->ClientData);
-			
-			if(Data->ResultCode == EOS_EResult::EOS_Success)
-			{
-				// Cache the updated attribute on the session.
-				TArray<FSessionAttribute> ChangedAttributes = ClientData->ChangedAttributes;
-				for (FSessionAttribute Attribute : ChangedAttributes) ClientData->Self->Session.Attributes.Add(Attribute.Key, Attribute);
-				UE_LOG(LogSessionSubsystem, Log, TEXT("Session Attribute(s) successfully added."))
-			}
-			else UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to update the session with the new attribute(s). Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
+		if(!ChangedAttributes.ContainsByPredicate([&Attribute](const FSessionAttribute& Changed){ return Changed.Key == Attribute.Key; })) PendingAttributes.Remove(Attribute.Key);
+	}
+	for (const FSessionAttribute& Attribute : ChangedAttributes) PendingAttributes.Add(Attribute.Key, Attribute);
 
-			delete ClientData;
-		});
+	if(!PendingAttributes.Num())
+	{
+		if(Callback) Callback(true);
+		return;
+	}
+	if(Callback) PendingAttributeCallbacks.Add(Callback);
 
-		// Release the memory of the Handle.
-		EOS_SessionModification_Release(SessionModificationHandle);
+	if(!bAttributeUpdateInFlight && !GetGameInstance()->GetTimerManager().TimerExists(AttributeUpdateTimerHandle))
+	{
+		AttributeUpdateTimerHandle = GetGameInstance()->GetTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &ThisClass::FlushAttributes));
 	}
-	else UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to create the session-modification-handle for setting the attribute(s). Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
 }
 
 /**
- * Data needed in EOS_Sessions_UpdateSession after updating a special attribute.
+ * Data needed in EOS_Sessions_UpdateSession after updating the attributes.
  */
-struct FSetSpecialAttributeClientData
+struct FUpdateAttributesClientData
 {
 	USessionSubsystem* Self;
-	FSessionAttribute Attribute;
-	TFunction<void(bool bWasSuccessful)> Callback;
+	TArray<TFunction<void(bool bWasSuccessful)>> Callbacks;
+	bool bRejectedAttributes; // Some attributes could not be added to the update, so the callbacks fail.
 };
 
-void USessionSubsystem::SetSpecialAttribute(const FSessionAttribute& Attribute, const TFunction<void(bool bWasSuccessful)>& Callback)
+/**
+ * Sends all pending attributes in a single session update.
+ */
+void USessionSubsystem::FlushAttributes()
 {
-	// Can only update the session-attributes if owner.
-	if(Session.OwnerID != LocalUserSubsystem->GetLocalUser()->GetProductUserID())
+	AttributeUpdateTimerHandle.Invalidate();
+	if(bAttributeUpdateInFlight || !PendingAttributes.Num()) return;
+
+	TArray<TFunction<void(bool bWasSuccessful)>> Callbacks = MoveTemp(PendingAttributeCallbacks);
+	PendingAttributeCallbacks.Reset();
+	
+	// Options for creating the Modification-Handle
+	const FTCHARToUTF8 SessionName(*Session.Name);
+	EOS_Sessions_UpdateSessionModificationOptions UpdateSessionModificationOptions;
+	UpdateSessionModificationOptions.ApiVersion = EOS_SESSIONS_UPDATESESSIONMODIFICATION_API_LATEST;
+	UpdateSessionModificationOptions.SessionName = SessionName.Get();
+
+	EOS_HSessionModification SessionModificationHandle;
+	if (const EOS_EResult Result = EOS_Sessions_UpdateSessionModification(SessionHandle, &UpdateSessionModificationOptions, &SessionModificationHandle); Result != EOS_EResult::EOS_Success)
 	{
-		UE_LOG(LogSessionSubsystem, Error, TEXT("Only the session owner can set its attributes."));
-		Callback(false);
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to create the session-modification-handle for setting the attribute(s). Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		PendingAttributes.Empty();
+		for (const auto& Callback : Callbacks) Callback(false);
 		return;
 	}
 
-	if(!SpecialAttributes.Contains(Attribute.Key))
+	// Add all pending attributes to the Handle, these are now in flight. Rejected attributes are dropped, they would be rejected again.
+	bool bRejectedAttributes = false;
+	for (const TPair<FString, FSessionAttribute>& Attribute : PendingAttributes)
 	{
-		UE_LOG(LogSessionSubsystem, Error, TEXT("Custom session-attributes should be set using the ::SetAttributes method."));
-		Callback(false);
+		if(AddAttributeToHandle(SessionModificationHandle, Attribute.Value)) InFlightAttributes.Add(Attribute.Key, Attribute.Value);
+		else bRejectedAttributes = true;
+	}
+	PendingAttributes.Empty();
+	
+	if(!InFlightAttributes.Num())
+	{
+		EOS_SessionModification_Release(SessionModificationHandle);
+		for (const auto& Callback : Callbacks) Callback(false);
 		return;
 	}
-
-	// Options for creating the Modification-Handle
-	EOS_Sessions_UpdateSessionModificationOptions UpdateSessionModificationOptions;
-	UpdateSessionModificationOptions.ApiVersion = EOS_SESSIONS_UPDATESESSIONMODIFICATION_API_LATEST;
-	UpdateSessionModificationOptions.SessionName = TCHAR_TO_UTF8(*Session.Name);
-
-	EOS_HSessionModification SessionModificationHandle;
-	if (const EOS_EResult Result = EOS_Sessions_UpdateSessionModification(SessionHandle, &UpdateSessionModificationOptions, &SessionModificationHandle); Result == EOS_EResult::EOS_Success)
+	bAttributeUpdateInFlight = true;
+		
+	// Update the session with the Handle.
+	EOS_Sessions_UpdateSessionOptions UpdateSessionOptions;
+	UpdateSessionOptions.ApiVersion = EOS_SESSIONS_UPDATESESSION_API_LATEST;
+	UpdateSessionOptions.SessionModificationHandle = SessionModificationHandle;
+	
+	FUpdateAttributesClientData* UpdateAttributesClientData = new FUpdateAttributesClientData{this, MoveTemp(Callbacks), bRejectedAttributes};
+	EosManager->BeginAsyncOperation();
+	EOS_Sessions_UpdateSession(SessionHandle, &UpdateSessionOptions, UpdateAttributesClientData, [](const EOS_Sessions_UpdateSessionCallbackInfo* Data)
 	{
-		if(!AddAttributeToHandle(SessionModificationHandle, Attribute))
+		FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+		const FUpdateAttributesClientData* ClientData = static_cast<FUpdateAttributesClientData*>(Data->ClientData);
+		USessionSubsystem* SessionSubsystem = ClientData->Self;
+		const bool bSuccess = Data->ResultCode == EOS_EResult::EOS_Success;
+		
+		if(bSuccess)
 		{
-			Callback(false);
-			return;
+			// Cache the acknowledged attributes on the session.
+			SessionSubsystem->Session.Attributes.Append(SessionSubsystem->InFlightAttributes);
+			UE_LOG(LogSessionSubsystem, Log, TEXT("%d session attribute(s) successfully updated."), SessionSubsystem->InFlightAttributes.Num());
+			SessionSubsystem->OnSessionUpdatedDelegate.Broadcast(SessionSubsystem->Session);
+			SessionSubsystem->AttributeUpdateAttempts = 0;
 		}
-			
-		// Update the session with the Handle.
-		EOS_Sessions_UpdateSessionOptions UpdateSessionOptions;
-		UpdateSessionOptions.ApiVersion = EOS_SESSIONS_UPDATESESSION_API_LATEST;
-		UpdateSessionOptions.SessionModificationHandle = SessionModificationHandle;
-		
-		FSetSpecialAttributeClientData* SetSpecialAttributeCompleteClientData = new FSetSpecialAttributeClientData{this, Attribute, Callback};
-		EOS_Sessions_UpdateSession(SessionHandle, &UpdateSessionOptions, SetSpecialAttributeCompleteClientData, [](const EOS_Sessions_UpdateSessionCallbackInfo* Data)
+		else if(++SessionSubsystem->AttributeUpdateAttempts < SessionSubsystem->MaxAttributeUpdateAttempts)
 		{
-			const FSetSpecialAttributeClientData* ClientData = static_cast<FSetSpecialAttributeClientData*>(Data->ClientData);
+			UE_LOG(LogSessionSubsystem, Warning, TEXT("Failed to update the session with the new attribute(s), retrying. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
 			
-			if(Data->ResultCode == EOS_EResult::EOS_Success)
-			{
-				// Cache the updated attribute on the session.
-				const FSessionAttribute ChangedAttribute = ClientData->Attribute;
-				ClientData->Self->Session.Attributes.Add(ChangedAttribute.Key, ChangedAttribute);
-				UE_LOG(LogSessionSubsystem, Log, TEXT("Special session-attribute successfully updated."))
-				ClientData->Callback(true);
-			}
-			else
+			// Sent again with the next update, unless a newer value was set in the meantime. The callbacks wait for that update,
+			// unless they already failed because of rejected attributes.
+			for (const TPair<FString, FSessionAttribute>& Attribute : SessionSubsystem->InFlightAttributes)
 			{
-				UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to update the special session-attribute. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Data->ResultCode)));
-				ClientData->Callback(false);
+				if(!SessionSubsystem->PendingAttributes.Contains(Attribute.Key)) SessionSubsystem->PendingAttributes.Add(Attribute.Key, Attribute.Value);
 			}
-
+			if(ClientData->bRejectedAttributes) for (const auto& Callback : ClientData->Callbacks) Callback(false);
+			else SessionSubsystem->PendingAttributeCallbacks.Insert(ClientData->Callbacks, 0);
+			SessionSubsystem->InFlightAttributes.Empty();
+			SessionSubsystem->bAttributeUpdateInFlight = false;
+			SessionSubsystem->FlushAttributes();
+			
 			delete ClientData;
-		});
+			return;
+		}
+		else
+		{
+			UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to update the session with the new attribute(s) after %d attempts. Result-Code: [%s]"), SessionSubsystem->AttributeUpdateAttempts, *FString(EOS_EResult_ToString(Data->ResultCode)));
+			SessionSubsystem->AttributeUpdateAttempts = 0;
+		}
+		
+		SessionSubsystem->InFlightAttributes.Empty();
+		SessionSubsystem->bAttributeUpdateInFlight = false;
+		for (const auto& Callback : ClientData->Callbacks) Callback(bSuccess && !ClientData->bRejectedAttributes);
 
-		// Release the memory of the Handle.
-		EOS_SessionModification_Release(SessionModificationHandle);
-	}
-	else
-	{
-		UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to create the session-modification-handle for setting the special session-attribute. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
-		Callback(false);
-	}
+		// Send the changes that came in while this update was in flight.
+		SessionSubsystem->FlushAttributes();
+
+		delete ClientData;
+	});
+
+	// Release the memory of the Handle.
+	EOS_SessionModification_Release(SessionModificationHandle);
+}
+
+/**
+ * Copies the settings of a session on EOS into the given settings.
+ */
+static void CopySessionSettings(const EOS_SessionDetails_Settings* EosSettings, FSessionSettings& Settings)
+{
+	if(!EosSettings) return;
+	if(EosSettings->BucketId) Settings.BucketID = FString(UTF8_TO_TCHAR(EosSettings->BucketId));
+	Settings.MaxMembers = EosSettings->NumPublicConnections;
+	Settings.bAllowJoinInProgress = EosSettings->bAllowJoinInProgress == EOS_TRUE;
+	Settings.bInvitesAllowed = EosSettings->bInvitesAllowed == EOS_TRUE;
 }
 
 /*
- * Remember to release the handle after using it with EOS_Session().
+ * The returned handle is released when it goes out of scope.
  */
-EOS_HActiveSession USessionSubsystem::GetActiveSessionHandle() const
+FScopedActiveSessionHandle USessionSubsystem::CopyActiveSessionHandle() const
 {
+	const FTCHARToUTF8 SessionName(*Session.Name);
 	EOS_Sessions_CopyActiveSessionHandleOptions Options;
 	Options.ApiVersion = EOS_SESSIONS_COPYACTIVESESSIONHANDLE_API_LATEST;
-	Options.SessionName = TCHAR_TO_UTF8(*Session.Settings.Name);
+	Options.SessionName = SessionName.Get();
 	
 	EOS_HActiveSession ActiveSessionHandle;
-	if(EOS_Sessions_CopyActiveSessionHandle(SessionHandle, &Options, &ActiveSessionHandle) == EOS_EResult::EOS_Success) return ActiveSessionHandle;
+	if(EOS_Sessions_CopyActiveSessionHandle(SessionHandle, &Options, &ActiveSessionHandle) == EOS_EResult::EOS_Success) return FScopedActiveSessionHandle(ActiveSessionHandle);
 	
 	UE_LOG(LogSessionSubsystem, Log, TEXT("Failed to get the Active-Session-Handle."));
-	return nullptr;
+	return FScopedActiveSessionHandle();
 }
 
+/**
+ * Loads the session that has just been joined into the cache, using the details handle of that session.
+ */
 void USessionSubsystem::LoadSession(TFunction<void(bool bSuccess)> OnCompleteCallback)
 {
-	if(!ActiveSession())
-	{
-		UE_LOG(LogSessionSubsystem, Log, TEXT("Must be in a session first before calling ::LoadSession"));
-		OnCompleteCallback(false);
-		return;
-	}
 	if(!SessionDetailsHandle)
 	{
 		UE_LOG(LogSessionSubsystem, Log, TEXT("SessionDetailsHandle is invalid in ::LoadSession. It should be set after joining a session."));
@@ -490,17 +1255,66 @@ void USessionSubsystem::LoadSession(TFunction<void(bool bSuccess)> OnCompleteCal
 
 	constexpr EOS_SessionDetails_CopyInfoOptions CopyInfoOptions {EOS_SESSIONDETAILS_COPYINFO_API_LATEST};
 	EOS_SessionDetails_Info* SessionInfo;
-	if(const EOS_EResult Result = EOS_SessionDetails_CopyInfo(SessionDetailsHandle, &CopyInfoOptions, &SessionInfo); Result == EOS_EResult::EOS_Success)
+	if(const EOS_EResult Result = EOS_SessionDetails_CopyInfo(SessionDetailsHandle.Get(), &CopyInfoOptions, &SessionInfo); Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to copy the session info. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		SessionDetailsHandle.Reset();
+		OnCompleteCallback(false);
+		return;
+	}
+
+	// Store the details we need.
+	Session.Reset();
+	Session.ID = FString(SessionInfo->SessionId);
+	Session.Name = "PresenceSession";
+	Session.Settings.Name = Session.Name;
+	if(SessionInfo->OwnerUserId) Session.OwnerID = EosProductIDToString(SessionInfo->OwnerUserId);
+	CopySessionSettings(SessionInfo->Settings, Session.Settings);
+	for (const FSessionAttribute& Attribute : GetAttributesFromDetailsHandle(SessionDetailsHandle.Get())) Session.Attributes.Add(Attribute.Key, Attribute);
+	EOS_SessionDetails_Info_Release(SessionInfo);
+
+	// The state and registered players are only known by the active session.
+	OnCompleteCallback(RefreshSession());
+}
+
+/**
+ * Refreshes the state, settings and registered players of the cached session from the active session on EOS.
+ * EOS has no notification for changes to a session, so this is called after every change made through this subsystem.
+ * Reading the session in between only reads the cache.
+ */
+bool USessionSubsystem::RefreshSession()
+{
+	const FScopedActiveSessionHandle ActiveSessionHandle = CopyActiveSessionHandle();
+	if(!ActiveSessionHandle) return false;
+
+	constexpr EOS_ActiveSession_CopyInfoOptions CopyInfoOptions{EOS_ACTIVESESSION_COPYINFO_API_LATEST};
+	EOS_ActiveSession_Info* ActiveSessionInfo;
+	if(const EOS_EResult Result = EOS_ActiveSession_CopyInfo(ActiveSessionHandle.Get(), &CopyInfoOptions, &ActiveSessionInfo); Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogSessionSubsystem, Error, TEXT("Failed to copy the active session info. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+		return false;
+	}
+
+	// ESessionState has the same order as EOS_EOnlineSessionState.
+	Session.State = static_cast<ESessionState>(ActiveSessionInfo->State);
+	if(const EOS_SessionDetails_Info* SessionInfo = ActiveSessionInfo->SessionDetails)
 	{
-		// Store the details we need
 		Session.ID = FString(SessionInfo->SessionId);
-		
-		
-		EOS_SessionDetails_Info_Release(SessionInfo);
+		if(SessionInfo->OwnerUserId) Session.OwnerID = EosProductIDToString(SessionInfo->OwnerUserId);
+		CopySessionSettings(SessionInfo->Settings, Session.Settings);
 	}
-	else
+	EOS_ActiveSession_Info_Release(ActiveSessionInfo);
+
+	// Registered players.
+	constexpr EOS_ActiveSession_GetRegisteredPlayerCountOptions PlayerCountOptions{EOS_ACTIVESESSION_GETREGISTEREDPLAYERCOUNT_API_LATEST};
+	const uint32_t PlayerCount = EOS_ActiveSession_GetRegisteredPlayerCount(ActiveSessionHandle.Get(), &PlayerCountOptions);
+	Session.RegisteredPlayers.Reset(PlayerCount);
+	for (uint32_t PlayerIndex = 0; PlayerIndex < PlayerCount; ++PlayerIndex)
 	{
-		EOS_SessionDetails_Release(SessionDetailsHandle);
-		OnCompleteCallback(false);
+		const EOS_ActiveSession_GetRegisteredPlayerByIndexOptions PlayerOptions{EOS_ACTIVESESSION_GETREGISTEREDPLAYERBYINDEX_API_LATEST, PlayerIndex};
+		if(const EOS_ProductUserId PlayerID = EOS_ActiveSession_GetRegisteredPlayerByIndex(ActiveSessionHandle.Get(), &PlayerOptions)) Session.RegisteredPlayers.Add(EosProductIDToString(PlayerID));
 	}
+
+	OnSessionUpdatedDelegate.Broadcast(Session);
+	return true;
 }
@@ -19,26 +19,45 @@ void ULocalUserSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	
 	const EOS_HPlatform PlatformHandle = EosManager->GetPlatformHandle();
 	if(!PlatformHandle) return;
+
+	// Init platform-local-user subsystems
+	SteamLocalUserSubsystem = Collection.InitializeDependency<USteamLocalUserSubsystem>();
+
+	// Steam is not running when headless, the startup graph then fails the Steam steps instead.
+	if(!SteamUser())
+	{
+		UE_LOG(LogLocalUserSubsystem, Warning, TEXT("Steam is not running, the local-user will not be initialized."));
+		return;
+	}
 	
 	// TODO: Compatibility for other platforms. Set based on certain setting in engine?
 	// Set platform
 	LocalUser->SetPlatform(EPlatform::Steam);
 	LocalUser->SetUserID(SteamLocalUserSubsystem->GetSteamID().ConvertToUint64());
 	if(LocalUser) UE_LOG(LogLocalUserSubsystem, Log, TEXT("LocalUser initialized!"));
-
-	// Init platform-local-user subsystems
-	SteamLocalUserSubsystem = Collection.InitializeDependency<USteamLocalUserSubsystem>();
 	
 	if(LocalUser->GetPlatform() == EPlatform::Steam)
 	{
-		// Get all the information about the local-user.
-		SteamLocalUserSubsystem->LoadLocalUserDetails(*LocalUser);
-		
 		SteamLocalUserSubsystem->OnSessionTicketReady.AddUObject(this, &ULocalUserSubsystem::OnSteamSessionTicketResponse);
 		SteamLocalUserSubsystem->OnEncryptedAppTicketReady.AddUObject(this, &ULocalUserSubsystem::OnSteamEncryptedAppTicketResponse);
 	}
 }
 
+/**
+ * Loads all the information about the local-user from the platform, such as the username and avatar.
+ *
+ * Started by the startup graph of the game-instance.
+ */
+void ULocalUserSubsystem::LoadLocalUserDetails(const TFunction<void(bool bWasSuccessful)>& OnComplete)
+{
+	if(!SteamLocalUserSubsystem || LocalUser->GetPlatform() != EPlatform::Steam)
+	{
+		OnComplete(false);
+		return;
+	}
+	SteamLocalUserSubsystem->LoadLocalUserDetails(*LocalUser, OnComplete);
+}
+
 
 // --------------------------------------------
 
@@ -83,16 +102,40 @@ void ULocalUserSubsystem::OnSteamEncryptedAppTicketResponse(const TArray<uint8>
 }
 
 /**
- * Requests a session ticket from Steam.
+ * Requests a session ticket from Steam. Requests made while waiting for the ticket share it.
  *
  * @param TicketReadyCallback The callback to call when the ticket is ready.
  */
 void ULocalUserSubsystem::RequestSteamSessionTicket(const TFunction<void(std::string TicketString)> TicketReadyCallback)
 {
-	SteamSessionTicketCallback = TicketReadyCallback;
+	SteamSessionTicketCallbacks.Add(TicketReadyCallback);
 	SteamLocalUserSubsystem->RequestSessionTicket();
 }
 
+/**
+ * Makes the next request for a session ticket get a new ticket from Steam, instead of the cached one.
+ */
+void ULocalUserSubsystem::InvalidateSteamSessionTicket()
+{
+	if(SteamLocalUserSubsystem) SteamLocalUserSubsystem->InvalidateSessionTicket();
+}
+
+/**
+ * Called by a login that uses the session ticket, so the ticket is not cancelled while the login is in flight.
+ */
+void ULocalUserSubsystem::AcquireSteamSessionTicket()
+{
+	if(SteamLocalUserSubsystem) SteamLocalUserSubsystem->AcquireSessionTicket();
+}
+
+/**
+ * Called when a login that acquired the session ticket has completed, successful or not.
+ */
+void ULocalUserSubsystem::ReleaseSteamSessionTicket()
+{
+	if(SteamLocalUserSubsystem) SteamLocalUserSubsystem->ReleaseSessionTicket();
+}
+
 /**
  * Called when the Steam session ticket is ready.
  *
@@ -100,29 +143,29 @@ void ULocalUserSubsystem::RequestSteamSessionTicket(const TFunction<void(std::st
  */
 void ULocalUserSubsystem::OnSteamSessionTicketResponse(const TArray<uint8> Ticket)
 {
-	if(!SteamSessionTicketCallback)
+	if(SteamSessionTicketCallbacks.IsEmpty())
 	{
 		UE_LOG(LogLocalUserSubsystem, Error, TEXT("No valid callback in OnSteamSessionTicketResponse"));
 		return;
 	}
+
+	// Moved out first, so a callback can request a ticket again.
+	const TArray<TFunction<void(std::string TicketString)>> Callbacks = MoveTemp(SteamSessionTicketCallbacks);
+	SteamSessionTicketCallbacks.Reset();
 	
+	char Buffer[1024] = "";
 	if (Ticket.Num() > 0)
 	{
-		char Buffer[1024] = "";
 		uint32_t Len = 1024;
 		if (const EOS_EResult Result = EOS_ByteArray_ToString(Ticket.GetData(), Ticket.Num(), Buffer, &Len); Result != EOS_EResult::EOS_Success)
 		{
 			UE_LOG(LogLocalUserSubsystem, Error, TEXT("Failed to convert encrypted app ticket to string"));
 		}
-
-		SteamSessionTicketCallback(Buffer);
 	}
 	else
 	{
 		UE_LOG(LogLocalUserSubsystem, Error, TEXT("Failed to get Auth Session Ticket from Steam"));
-		SteamSessionTicketCallback("");
 	}
 
-	// Clear callback
-	SteamSessionTicketCallback = TFunction<void(std::string TicketString)>();
+	for (const TFunction<void(std::string TicketString)>& Callback : Callbacks) Callback(Buffer);
 }
\ No newline at end of file
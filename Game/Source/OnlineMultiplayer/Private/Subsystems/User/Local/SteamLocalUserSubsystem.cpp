@@ -3,6 +3,7 @@
 #include "Subsystems/User/Local/SteamLocalUserSubsystem.h"
 #include "Subsystems/User/Online/SteamOnlineUserSubsystem.h"
 #include "Types/UserTypes.h"
+#include "Utils/SteamCallbackDispatcher.h"
 
 #pragma warning(push)
 #pragma warning(disable: 4996)
@@ -18,6 +19,13 @@ void USteamLocalUserSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
 	SteamOnlineUserSubsystem = Collection.InitializeDependency<USteamOnlineUserSubsystem>();
+	FSteamCallbackDispatcher::Get().RegisterUObject(this, &ThisClass::OnSessionTicketResponse);
+}
+
+void USteamLocalUserSubsystem::Deinitialize()
+{
+	FSteamCallbackDispatcher::Get().RemoveAll(this);
+	Super::Deinitialize();
 }
 
 
@@ -43,7 +51,7 @@ void USteamLocalUserSubsystem::RequestEncryptedAppTicket()
 	// }
 
 	const SteamAPICall_t RequestEncryptedAppTicket = SteamUser()->RequestEncryptedAppTicket(nullptr, 0);
-	m_EncryptedAppTicketResponseCallResult.Set(RequestEncryptedAppTicket, this, &USteamLocalUserSubsystem::OnEncryptedAppTicketResponse);
+	FSteamCallbackDispatcher::Get().CallUObject(RequestEncryptedAppTicket, this, &USteamLocalUserSubsystem::OnEncryptedAppTicketResponse);
 }
 
 /**
@@ -130,7 +138,7 @@ void USteamLocalUserSubsystem::RequestSessionTicket()
 	uint8 TicketBuffer[1024];
 	uint32 TicketSize = 0;
 	Identity.SetSteamID(SteamUser()->GetSteamID());
-	const HAuthTicket AuthTicket = SteamUser()->GetAuthSessionTicket(TicketBuffer, sizeof(TicketBuffer), &TicketSize, &Identity);
+	AuthTicket = SteamUser()->GetAuthSessionTicket(TicketBuffer, sizeof(TicketBuffer), &TicketSize, &Identity);
 
 	if (AuthTicket == k_HAuthTicketInvalid)
 	{
@@ -143,6 +151,46 @@ void USteamLocalUserSubsystem::RequestSessionTicket()
 	SessionTicket = TArray<uint8>(TicketBuffer, TicketSize);
 }
 
+/**
+ * Drops the current session ticket, so the next request gets a new one from Steam.
+ *
+ * Used when a login with the cached ticket was rejected. The Auth and Connect logins share the ticket,
+ * so it is only cancelled at Steam once no login uses it anymore.
+ */
+void USteamLocalUserSubsystem::InvalidateSessionTicket()
+{
+	if(AuthTicket != k_HAuthTicketInvalid) RetiredAuthTickets.Add(AuthTicket);
+	AuthTicket = k_HAuthTicketInvalid;
+	SessionTicket.Empty();
+	bSessionTicketReady = false;
+	bWaitingForSessionTicket = false;
+
+	if(!NumSessionTicketUsers) CancelRetiredSessionTickets();
+}
+
+/**
+ * Marks the session ticket as used by a login, call ReleaseSessionTicket when the login completes.
+ */
+void USteamLocalUserSubsystem::AcquireSessionTicket()
+{
+	NumSessionTicketUsers++;
+}
+
+/**
+ * Cancels the invalidated tickets once the last login using a ticket has completed.
+ */
+void USteamLocalUserSubsystem::ReleaseSessionTicket()
+{
+	if(!ensure(NumSessionTicketUsers > 0)) return;
+	if(--NumSessionTicketUsers == 0) CancelRetiredSessionTickets();
+}
+
+void USteamLocalUserSubsystem::CancelRetiredSessionTickets()
+{
+	if(SteamUser()) for(const HAuthTicket RetiredTicket : RetiredAuthTickets) SteamUser()->CancelAuthTicket(RetiredTicket);
+	RetiredAuthTickets.Empty();
+}
+
 /**
  * Called on response from Steam after calling GetAuthSessionTicket.
  *
@@ -166,14 +214,18 @@ void USteamLocalUserSubsystem::OnSessionTicketResponse(GetAuthSessionTicketRespo
 // --------------------------------
 
 
-void USteamLocalUserSubsystem::LoadLocalUserDetails(ULocalUser& LocalUser)
+/**
+ * Sets the username right away, the callback is called once the avatar has been fetched as well.
+ */
+void USteamLocalUserSubsystem::LoadLocalUserDetails(ULocalUser& LocalUser, const TFunction<void(bool bWasSuccessful)>& OnComplete)
 {
 	const uint64 UserID = SteamUser()->GetSteamID().ConvertToUint64();
 	LocalUser.SetUserID(UserID);
 	LocalUser.SetUsername(FString(UTF8_TO_TCHAR(SteamFriends()->GetPersonaName())));
 
-	SteamOnlineUserSubsystem->FetchAvatar(UserID, [&LocalUser](UTexture2D* Avatar)
+	SteamOnlineUserSubsystem->FetchAvatar(UserID, [&LocalUser, OnComplete](UTexture2D* Avatar)
 	{
 		LocalUser.SetAvatar(Avatar);
+		if(OnComplete) OnComplete(true); // A user without an avatar is not a failure.
 	});
 }
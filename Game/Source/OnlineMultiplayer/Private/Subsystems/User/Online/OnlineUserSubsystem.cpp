@@ -6,6 +6,23 @@
 #include "EOSManager.h"
 #include "SteamManager.h"
 #include "Subsystems/Connect/ConnectSubsystem.h"
+#include "Subsystems/User/Local/LocalUserSubsystem.h"
+#include "Subsystems/Lobby/LobbySubsystem.h"
+#include "Utils/UserProfileCache.h"
+#include "TimerManager.h"
+#include "Engine/Texture2D.h"
+#include "HAL/IConsoleManager.h"
+
+
+static FAutoConsoleCommandWithWorld OnlineUserCacheReportCommand(
+	TEXT("OnlineUser.CacheReport"),
+	TEXT("Prints the size of the online-user cache, and its hit, miss, eviction and refresh counts."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](const UWorld* World)
+	{
+		const UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		if(UOnlineUserSubsystem* OnlineUserSubsystem = GameInstance ? GameInstance->GetSubsystem<UOnlineUserSubsystem>() : nullptr) OnlineUserSubsystem->LogCacheStats();
+	}));
+
 
 
 UOnlineUserSubsystem::UOnlineUserSubsystem() : SteamManager(&FSteamManager::Get()), EosManager(&FEosManager::Get())
@@ -17,6 +34,19 @@ void UOnlineUserSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	Super::Initialize(Collection);
 
 	SteamOnlineUserSubsystem = Collection.InitializeDependency<USteamOnlineUserSubsystem>();
+
+	int32 CacheTextureMB = MaxCachedTextureBytes / (1024 * 1024);
+	GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("OnlineUserCacheSize"), MaxCachedUsers, GGameIni);
+	GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("OnlineUserCacheTextureMB"), CacheTextureMB, GGameIni);
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("OnlineUserCacheTTL"), CacheTimeToLive, GGameIni);
+	MaxCachedTextureBytes = static_cast<int64>(CacheTextureMB) * 1024 * 1024;
+}
+
+void UOnlineUserSubsystem::Deinitialize()
+{
+	LogCacheStats();
+	
+	Super::Deinitialize();
 }
 
 
@@ -29,70 +59,281 @@ void UOnlineUserSubsystem::Initialize(FSubsystemCollectionBase& Collection)
  */
 void UOnlineUserSubsystem::GetOnlineUser(const FString& ProductUserID, const TFunction<void(FGetOnlineUserResult)> &Callback)
 {
-	if(UOnlineUser** OnlineUser = CachedOnlineUsers.Find(ProductUserID); OnlineUser && *OnlineUser)
+	if(UOnlineUser* OnlineUser = FindCachedUser(ProductUserID))
 	{
 		UE_LOG(LogOnlineUserSubsystem, Log, TEXT("User is cached, skipping fetch for this user."))
-		Callback(FGetOnlineUserResult{*OnlineUser, EGetOnlineUserResultCode::Success});
+		Callback(FGetOnlineUserResult{OnlineUser, EGetOnlineUserResultCode::Success});
 		return;
 	}
 
-	TArray<FString> ProductUserIDList;
-	ProductUserIDList.Add(ProductUserID);
-
-	// Get the information about the user, cache, and call the callback.
-	UConnectSubsystem* ConnectSubsystem = GetGameInstance()->GetSubsystem<UConnectSubsystem>();
-	ConnectSubsystem->GetOnlineUserDetails(ProductUserIDList, [this, Callback](const TArray<UOnlineUser*>& OnlineUserList)
+	RequestOnlineUser(ProductUserID, [Callback](UOnlineUser* OnlineUser)
 	{
-		if(OnlineUserList.IsEmpty())
-		{
-			UE_LOG(LogOnlineUserSubsystem, Error, TEXT("Failed to get the user's details in UOnlineUserSubsystem::GetOnlineUser"))
-			Callback(FGetOnlineUserResult{nullptr, EGetOnlineUserResultCode::Failed});
-		}
-		UOnlineUser* OutOnlineUser = OnlineUserList[0];
-		CachedOnlineUsers.Add(OutOnlineUser->GetProductUserID(), OutOnlineUser);
-		Callback(FGetOnlineUserResult{OutOnlineUser, EGetOnlineUserResultCode::Success});
+		if(!OnlineUser) UE_LOG(LogOnlineUserSubsystem, Error, TEXT("Failed to get the user's details in UOnlineUserSubsystem::GetOnlineUser"))
+		Callback(FGetOnlineUserResult{OnlineUser, OnlineUser ? EGetOnlineUserResultCode::Success : EGetOnlineUserResultCode::Failed});
 	});
 }
 
+struct FGetOnlineUsersState
+{
+	TArray<UOnlineUser*> OnlineUsers; // Same order as the requested IDs.
+	int32 LeftToFetch = 0;
+	bool bFailed = false;
+};
+
 /**
  * Returns a list of users with all necessary properties if they exist.
  * Requires a callback since it will be an asynchronous operation when certain users are not cached yet.
  */
 void UOnlineUserSubsystem::GetOnlineUsers(TArray<FString>& ProductUserIDs, const TFunction<void(FGetOnlineUsersResult)> &Callback)
 {
-	TArray<UOnlineUser*> OutOnlineUsers;
-	TArray<FString> ProductUserIDsToFetch;
-	for (FString& ProductUserID : ProductUserIDs)
+	const TSharedRef<FGetOnlineUsersState> State = MakeShared<FGetOnlineUsersState>();
+	State->OnlineUsers.SetNumZeroed(ProductUserIDs.Num());
+	
+	TArray<int32> IndicesToFetch;
+	for (int32 Index = 0; Index < ProductUserIDs.Num(); ++Index)
 	{
-		if(UOnlineUser** OnlineUser = CachedOnlineUsers.Find(ProductUserID); OnlineUser && *OnlineUser)
+		if(UOnlineUser* OnlineUser = FindCachedUser(ProductUserIDs[Index]))
 		{
 			UE_LOG(LogOnlineUserSubsystem, Log, TEXT("User is cached, skipping fetch for this user."))
-			OutOnlineUsers.Add(*OnlineUser);
+			State->OnlineUsers[Index] = OnlineUser;
 		}
-		else ProductUserIDsToFetch.Add(ProductUserID);
+		else IndicesToFetch.Add(Index);
 	}
 
 	// Done if all user's were cached
-	if(!ProductUserIDsToFetch.Num())
+	if(!IndicesToFetch.Num())
 	{
-		Callback(FGetOnlineUsersResult{OutOnlineUsers, EGetOnlineUserResultCode::Success});
+		Callback(FGetOnlineUsersResult{State->OnlineUsers, EGetOnlineUserResultCode::Success});
 		return;
 	}
 
-	// Get the information about the users, cache them, and call the callback.
+	State->LeftToFetch = IndicesToFetch.Num();
+	for (const int32 Index : IndicesToFetch)
+	{
+		RequestOnlineUser(ProductUserIDs[Index], [State, Index, Callback](UOnlineUser* OnlineUser)
+		{
+			State->OnlineUsers[Index] = OnlineUser;
+			if(!OnlineUser) State->bFailed = true;
+			if(--State->LeftToFetch > 0) return;
+
+			if(State->bFailed) UE_LOG(LogOnlineUserSubsystem, Error, TEXT("Failed to get the details of one or more users in UOnlineUserSubsystem::GetOnlineUsers"))
+			State->OnlineUsers.Remove(nullptr);
+			Callback(FGetOnlineUsersResult{State->OnlineUsers, State->bFailed ? EGetOnlineUserResultCode::Failed : EGetOnlineUserResultCode::Success});
+		});
+	}
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Adds a waiter for the given user, who is fetched together with all other users requested this tick.
+ *
+ * If the user is already being fetched, the waiter is completed with the result of that fetch.
+ */
+void UOnlineUserSubsystem::RequestOnlineUser(const FString& ProductUserID, TFunction<void(UOnlineUser*)>&& OnComplete)
+{
+	if(TArray<TFunction<void(UOnlineUser*)>>* Waiters = RequestWaiters.Find(ProductUserID))
+	{
+		Waiters->Add(MoveTemp(OnComplete));
+		return;
+	}
+
+	RequestWaiters.Add(ProductUserID).Add(MoveTemp(OnComplete));
+	QueuedRequests.Add(ProductUserID);
+
+	if(bFlushScheduled) return;
+	bFlushScheduled = true;
+	GetGameInstance()->GetTimerManager().SetTimerForNextTick(this, &ThisClass::FlushRequests);
+}
+
+/**
+ * Sends the queued requests in a single call, which the connect subsystem splits into chunks that fit a mapping query.
+ */
+void UOnlineUserSubsystem::FlushRequests()
+{
+	bFlushScheduled = false;
+	if(QueuedRequests.IsEmpty()) return;
+
+	TArray<FString> ProductUserIDs = MoveTemp(QueuedRequests);
+	QueuedRequests.Reset();
+	UE_LOG(LogOnlineUserSubsystem, Verbose, TEXT("Fetching the details of %d user(s)."), ProductUserIDs.Num());
+	
 	UConnectSubsystem* ConnectSubsystem = GetGameInstance()->GetSubsystem<UConnectSubsystem>();
-	ConnectSubsystem->GetOnlineUserDetails(ProductUserIDsToFetch, [this, OutOnlineUsers, Callback](const TArray<UOnlineUser*>& OnlineUserList)
+	ConnectSubsystem->GetOnlineUserDetails(ProductUserIDs, [this, ProductUserIDs](const TArray<UOnlineUser*>& OnlineUserList)
+	{
+		CompleteRequests(ProductUserIDs, OnlineUserList);
+	});
+}
+
+/**
+ * Caches the fetched users, and completes every waiter of the requested IDs. Waiters of users that were not fetched get a nullptr.
+ */
+void UOnlineUserSubsystem::CompleteRequests(const TArray<FString>& ProductUserIDs, const TArray<UOnlineUser*>& OnlineUserList)
+{
+	TMap<FString, UOnlineUser*> FetchedUsers;
+	for (UOnlineUser* OnlineUser : OnlineUserList)
+	{
+		if(OnlineUser) FetchedUsers.Add(OnlineUser->GetProductUserID(), AddCachedUser(OnlineUser));
+	}
+
+	for (const FString& ProductUserID : ProductUserIDs)
 	{
-		if(OnlineUserList.IsEmpty())
+		TArray<TFunction<void(UOnlineUser*)>> Waiters;
+		if(!RequestWaiters.RemoveAndCopyValue(ProductUserID, Waiters)) continue;
+
+		UOnlineUser* OnlineUser = FetchedUsers.FindRef(ProductUserID);
+		for (const TFunction<void(UOnlineUser*)>& Waiter : Waiters) Waiter(OnlineUser);
+	}
+
+	// Trimmed after completing the waiters, so a user is never evicted before its requester got it.
+	TrimCache();
+}
+
+
+// -------------------------------- Cache --------------------------------
+
+
+/**
+ * Returns the cached user and marks it as recently used, or nullptr if it is not cached.
+ *
+ * A user older than the time-to-live is still returned, but a refresh is started so the next lookup gets up-to-date details.
+ */
+UOnlineUser* UOnlineUserSubsystem::FindCachedUser(const FString& ProductUserID)
+{
+	UOnlineUser* OnlineUser = CachedOnlineUsers.FindRef(ProductUserID);
+	FOnlineUserCacheEntry* Entry = CacheEntries.Find(ProductUserID);
+	if(!OnlineUser || !Entry)
+	{
+		CacheStats.Misses++;
+		
+		// Persisted profiles are added as expired, so they are shown straight away and refreshed below.
+		FPersistedUserProfile Profile;
+		if(!FUserProfileCache::Get().Load(ProductUserID, Profile)) return nullptr;
+		
+		CacheStats.DiskHits++;
+		OnlineUser = Profile.ToOnlineUser();
+		if(Profile.AvatarPixels.Num())
 		{
-			UE_LOG(LogOnlineUserSubsystem, Error, TEXT("Failed to get the details of on or more users in UOnlineUserSubsystem::GetOnlineUsers"))
-			Callback(FGetOnlineUsersResult{OutOnlineUsers, EGetOnlineUserResultCode::Failed});
+			// Set when the texture is created, unless a refresh has set a newer avatar by then.
+			SteamOnlineUserSubsystem->QueueAvatarUpload(MoveTemp(Profile.AvatarPixels), Profile.AvatarWidth, Profile.AvatarHeight, [WeakUser = TWeakObjectPtr<UOnlineUser>(OnlineUser)](UTexture2D* Avatar)
+			{
+				if(WeakUser.IsValid() && !WeakUser->GetAvatar()) WeakUser->SetAvatar(Avatar);
+			});
 		}
-		
+		CachedOnlineUsers.Add(ProductUserID, OnlineUser);
+		Entry = &CacheEntries.Add(ProductUserID);
+		Entry->FetchedTime = TNumericLimits<double>::Lowest();
+	}
+	else CacheStats.Hits++;
+	
+	const double Now = FPlatformTime::Seconds();
+	Entry->LastAccessTime = Now;
 
-		for (UOnlineUser* OnlineUser : OnlineUserList) CachedOnlineUsers.Add(OnlineUser->GetProductUserID(), OnlineUser);
-		Callback(FGetOnlineUsersResult{OnlineUserList, EGetOnlineUserResultCode::Success});
-	});
+	if(Now - Entry->FetchedTime > CacheTimeToLive && !RequestWaiters.Contains(ProductUserID))
+	{
+		CacheStats.Refreshes++;
+		RequestOnlineUser(ProductUserID, [](UOnlineUser*){});
+	}
+	return OnlineUser;
+}
+
+/**
+ * Adds a fetched user to the cache. If the user was already cached, that object is refreshed and returned instead,
+ * so references to it held elsewhere (like the lobby member list) see the new details.
+ */
+UOnlineUser* UOnlineUserSubsystem::AddCachedUser(UOnlineUser* OnlineUser)
+{
+	const FString ProductUserID = OnlineUser->GetProductUserID();
+	if(UOnlineUser* CachedUser = CachedOnlineUsers.FindRef(ProductUserID))
+	{
+		CachedUser->CopyDetailsFrom(OnlineUser);
+		OnlineUser = CachedUser;
+	}
+	else CachedOnlineUsers.Add(ProductUserID, OnlineUser);
+
+	FOnlineUserCacheEntry& Entry = CacheEntries.FindOrAdd(ProductUserID);
+	Entry.FetchedTime = Entry.LastAccessTime = FPlatformTime::Seconds();
+
+	FUserProfileCache::Get().Store(FPersistedUserProfile::FromOnlineUser(OnlineUser));
+	return OnlineUser;
+}
+
+/**
+ * Evicts the least recently used users that are not pinned, until the cache is within its user and avatar memory limits.
+ */
+void UOnlineUserSubsystem::TrimCache()
+{
+	int64 TextureBytes = 0;
+	for (const TPair<FString, UOnlineUser*>& Pair : CachedOnlineUsers) TextureBytes += GetTextureBytes(Pair.Value);
+
+	while(CachedOnlineUsers.Num() > MaxCachedUsers || TextureBytes > MaxCachedTextureBytes)
+	{
+		const FString* LeastRecentlyUsed = nullptr;
+		double OldestAccessTime = TNumericLimits<double>::Max();
+		for (const TPair<FString, FOnlineUserCacheEntry>& Pair : CacheEntries)
+		{
+			if(Pair.Value.LastAccessTime >= OldestAccessTime || IsPinned(Pair.Key)) continue;
+			OldestAccessTime = Pair.Value.LastAccessTime;
+			LeastRecentlyUsed = &Pair.Key;
+		}
+		if(!LeastRecentlyUsed) break; // Everything left is pinned.
+
+		const FString ProductUserID = *LeastRecentlyUsed;
+		TextureBytes -= GetTextureBytes(CachedOnlineUsers.FindRef(ProductUserID));
+		CachedOnlineUsers.Remove(ProductUserID);
+		CacheEntries.Remove(ProductUserID);
+		CacheStats.Evictions++;
+	}
+}
+
+bool UOnlineUserSubsystem::IsPinned(const FString& ProductUserID)
+{
+	if(PinnedUsers.Contains(ProductUserID)) return true;
+
+	const UGameInstance* GameInstance = GetGameInstance();
+	if(const ULocalUserSubsystem* LocalUserSubsystem = GameInstance->GetSubsystem<ULocalUserSubsystem>())
+	{
+		if(ULocalUser* LocalUser = LocalUserSubsystem->GetLocalUser(); LocalUser && LocalUser->GetProductUserID() == ProductUserID) return true;
+	}
+	if(ULobbySubsystem* LobbySubsystem = GameInstance->GetSubsystem<ULobbySubsystem>())
+	{
+		if(LobbySubsystem->GetLobby().MemberList.Contains(ProductUserID)) return true;
+	}
+	return false;
+}
+
+int64 UOnlineUserSubsystem::GetTextureBytes(const UOnlineUser* OnlineUser)
+{
+	const UTexture2D* Avatar = OnlineUser ? OnlineUser->GetAvatar() : nullptr;
+	return Avatar ? Avatar->CalcTextureMemorySizeEnum(TMC_ResidentMips) : 0;
+}
+
+/**
+ * Keeps the user in the cache until it is unpinned as many times as it was pinned.
+ */
+void UOnlineUserSubsystem::PinUser(const FString& ProductUserID)
+{
+	PinnedUsers.FindOrAdd(ProductUserID)++;
+}
+
+void UOnlineUserSubsystem::UnpinUser(const FString& ProductUserID)
+{
+	int32* PinCount = PinnedUsers.Find(ProductUserID);
+	if(!PinCount) return;
+	if(--(*PinCount) <= 0) PinnedUsers.Remove(ProductUserID);
+}
+
+void UOnlineUserSubsystem::LogCacheStats()
+{
+	int64 TextureBytes = 0;
+	for (const TPair<FString, UOnlineUser*>& Pair : CachedOnlineUsers) TextureBytes += GetTextureBytes(Pair.Value);
+
+	const uint64 Lookups = CacheStats.Hits + CacheStats.Misses;
+	UE_LOG(LogOnlineUserSubsystem, Log, TEXT("Online-user cache: %d/%d users, %.1f/%.1f MB avatars, %llu hits, %llu misses (%.1f%% hit rate, %llu from disk), %llu evictions, %llu refreshes."),
+		CachedOnlineUsers.Num(), MaxCachedUsers, TextureBytes / (1024.0 * 1024.0), MaxCachedTextureBytes / (1024.0 * 1024.0),
+		CacheStats.Hits, CacheStats.Misses, Lookups ? 100.0 * CacheStats.Hits / Lookups : 0.0, CacheStats.DiskHits, CacheStats.Evictions, CacheStats.Refreshes);
 }
 
 void UOnlineUserSubsystem::LoadUserAvatar(const UOnlineUser* OnlineUser, const TFunction<void>& Callback)
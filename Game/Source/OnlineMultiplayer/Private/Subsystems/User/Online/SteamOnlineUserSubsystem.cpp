@@ -2,7 +2,8 @@
 
 #include "Subsystems/User/Online/SteamOnlineUserSubsystem.h"
 #include "Utils/UserUtils.h"
-#include <vector>
+#include "Utils/SteamCallbackDispatcher.h"
+#include "Async/Async.h"
 
 #pragma warning(push)
 #pragma warning(disable: 4996)
@@ -17,6 +18,57 @@
 void USteamOnlineUserSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	
+	FSteamCallbackDispatcher& Dispatcher = FSteamCallbackDispatcher::Get();
+	Dispatcher.RegisterUObject(this, &ThisClass::OnPersonaStateChange);
+	Dispatcher.RegisterUObject(this, &ThisClass::OnAvatarImageLoaded);
+
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("SteamAvatarUploadBudgetMs"), UploadBudgetMs, GGameIni);
+	UploadTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::UploadPreparedAvatars));
+}
+
+void USteamOnlineUserSubsystem::Deinitialize()
+{
+	FSteamCallbackDispatcher::Get().RemoveAll(this);
+	FTSTicker::GetCoreTicker().RemoveTicker(UploadTickerHandle);
+
+	// Nothing will upload or fetch these anymore, so let the callers know instead of leaving them waiting.
+	PreparedAvatars->Close();
+	TMap<uint64, TArray<TFunction<void(UTexture2D*)>>> WaitingCallbacks = MoveTemp(FetchAvatarCallbacks);
+	for (const TPair<uint64, TArray<TFunction<void(UTexture2D*)>>>& Pair : WaitingCallbacks)
+	{
+		for (const TFunction<void(UTexture2D*)>& Callback : Pair.Value) Callback(nullptr);
+	}
+	
+	Super::Deinitialize();
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Can be called from any thread. When the queue is already closed, the avatar is failed on the game thread.
+ */
+void FPreparedAvatarQueue::Enqueue(FPreparedAvatar&& Avatar)
+{
+	Avatars.Enqueue(MoveTemp(Avatar));
+	if(bClosed) AsyncTask(ENamedThreads::GameThread, [Queue = AsShared()]() { Queue->FailAll(); });
+}
+
+/**
+ * Closes the queue and calls the callbacks of the avatars that are still queued with nullptr. Called on the game thread.
+ */
+void FPreparedAvatarQueue::Close()
+{
+	bClosed = true;
+	FailAll();
+}
+
+void FPreparedAvatarQueue::FailAll()
+{
+	FPreparedAvatar Avatar;
+	while (Avatars.Dequeue(Avatar)) Avatar.Callback(nullptr);
 }
 
 
@@ -30,14 +82,14 @@ void USteamOnlineUserSubsystem::FetchAvatar(const uint64 UserID, const TFunction
 	// False when the image is not ready yet. Add callback to the map of callbacks which will be called when ready
 	if (SteamFriends()->RequestUserInformation(SteamUserID, false)) // TODO: Will the OnPersonaStateChange always be triggered when calling this?
 	{
-		FetchAvatarCallbacks.Add(UserID, Callback);
+		FetchAvatarCallbacks.FindOrAdd(UserID).Add(Callback);
 		return;
 	}
 
 	// Image should be ready
-	if (const int ImageData = SteamFriends()->GetLargeFriendAvatar(SteamUserID); ImageData) 
+	if (const int ImageData = SteamFriends()->GetLargeFriendAvatar(SteamUserID); ImageData > 0) 
 	{
-		Callback(ProcessAvatar(ImageData));
+		ProcessAvatar(ImageData, Callback);
 	}
 	else if(ImageData == 0)
 	{
@@ -47,31 +99,74 @@ void USteamOnlineUserSubsystem::FetchAvatar(const uint64 UserID, const TFunction
 	else if(ImageData == -1)
 	{
 		// Avatar is still not ready yet. (Should not reach)
-		FetchAvatarCallbacks.Add(UserID, Callback);
+		FetchAvatarCallbacks.FindOrAdd(UserID).Add(Callback);
 	}
 	
 }
 
-UTexture2D* USteamOnlineUserSubsystem::ProcessAvatar(const int& ImageData)
+/**
+ * The default image source, reads the avatar from the Steam utils.
+ */
+bool USteamOnlineUserSubsystem::ReadSteamAvatarImage(const int ImageData, uint32& OutWidth, uint32& OutHeight, TArray<uint8>& OutPixels)
 {
-	uint32 ImageWidth, ImageHeight;
-	if (SteamUtils()->GetImageSize(ImageData, &ImageWidth, &ImageHeight)) 
-	{
-		// Create buffer large enough to hold the image data
-		std::vector<uint8> Buffer(ImageWidth * ImageHeight * 4); // 4 bytes per pixel for RGBA
+	if (!SteamUtils()->GetImageSize(ImageData, &OutWidth, &OutHeight)) return false;
+	
+	// Steam writes the pixels straight into the buffer that is later copied into the mip data.
+	OutPixels.SetNumUninitialized(OutWidth * OutHeight * 4); // 4 bytes per pixel for RGBA
+	return SteamUtils()->GetImageRGBA(ImageData, OutPixels.GetData(), OutPixels.Num()); // False if the image does not exist.
+}
 
-		// Get the actual image data
-		if (SteamUtils()->GetImageRGBA(ImageData, Buffer.data(), Buffer.size())) 
+/**
+ * Reads the avatar pixels on a worker thread, and queues them for UploadPreparedAvatars which creates the texture and calls the callback.
+ */
+void USteamOnlineUserSubsystem::ProcessAvatar(const int ImageData, const TFunction<void(UTexture2D*)>& Callback)
+{
+	Async(EAsyncExecution::ThreadPool, [PreparedAvatars = PreparedAvatars, ImageSource = ImageSource, ImageData, Callback]()
+	{
+		FPreparedAvatar Avatar;
+		Avatar.Callback = Callback;
+		
+		uint32 ImageWidth = 0, ImageHeight = 0;
+		if (ImageSource(ImageData, ImageWidth, ImageHeight, Avatar.Pixels))
 		{
-			// Avatar image data is now in the buffer
-			// You can use this data to create a texture, save it to a file, etc.
-			return FUserUtils::ImageBufferToTexture2D(Buffer, ImageWidth, ImageHeight); // TODO: Return struct FFetchAvatarResult? or bool bSuccess?
+			Avatar.Width = ImageWidth;
+			Avatar.Height = ImageHeight;
 		}
+		else Avatar.Pixels.Empty();
 		
-		return nullptr; // Image does not exist.
-	}
+		PreparedAvatars->Enqueue(MoveTemp(Avatar));
+	});
+}
+
+/**
+ * Queues avatar pixels that are already in memory, like persisted avatars, to have their texture created within the per-frame budget.
+ */
+void USteamOnlineUserSubsystem::QueueAvatarUpload(TArray<uint8>&& Pixels, const uint32 Width, const uint32 Height, const TFunction<void(UTexture2D*)>& Callback)
+{
+	FPreparedAvatar Avatar;
+	Avatar.Width = Width;
+	Avatar.Height = Height;
+	Avatar.Pixels = MoveTemp(Pixels);
+	Avatar.Callback = Callback;
+	PreparedAvatars->Enqueue(MoveTemp(Avatar));
+}
+
+/**
+ * Creates the textures of the prepared avatars until the per-frame budget is used, the rest waits for the next frame.
+ */
+bool USteamOnlineUserSubsystem::UploadPreparedAvatars(float DeltaTime)
+{
+	const double Deadline = FPlatformTime::Seconds() + UploadBudgetMs / 1000.0;
 	
-	return nullptr; // Image does not exist.
+	FPreparedAvatar Avatar;
+	while (PreparedAvatars->Dequeue(Avatar))
+	{
+		UTexture2D* Texture = Avatar.Pixels.Num() ? FUserUtils::ImageBufferToTexture2D(Avatar.Pixels, Avatar.Width, Avatar.Height) : nullptr;
+		Avatar.Callback(Texture);
+		
+		if (FPlatformTime::Seconds() >= Deadline) break;
+	}
+	return true;
 }
 
 
@@ -79,23 +174,13 @@ void USteamOnlineUserSubsystem::OnPersonaStateChange(PersonaStateChange_t *Data)
 {
 	if(!Data) return;
 	const CSteamID SteamUserID(Data->m_ulSteamID);
-	const uint64 UserID = SteamUserID.ConvertToUint64();
 
 	// If avatar data has changed
 	if (Data->m_nChangeFlags & k_EPersonaChangeAvatar)
 	{
 
-		// If there is a callback in this map, then a function is waiting for it to be called.
-		if(FetchAvatarCallbacks.Num())
-		{
-			// If there is a callback for this ID, then it should be called since the image is now ready
-			const TFunction<void(UTexture2D*)>* FetchAvatarCallback = FetchAvatarCallbacks.Find(UserID);
-			if(!FetchAvatarCallback) return;
-			
-			FetchAvatarCallbacks.Remove(UserID);
-			const int ImageData = SteamFriends()->GetLargeFriendAvatar(SteamUserID); // Image should be ready
-			(*FetchAvatarCallback)(ProcessAvatar(ImageData));
-		}
+		// If there are callbacks for this ID, then they should be called since the image is now ready
+		ProcessWaitingAvatar(SteamUserID);
 
 		// TODO: Listen for user changes and broadcast a delegate so that other modules can react to the changes.
 		
@@ -106,13 +191,20 @@ void USteamOnlineUserSubsystem::OnPersonaStateChange(PersonaStateChange_t *Data)
 void USteamOnlineUserSubsystem::OnAvatarImageLoaded(AvatarImageLoaded_t *pParam)
 {
 	if(!pParam || !pParam->m_steamID.IsValid()) return;
-	const CSteamID SteamUserID(pParam->m_steamID);
-	const uint64 UserID = SteamUserID.ConvertToUint64();
-	
-	const TFunction<void(UTexture2D*)>* FetchAvatarCallback = FetchAvatarCallbacks.Find(UserID);
-	if(!FetchAvatarCallback) return;
+	ProcessWaitingAvatar(CSteamID(pParam->m_steamID));
+}
+
+/**
+ * Reads the avatar of a user that requests are waiting for, and calls all of their callbacks with the same texture.
+ */
+void USteamOnlineUserSubsystem::ProcessWaitingAvatar(const CSteamID SteamUserID)
+{
+	TArray<TFunction<void(UTexture2D*)>> Callbacks;
+	if(!FetchAvatarCallbacks.RemoveAndCopyValue(SteamUserID.ConvertToUint64(), Callbacks)) return;
 	
-	FetchAvatarCallbacks.Remove(UserID);
 	const int ImageData = SteamFriends()->GetLargeFriendAvatar(SteamUserID); // Image should be ready
-	(*FetchAvatarCallback)(ProcessAvatar(ImageData));
+	ProcessAvatar(ImageData, [Callbacks = MoveTemp(Callbacks)](UTexture2D* Avatar)
+	{
+		for (const TFunction<void(UTexture2D*)>& Callback : Callbacks) Callback(Avatar);
+	});
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "EOSManager.h"
+#include "eos_p2p.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+
+
+/**
+ * Benchmarks the variance of the game-thread time under synthetic EOS load, to compare runs with and without EOS thread pinning.
+ *
+ * The affinity is fixed when the SDK initializes, so run the test once with '-EosPinThreads=true' and once with '-EosPinThreads=false'.
+ * Each run stores its result in 'EosFrameVariance.json' in the automation directory, and the second run reports the difference.
+ *
+ * Optional command-line arguments: '-EosFrameVarianceSeconds=' (default 10) and '-EosFrameVarianceQueries=' (NAT-type queries per frame, default 4).
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FEosFrameVarianceTest, "OnlineMultiplayer.EOS.FrameVariance", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+namespace EosFrameVarianceTest
+{
+	struct FResult
+	{
+		int32 NumFrames = 0;
+		double Mean = 0.0;
+		double StdDev = 0.0;
+		double P99 = 0.0;
+		double Max = 0.0;
+	};
+	
+	FResult Summarize(TArray<float>& Samples)
+	{
+		FResult Result;
+		Result.NumFrames = Samples.Num();
+		if(!Samples.Num()) return Result;
+		
+		for (const float Sample : Samples) Result.Mean += Sample;
+		Result.Mean /= Samples.Num();
+		for (const float Sample : Samples) Result.StdDev += FMath::Square(Sample - Result.Mean);
+		Result.StdDev = FMath::Sqrt(Result.StdDev / Samples.Num());
+		
+		Samples.Sort();
+		Result.P99 = Samples[FMath::Min(Samples.Num() - 1, FMath::FloorToInt(Samples.Num() * 0.99f))];
+		Result.Max = Samples.Last();
+		return Result;
+	}
+
+	TSharedRef<FJsonObject> ToJson(const FResult& Result)
+	{
+		const TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+		Object->SetNumberField(TEXT("Frames"), Result.NumFrames);
+		Object->SetNumberField(TEXT("MeanMs"), Result.Mean);
+		Object->SetNumberField(TEXT("StdDevMs"), Result.StdDev);
+		Object->SetNumberField(TEXT("P99Ms"), Result.P99);
+		Object->SetNumberField(TEXT("MaxMs"), Result.Max);
+		return Object;
+	}
+}
+
+bool FEosFrameVarianceTest::RunTest(const FString& Parameters)
+{
+	using namespace EosFrameVarianceTest;
+	
+	const EOS_HPlatform PlatformHandle = FEosManager::Get().GetPlatformHandle();
+	if(!PlatformHandle)
+	{
+		AddWarning(TEXT("The EOS platform is not initialized, skipping the benchmark."));
+		return true;
+	}
+
+	float Duration = 10.0f;
+	int32 QueriesPerFrame = 4;
+	FParse::Value(FCommandLine::Get(), TEXT("EosFrameVarianceSeconds="), Duration);
+	FParse::Value(FCommandLine::Get(), TEXT("EosFrameVarianceQueries="), QueriesPerFrame);
+
+	const EOS_HP2P P2PHandle = EOS_Platform_GetP2PInterface(PlatformHandle);
+	const double EndTime = FPlatformTime::Seconds() + Duration;
+	const TSharedRef<TArray<float>> Samples = MakeShared<TArray<float>>();
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, P2PHandle, EndTime, QueriesPerFrame, Samples]()
+	{
+		// Synthetic load on the SDK threads.
+		constexpr EOS_P2P_QueryNATTypeOptions QueryNATTypeOptions{ EOS_P2P_QUERYNATTYPE_API_LATEST };
+		for (int32 Index = 0; Index < QueriesPerFrame; ++Index)
+		{
+			FEosManager::Get().BeginAsyncOperation();
+			EOS_P2P_QueryNATType(P2PHandle, &QueryNATTypeOptions, nullptr, [](const EOS_P2P_OnQueryNATTypeCompleteInfo* Data)
+			{
+				FEosManager::Get().EndAsyncOperation(Data->ResultCode);
+			});
+		}
+		
+		Samples->Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+		if(FPlatformTime::Seconds() < EndTime) return false;
+
+		const FResult Result = Summarize(*Samples);
+		if(!TestTrue(TEXT("Frames were sampled"), Result.NumFrames > 0)) return true;
+		
+		const FString Pinning = FEosManager::Get().AreThreadsPinned() ? TEXT("Pinned") : TEXT("Unpinned");
+		AddInfo(FString::Printf(TEXT("%s: Game-thread time over %d frames, Mean: %.2fms, StdDev: %.2fms, P99: %.2fms, Max: %.2fms"),
+			*Pinning, Result.NumFrames, Result.Mean, Result.StdDev, Result.P99, Result.Max));
+
+		// Keep the result of the other pinning state from an earlier run, so both can be compared.
+		const FString ResultsPath = FPaths::Combine(FPaths::AutomationDir(), TEXT("EosFrameVariance.json"));
+		TSharedPtr<FJsonObject> Results;
+		FString Json;
+		if(FFileHelper::LoadFileToString(Json, *ResultsPath)) FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Results);
+		if(!Results.IsValid()) Results = MakeShared<FJsonObject>();
+		Results->SetObjectField(Pinning, ToJson(Result));
+
+		const TSharedPtr<FJsonObject>* Pinned;
+		const TSharedPtr<FJsonObject>* Unpinned;
+		if(Results->TryGetObjectField(TEXT("Pinned"), Pinned) && Results->TryGetObjectField(TEXT("Unpinned"), Unpinned))
+		{
+			AddInfo(FString::Printf(TEXT("StdDev pinned: %.2fms, unpinned: %.2fms. P99 pinned: %.2fms, unpinned: %.2fms."),
+				(*Pinned)->GetNumberField(TEXT("StdDevMs")), (*Unpinned)->GetNumberField(TEXT("StdDevMs")),
+				(*Pinned)->GetNumberField(TEXT("P99Ms")), (*Unpinned)->GetNumberField(TEXT("P99Ms"))));
+		}
+		
+		Json.Reset();
+		FJsonSerializer::Serialize(Results.ToSharedRef(), TJsonWriterFactory<>::Create(&Json));
+		TestTrue(TEXT("Result is saved"), FFileHelper::SaveStringToFile(Json, *ResultsPath));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif
@@ -0,0 +1,100 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Utils/HostElection.h"
+
+
+
+namespace HostElectionTest
+{
+	FHostCandidateProfile MakeProfile(const FString& ProductUserID, const TMap<FString, float>& RoundTripTimes, const bool bIsOwner = false, const float UploadKbps = 0.0f, const uint8 NATType = 0)
+	{
+		FHostCandidateProfile Profile;
+		Profile.ProductUserID = ProductUserID;
+		Profile.RoundTripTimes = RoundTripTimes;
+		Profile.bIsOwner = bIsOwner;
+		Profile.UploadKbps = UploadKbps;
+		Profile.NATType = NATType;
+		return Profile;
+	}
+}
+
+/**
+ * Scores simulated member profiles against the default weights.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHostElectionScoreTest, "OnlineMultiplayer.HostElection.Score", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FHostElectionScoreTest::RunTest(const FString& Parameters)
+{
+	using namespace HostElectionTest;
+	const TArray<FString> Members = { TEXT("A"), TEXT("B"), TEXT("C") };
+
+	TestEqual(TEXT("Mean round-trip time"), FHostElection::Score(MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}), Members), 35.0f);
+	TestEqual(TEXT("Owner bonus"), FHostElection::Score(MakeProfile(TEXT("A"), {{TEXT("B"), 120.0f}, {TEXT("C"), 130.0f}}, true), Members), 110.0f);
+	TestEqual(TEXT("Unknown round-trip time"), FHostElection::Score(MakeProfile(TEXT("B"), {{TEXT("A"), 50.0f}}), Members), 150.0f);
+	TestEqual(TEXT("Moderate NAT"), FHostElection::Score(MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}, false, 0.0f, 2), Members), 55.0f);
+	TestEqual(TEXT("Strict NAT"), FHostElection::Score(MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}, false, 0.0f, 3), Members), 185.0f);
+
+	// Two clients need 512 kbps, so 128 kbps misses three quarters of it.
+	TestEqual(TEXT("Upload shortfall"), FHostElection::Score(MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}, false, 128.0f), Members), 185.0f);
+	TestEqual(TEXT("Enough upload"), FHostElection::Score(MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}, false, 1024.0f), Members), 35.0f);
+
+	TestEqual(TEXT("Only member"), FHostElection::Score(MakeProfile(TEXT("A"), {}), { TEXT("A") }), 0.0f);
+	return true;
+}
+
+/**
+ * Elects a host out of simulated lobbies.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHostElectionElectTest, "OnlineMultiplayer.HostElection.Elect", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FHostElectionElectTest::RunTest(const FString& Parameters)
+{
+	using namespace HostElectionTest;
+
+	TestEqual(TEXT("No candidates"), FHostElection::Elect({}), FString());
+	
+	TestEqual(TEXT("Better connected member wins"), FHostElection::Elect({
+		MakeProfile(TEXT("A"), {{TEXT("B"), 120.0f}, {TEXT("C"), 130.0f}}, true),
+		MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}),
+		MakeProfile(TEXT("C"), {{TEXT("A"), 60.0f}, {TEXT("B"), 30.0f}})
+	}), FString(TEXT("B")));
+
+	TestEqual(TEXT("Owner keeps hosting without a clear improvement"), FHostElection::Elect({
+		MakeProfile(TEXT("A"), {{TEXT("B"), 50.0f}, {TEXT("C"), 50.0f}}, true),
+		MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 40.0f}}),
+		MakeProfile(TEXT("C"), {{TEXT("A"), 50.0f}, {TEXT("B"), 40.0f}})
+	}), FString(TEXT("A")));
+
+	TestEqual(TEXT("Strict NAT loses"), FHostElection::Elect({
+		MakeProfile(TEXT("A"), {{TEXT("B"), 120.0f}, {TEXT("C"), 130.0f}}, true),
+		MakeProfile(TEXT("B"), {{TEXT("A"), 40.0f}, {TEXT("C"), 30.0f}}, false, 0.0f, 3),
+		MakeProfile(TEXT("C"), {{TEXT("A"), 130.0f}, {TEXT("B"), 130.0f}})
+	}), FString(TEXT("A")));
+
+	// A has not measured anything itself, but the others have measured it.
+	TestEqual(TEXT("One-sided measurements are used"), FHostElection::Elect({
+		MakeProfile(TEXT("A"), {}),
+		MakeProfile(TEXT("B"), {{TEXT("A"), 30.0f}, {TEXT("C"), 200.0f}}, true),
+		MakeProfile(TEXT("C"), {{TEXT("A"), 30.0f}, {TEXT("B"), 200.0f}})
+	}), FString(TEXT("A")));
+
+	// Every member has to elect the same host, regardless of the order of the profiles.
+	TestEqual(TEXT("Ties go to the lowest ID"), FHostElection::Elect({
+		MakeProfile(TEXT("0002"), {{TEXT("0001"), 50.0f}}),
+		MakeProfile(TEXT("0001"), {{TEXT("0002"), 50.0f}})
+	}), FString(TEXT("0001")));
+
+	FHostCandidateProfile Parsed;
+	const FHostCandidateProfile Profile = MakeProfile(TEXT("A"), {{TEXT("B"), 32.5f}}, false, 4096.0f, 1);
+	TestTrue(TEXT("Profile parses"), FHostCandidateProfile::FromString(TEXT("A"), Profile.ToString(), Parsed));
+	TestEqual(TEXT("Parsed upload"), Parsed.UploadKbps, Profile.UploadKbps);
+	TestEqual(TEXT("Parsed NAT type"), Parsed.NATType, Profile.NATType);
+	TestEqual(TEXT("Parsed round-trip time"), Parsed.RoundTripTimes.FindRef(TEXT("B")), 32.5f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,83 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "GameInstances/MultiplayerGameInstance.h"
+#include "Types/UserTypes.h"
+#include "Utils/StartupGraph.h"
+#include "Utils/StubOnline.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+
+namespace LoginWallTimeTest
+{
+	// Injected latency of every stubbed step, unless '-StubOnlineLatencyMs=' is given.
+	constexpr float LatencyMs = 200.0f;
+
+	const FStartupGraph::FStep* FindStep(const FStartupGraph& Graph, const FName Name)
+	{
+		return Graph.GetSteps().FindByPredicate([Name](const FStartupGraph::FStep& Step) { return Step.Name == Name; });
+	}
+}
+
+/**
+ * Runs the startup steps of the game-instance with stubbed online services and injected latency, including the Auth login.
+ *
+ * The steps and their dependencies are the ones of the real startup, only their results are stubbed. The ticket waits for the
+ * Steam user, and the logins for the ticket, so the startup should take three latencies with both logins running at the same time.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStartupStubWallTimeTest, "OnlineMultiplayer.Startup.LoginWallTime", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FStartupStubWallTimeTest::RunTest(const FString& Parameters)
+{
+	using namespace LoginWallTimeTest;
+
+	// Restored when the test completes.
+	float PreviousLatencyMs = 0.0f;
+	bool bPreviousAuthLogin = false;
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("StubOnlineLatencyMs"), PreviousLatencyMs, GGameIni);
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bAuthLoginOnStartup"), bPreviousAuthLogin, GGameIni);
+	GConfig->SetFloat(TEXT("OnlineMultiplayer"), TEXT("StubOnlineLatencyMs"), LatencyMs, GGameIni);
+	GConfig->SetBool(TEXT("OnlineMultiplayer"), TEXT("bAuthLoginOnStartup"), true, GGameIni);
+	const float Latency = FStubOnline::GetLatency();
+
+	const TStrongObjectPtr<UMultiplayerGameInstance> GameInstance(NewObject<UMultiplayerGameInstance>());
+	const TStrongObjectPtr<ULocalUser> LocalUser(NewObject<ULocalUser>());
+	GameInstance->StartupGraph = MakeShared<FStartupGraph>();
+	GameInstance->AddStartupSteps(LocalUser.Get(), true);
+	GConfig->SetBool(TEXT("OnlineMultiplayer"), TEXT("bAuthLoginOnStartup"), bPreviousAuthLogin, GGameIni);
+	
+	const TSharedRef<FStartupGraph> Graph = GameInstance->StartupGraph.ToSharedRef();
+	Graph->Start();
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, GameInstance, LocalUser, Graph, Latency, PreviousLatencyMs]()
+	{
+		if(!Graph->IsComplete()) return false;
+		GConfig->SetFloat(TEXT("OnlineMultiplayer"), TEXT("StubOnlineLatencyMs"), PreviousLatencyMs, GGameIni);
+
+		const double WallTime = Graph->GetEndTime() - Graph->GetStartTime();
+		AddInfo(FString::Printf(TEXT("Startup wall time with %.0f ms latency per step: %.0f ms."), Latency * 1000.0f, WallTime * 1000.0));
+		Graph->LogTimeline();
+
+		TestTrue(TEXT("Startup succeeded"), Graph->WasSuccessful());
+		TestTrue(TEXT("Startup takes at least three latencies"), WallTime >= Latency * 3.0f * 0.99f);
+		TestTrue(TEXT("Startup takes no more than three latencies"), WallTime < Latency * 3.5f);
+
+		const FStartupGraph::FStep* ConnectLogin = FindStep(*Graph, TEXT("ConnectLogin"));
+		const FStartupGraph::FStep* AuthLogin = FindStep(*Graph, TEXT("AuthLogin"));
+		if(TestNotNull(TEXT("Connect login step"), ConnectLogin) && TestNotNull(TEXT("Auth login step"), AuthLogin))
+		{
+			TestTrue(TEXT("Logins run at the same time"), AuthLogin->StartTime < ConnectLogin->EndTime && ConnectLogin->StartTime < AuthLogin->EndTime);
+		}
+		
+		TestTrue(TEXT("Connect login result"), LocalUser->IsConnectLoggedIn());
+		TestTrue(TEXT("Auth login result"), LocalUser->IsAuthLoggedIn());
+		return true;
+	}));
+	return true;
+}
+
+#endif
@@ -0,0 +1,71 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Utils/PublicAddressCache.h"
+#include "HttpServerModule.h"
+#include "HttpServerResponse.h"
+#include "IHttpRouter.h"
+
+
+
+/**
+ * Resolves the public address against a local HTTP server that stands in for the lookup endpoint.
+ *
+ * Also checks that the override skips the lookup entirely.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPublicAddressCacheLookupTest, "OnlineMultiplayer.PublicAddress.Lookup", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FPublicAddressCacheLookupTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32 Port = 18085;
+	const FString StandInAddress = TEXT("203.0.113.7");
+	
+	const TSharedPtr<IHttpRouter> Router = FHttpServerModule::Get().GetHttpRouter(Port);
+	if(!TestTrue(TEXT("Local HTTP router is available"), Router.IsValid())) return false;
+
+	const TSharedRef<int32> RequestCount = MakeShared<int32>(0);
+	const FHttpRouteHandle Route = Router->BindRoute(FHttpPath(TEXT("/ip")), EHttpServerRequestVerbs::VERB_GET,
+		FHttpRequestHandler::CreateLambda([StandInAddress, RequestCount](const FHttpServerRequest&, const FHttpResultCallback& OnComplete)
+		{
+			++*RequestCount;
+			OnComplete(FHttpServerResponse::Create(StandInAddress, TEXT("text/plain")));
+			return true;
+		}));
+	FHttpServerModule::Get().StartAllListeners();
+
+	// Created per test so the module's cache is left alone.
+	const TSharedRef<FPublicAddressCache> Cache = MakeShareable(new FPublicAddressCache());
+	Cache->LookupURL = FString::Printf(TEXT("http://127.0.0.1:%u/ip"), Port);
+	Cache->AddFallbackResolver(TEXT("Test"), []() -> FString { return TEXT("10.0.0.1"); });
+
+	// The override should be returned right away, without a request to the endpoint.
+	FString OverrideResult;
+	Cache->AddressOverride = TEXT("198.51.100.1");
+	Cache->ResolveAddress([&OverrideResult](const FString& Address){ OverrideResult = Address; });
+	TestEqual(TEXT("Override is used"), OverrideResult, Cache->AddressOverride);
+	TestFalse(TEXT("Override skips the lookup"), Cache->bLookupInFlight);
+	Cache->AddressOverride.Empty();
+
+	// The wait is longer than the request timeout, so the request never outlives the cache.
+	const TSharedRef<FString> Result = MakeShared<FString>();
+	Cache->ResolveAddress([Result](const FString& Address){ *Result = Address; }, 15.0f);
+
+	const double StartTime = FPlatformTime::Seconds();
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Cache, Result, RequestCount, Router, Route, StandInAddress, StartTime]()
+	{
+		if(Result->IsEmpty() && FPlatformTime::Seconds() - StartTime < 20.0) return false;
+
+		TestEqual(TEXT("Address comes from the lookup"), *Result, StandInAddress);
+		TestEqual(TEXT("Lookup endpoint was requested once"), *RequestCount, 1);
+		TestTrue(TEXT("Looked up address is cached"), Cache->HasFreshAddress());
+		Router->UnbindRoute(Route);
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif
@@ -0,0 +1,137 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Subsystems/User/Online/SteamOnlineUserSubsystem.h"
+#include "Engine/Texture2D.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+
+namespace SteamAvatarPipelineTest
+{
+	constexpr uint32 Size = 8;
+	constexpr int NumImages = 6; // Image 0 can not be read.
+	constexpr double TimeoutSeconds = 5.0;
+
+	/** Fills every pixel with the image handle, instead of reading from Steam. */
+	bool ReadImage(const int ImageData, uint32& OutWidth, uint32& OutHeight, TArray<uint8>& OutPixels)
+	{
+		if(ImageData == 0) return false;
+		OutWidth = Size;
+		OutHeight = Size;
+		OutPixels.Init(static_cast<uint8>(ImageData), Size * Size * 4);
+		return true;
+	}
+
+	bool IsExpectedTexture(UTexture2D* Texture, const int ImageData)
+	{
+		if(ImageData == 0) return Texture == nullptr;
+		if(!Texture || Texture->GetSizeX() != Size || Texture->GetSizeY() != Size) return false;
+		
+		FByteBulkData& BulkData = Texture->GetPlatformData()->Mips[0].BulkData;
+		const uint8* Pixels = static_cast<const uint8*>(BulkData.LockReadOnly());
+		const bool bExpected = Pixels && Pixels[0] == ImageData && Pixels[Size * Size * 4 - 1] == ImageData;
+		BulkData.Unlock();
+		return bExpected;
+	}
+
+	struct FState
+	{
+		TMap<int, bool> Results; // Image handle, and whether its callback got the expected result.
+		TArray<int32> UploadsPerFrame;
+		bool bDeinitialized = false; // Every callback should get nullptr from then on.
+		double StartTime = 0.0;
+	};
+
+	TFunction<void(UTexture2D*)> MakeCallback(const TSharedRef<FState>& State, const int ImageData)
+	{
+		return [State, ImageData](UTexture2D* Texture)
+		{
+			State->Results.Add(ImageData, State->bDeinitialized ? Texture == nullptr : IsExpectedTexture(Texture, ImageData));
+		};
+	}
+
+	/** Queues pixels that are already in memory, skipping the worker. */
+	void QueueImage(USteamOnlineUserSubsystem& Subsystem, const TSharedRef<FState>& State, const int ImageData)
+	{
+		uint32 Width = 0, Height = 0;
+		TArray<uint8> Pixels;
+		ReadImage(ImageData, Width, Height, Pixels);
+		Subsystem.QueueAvatarUpload(MoveTemp(Pixels), Width, Height, MakeCallback(State, ImageData));
+	}
+
+	bool AllSucceeded(const FState& State)
+	{
+		for (const TPair<int, bool>& Result : State.Results) if(!Result.Value) return false;
+		return true;
+	}
+}
+
+/**
+ * Runs avatars through the worker and the budgeted upload with an injected image source, without Steam.
+ *
+ * Without a budget every frame uploads exactly one avatar, and with a large budget a frame uploads everything that is queued.
+ * After Deinitialize the queued avatars, and the avatars that a worker finishes later, fail with nullptr.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSteamAvatarPipelineTest, "OnlineMultiplayer.Steam.AvatarPipeline", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FSteamAvatarPipelineTest::RunTest(const FString& Parameters)
+{
+	using namespace SteamAvatarPipelineTest;
+	
+	// Not initialized, so nothing is registered with Steam and the uploads are driven by the test instead of the ticker.
+	const TStrongObjectPtr<USteamOnlineUserSubsystem> Subsystem(NewObject<USteamOnlineUserSubsystem>());
+	Subsystem->SetAvatarImageSource(&ReadImage);
+	Subsystem->UploadBudgetMs = 0.0f;
+	
+	const TSharedRef<FState> State = MakeShared<FState>();
+	State->StartTime = FPlatformTime::Seconds();
+	for (int ImageData = 0; ImageData < NumImages; ++ImageData) Subsystem->ProcessAvatar(ImageData, MakeCallback(State, ImageData));
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Subsystem, State]()
+	{
+		const int32 NumResults = State->Results.Num();
+		Subsystem->UploadPreparedAvatars(0.0f);
+		if(State->Results.Num() > NumResults) State->UploadsPerFrame.Add(State->Results.Num() - NumResults);
+		
+		if(State->Results.Num() < NumImages && FPlatformTime::Seconds() - State->StartTime < TimeoutSeconds) return false;
+
+		TestEqual(TEXT("Every avatar calls its callback"), State->Results.Num(), NumImages);
+		TestTrue(TEXT("Callbacks get the texture, or nullptr if the image could not be read"), AllSucceeded(*State));
+		TestEqual(TEXT("One upload per frame without a budget"), State->UploadsPerFrame, TArray<int32>{1, 1, 1, 1, 1, 1});
+		
+		// A large budget uploads everything that is queued in the same frame.
+		State->Results.Reset();
+		Subsystem->UploadBudgetMs = 1000.0f;
+		for (int ImageData = 1; ImageData <= 3; ++ImageData) QueueImage(*Subsystem, State, ImageData);
+		Subsystem->UploadPreparedAvatars(0.0f);
+		TestEqual(TEXT("Queued avatars upload in one frame within a large budget"), State->Results.Num(), 3);
+		TestTrue(TEXT("Callbacks get the texture within a large budget"), AllSucceeded(*State));
+		
+		// Deinitialize fails what is still queued, and what the worker queues afterwards.
+		State->Results.Reset();
+		State->bDeinitialized = true;
+		for (int ImageData = 1; ImageData <= 2; ++ImageData) QueueImage(*Subsystem, State, ImageData);
+		Subsystem->ProcessAvatar(3, MakeCallback(State, 3));
+		Subsystem->Deinitialize();
+		TestTrue(TEXT("Queued avatars fail on Deinitialize"), State->Results.Contains(1) && State->Results.Contains(2));
+		
+		State->StartTime = FPlatformTime::Seconds();
+		return true;
+	}));
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State]()
+	{
+		if(State->Results.Num() < 3 && FPlatformTime::Seconds() - State->StartTime < TimeoutSeconds) return false;
+
+		TestEqual(TEXT("Avatars finished after Deinitialize call their callback"), State->Results.Num(), 3);
+		TestTrue(TEXT("Avatars fail with nullptr after Deinitialize"), AllSucceeded(*State));
+		return true;
+	}));
+	return true;
+}
+
+#endif
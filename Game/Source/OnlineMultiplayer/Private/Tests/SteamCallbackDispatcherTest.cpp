@@ -0,0 +1,174 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Utils/SteamCallbackDispatcher.h"
+
+
+
+/**
+ * Feeds synthetic callbacks and call-results through a separate dispatcher, without Steam.
+ *
+ * Checks the order of the handlers, removing handlers while dispatching, and registrations that are made while dispatching.
+ * Manual dispatch drains a fake pipe, to check that a frame over budget leaves the rest for the next frames.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSteamCallbackDispatcherTest, "OnlineMultiplayer.Steam.CallbackDispatcher", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FSteamCallbackDispatcherTest::RunTest(const FString& Parameters)
+{
+	// IDs that Steam never sends. Manual dispatch, so nothing is registered with Steam itself.
+	constexpr int32 CallbackA = 990001;
+	constexpr int32 CallbackB = 990002;
+	constexpr int32 NumDispatches = 5000;
+	
+	FSteamCallbackDispatcher Dispatcher;
+	Dispatcher.bManualDispatch = true;
+	
+	const int32 Owners[4] = {};
+	TArray<int32> Calls;
+	const auto Record = [&Calls](const int32 Handler) { return [&Calls, Handler](void*) { Calls.Add(Handler); }; };
+
+	// Handlers run in the order they were registered, for every dispatch.
+	for (int32 Handler = 0; Handler < 3; ++Handler) Dispatcher.RegisterInternal(&Owners[Handler], CallbackA, sizeof(int32), Record(Handler));
+	for (int32 Index = 0; Index < NumDispatches; ++Index) Dispatcher.Dispatch(CallbackA, nullptr);
+	
+	bool bInOrder = Calls.Num() == NumDispatches * 3;
+	for (int32 Index = 0; bInOrder && Index < Calls.Num(); ++Index) bInOrder = Calls[Index] == Index % 3;
+	TestTrue(TEXT("Handlers run in registration order"), bInOrder);
+	TestEqual(TEXT("Every dispatch is profiled"), Dispatcher.Profiles.FindChecked(CallbackA).Count, static_cast<int64>(NumDispatches));
+
+	// Unknown callback-IDs are ignored.
+	Calls.Reset();
+	Dispatcher.Dispatch(CallbackB, nullptr);
+	TestEqual(TEXT("Callback without handlers is ignored"), Calls.Num(), 0);
+
+	// A handler that removes a later handler while dispatching, that handler is skipped right away and removed afterwards.
+	for (const int32& Owner : Owners) Dispatcher.RemoveAll(&Owner);
+	Dispatcher.RegisterInternal(&Owners[0], CallbackA, sizeof(int32), [&Dispatcher, &Owners, &Calls](void*)
+	{
+		Calls.Add(3);
+		Dispatcher.RemoveAll(&Owners[2]);
+	});
+	Dispatcher.RegisterInternal(&Owners[1], CallbackA, sizeof(int32), Record(1));
+	Dispatcher.RegisterInternal(&Owners[2], CallbackA, sizeof(int32), Record(2));
+	Calls.Reset();
+	Dispatcher.Dispatch(CallbackA, nullptr);
+	TestEqual(TEXT("Removed handler is skipped in the same dispatch"), Calls, TArray<int32>{3, 1});
+	TestEqual(TEXT("Removed handler is compacted after the dispatch"), Dispatcher.Callbacks.FindChecked(CallbackA).Handlers.Num(), 2);
+
+	// A handler that removes itself.
+	Dispatcher.RemoveAll(&Owners[0]);
+	Dispatcher.RegisterInternal(&Owners[0], CallbackA, sizeof(int32), [&Dispatcher, &Owners, &Calls](void*)
+	{
+		Calls.Add(4);
+		Dispatcher.RemoveAll(&Owners[0]);
+	});
+	Calls.Reset();
+	for (int32 Index = 0; Index < NumDispatches; ++Index) Dispatcher.Dispatch(CallbackA, nullptr);
+	TestEqual(TEXT("Handler that removed itself runs once"), Calls.FilterByPredicate([](const int32 Call){ return Call == 4; }).Num(), 1);
+	TestEqual(TEXT("Remaining handler keeps running"), Calls.FilterByPredicate([](const int32 Call){ return Call == 1; }).Num(), NumDispatches);
+
+	// Registrations made while dispatching only take effect after the outermost dispatch, also with a nested dispatch.
+	Dispatcher.RemoveAll(&Owners[1]);
+	Dispatcher.RegisterInternal(&Owners[1], CallbackB, sizeof(int32), Record(9));
+	int32 NumRegistered = 0;
+	Dispatcher.RegisterInternal(&Owners[1], CallbackA, sizeof(int32), [&](void*)
+	{
+		Calls.Add(5);
+		if(NumRegistered++ > 0) return;
+		
+		Dispatcher.RegisterInternal(&Owners[3], CallbackA, sizeof(int32), Record(6));
+		Dispatcher.RegisterInternal(&Owners[3], CallbackB, sizeof(int32), Record(7));
+		Dispatcher.Dispatch(CallbackB, nullptr);
+	});
+	Calls.Reset();
+	Dispatcher.Dispatch(CallbackA, nullptr);
+	TestEqual(TEXT("Deferred handlers do not run in the dispatch that registered them"), Calls, TArray<int32>{5, 9});
+	Calls.Reset();
+	Dispatcher.Dispatch(CallbackA, nullptr);
+	Dispatcher.Dispatch(CallbackB, nullptr);
+	TestEqual(TEXT("Deferred handlers run in later dispatches"), Calls, TArray<int32>{5, 6, 9, 7});
+	TestEqual(TEXT("Nothing is left deferred"), Dispatcher.DeferredHandlers.Num(), 0);
+
+	// Removing an owner also drops its registrations that are still deferred.
+	Dispatcher.RegisterInternal(&Owners[2], CallbackB, sizeof(int32), [&](void*)
+	{
+		Dispatcher.RegisterInternal(&Owners[2], CallbackB, sizeof(int32), Record(8));
+		Dispatcher.RemoveAll(&Owners[2]);
+	});
+	Calls.Reset();
+	Dispatcher.Dispatch(CallbackB, nullptr);
+	Dispatcher.Dispatch(CallbackB, nullptr);
+	TestEqual(TEXT("Deferred handler of a removed owner never runs"), Calls, TArray<int32>{9, 7, 9, 7});
+
+	// Call-results complete exactly once, in whatever order they arrive, and are forgotten afterwards.
+	TArray<SteamAPICall_t> Completed;
+	int32 NumIOFailures = 0;
+	for (SteamAPICall_t ApiCall = 1; ApiCall <= NumDispatches; ++ApiCall)
+	{
+		Dispatcher.CallInternal(&Owners[ApiCall % 2], ApiCall, CallbackB, sizeof(int32), [&Completed, &NumIOFailures, ApiCall](void*, const bool bIOFailure)
+		{
+			Completed.Add(ApiCall);
+			if(bIOFailure) ++NumIOFailures;
+		});
+	}
+	Dispatcher.RemoveAll(&Owners[0]); // Drops the even API-calls.
+	for (SteamAPICall_t ApiCall = NumDispatches; ApiCall >= 1; --ApiCall) Dispatcher.DispatchCallResult(ApiCall, nullptr, ApiCall % 4 == 1);
+	for (SteamAPICall_t ApiCall = 1; ApiCall <= NumDispatches; ++ApiCall) Dispatcher.DispatchCallResult(ApiCall, nullptr, false);
+	
+	bool bCompletedOnce = Completed.Num() == NumDispatches / 2;
+	for (int32 Index = 0; bCompletedOnce && Index < Completed.Num(); ++Index) bCompletedOnce = Completed[Index] == NumDispatches - 1 - Index * 2;
+	TestTrue(TEXT("Pending call-results complete once, in arrival order"), bCompletedOnce);
+	TestEqual(TEXT("IO failures are passed on"), NumIOFailures, NumDispatches / 4);
+	TestEqual(TEXT("No call-results are left pending"), Dispatcher.PendingCalls.Num(), 0);
+
+	// A frame stops dispatching once its budget is used, the rest stays in the pipe for the next frames.
+	constexpr int32 CallbackC = 990003;
+	constexpr int32 NumMessages = 10;
+	constexpr double HandlerSeconds = 0.001;
+	int32 Payloads[NumMessages];
+	int32 NextMessage = 0;
+	int32 NumFreed = 0;
+	Dispatcher.ManualDispatchPipe.RunFrame = [](){};
+	Dispatcher.ManualDispatchPipe.GetNextCallback = [&](CallbackMsg_t& OutMessage)
+	{
+		if(NextMessage == NumMessages) return false;
+		Payloads[NextMessage] = NextMessage;
+		OutMessage = {};
+		OutMessage.m_iCallback = CallbackC;
+		OutMessage.m_pubParam = reinterpret_cast<uint8*>(&Payloads[NextMessage++]);
+		OutMessage.m_cubParam = sizeof(int32);
+		return true;
+	};
+	Dispatcher.ManualDispatchPipe.FreeLastCallback = [&NumFreed]() { ++NumFreed; };
+	Dispatcher.bInitialized = true;
+	Dispatcher.BudgetMs = 2.5f;
+
+	const int32 FrameOwner = 0;
+	Calls.Reset();
+	Dispatcher.RegisterInternal(&FrameOwner, CallbackC, sizeof(int32), [&Calls](void* Data)
+	{
+		Calls.Add(*static_cast<int32*>(Data));
+		const double End = FPlatformTime::Seconds() + HandlerSeconds;
+		while (FPlatformTime::Seconds() < End) {}
+	});
+	
+	Dispatcher.RunFrame();
+	const int32 NumFirstFrame = Calls.Num();
+	TestTrue(TEXT("A frame over budget leaves the rest in the pipe"), NumFirstFrame >= 1 && NumFirstFrame < NumMessages);
+	TestEqual(TEXT("Only the dispatched callbacks are taken from the pipe"), NextMessage, NumFirstFrame);
+	
+	Dispatcher.RunFrame();
+	TestTrue(TEXT("The next frame continues with the rest"), Calls.Num() > NumFirstFrame);
+	
+	for (int32 Frame = 2; Frame < NumMessages * 2 && NextMessage < NumMessages; ++Frame) Dispatcher.RunFrame();
+	bool bDispatchedInOrder = Calls.Num() == NumMessages;
+	for (int32 Index = 0; bDispatchedInOrder && Index < Calls.Num(); ++Index) bDispatchedInOrder = Calls[Index] == Index;
+	TestTrue(TEXT("Callbacks carried over to later frames are dispatched once, in order"), bDispatchedInOrder);
+	TestEqual(TEXT("Every dispatched callback is freed"), NumFreed, NumMessages);
+	return true;
+}
+
+#endif
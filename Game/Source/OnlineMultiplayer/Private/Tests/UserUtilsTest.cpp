@@ -0,0 +1,43 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Utils/UserUtils.h"
+#include "Engine/Texture2D.h"
+
+
+
+/**
+ * Creates a texture from a known RGBA buffer, and reads mip 0 back to compare the pixels.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FUserUtilsImageBufferTest, "OnlineMultiplayer.UserUtils.ImageBufferToTexture2D", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FUserUtilsImageBufferTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32 Width = 4;
+	constexpr uint32 Height = 2;
+	TArray<uint8> Pixels;
+	Pixels.SetNumUninitialized(Width * Height * 4);
+	for (int32 Index = 0; Index < Pixels.Num(); ++Index) Pixels[Index] = static_cast<uint8>(Index * 7 + 3);
+
+	TestNull(TEXT("Buffer with the wrong size"), FUserUtils::ImageBufferToTexture2D(TConstArrayView<uint8>(Pixels.GetData(), Pixels.Num() - 4), Width, Height));
+	
+	UTexture2D* Texture = FUserUtils::ImageBufferToTexture2D(Pixels, Width, Height);
+	if(!TestNotNull(TEXT("Texture"), Texture)) return false;
+	
+	TestEqual(TEXT("Width"), Texture->GetSizeX(), static_cast<int32>(Width));
+	TestEqual(TEXT("Height"), Texture->GetSizeY(), static_cast<int32>(Height));
+	TestTrue(TEXT("Pixel format"), Texture->GetPixelFormat() == PF_R8G8B8A8);
+
+	FByteBulkData& BulkData = Texture->GetPlatformData()->Mips[0].BulkData;
+	if(!TestEqual(TEXT("Mip 0 size"), BulkData.GetBulkDataSize(), static_cast<int64>(Pixels.Num()))) return false;
+	
+	const uint8* MipPixels = static_cast<const uint8*>(BulkData.LockReadOnly());
+	TestTrue(TEXT("Mip 0 pixels"), MipPixels && FMemory::Memcmp(MipPixels, Pixels.GetData(), Pixels.Num()) == 0);
+	BulkData.Unlock();
+	return true;
+}
+
+#endif
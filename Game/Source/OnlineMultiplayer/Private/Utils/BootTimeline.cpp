@@ -0,0 +1,106 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/BootTimeline.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonWriter.h"
+#include "Policies/PrettyJsonPrintPolicy.h"
+
+
+
+/**
+ * Starts an event, times are relative to the start of the process.
+ */
+void FBootTimeline::BeginEvent(const FName Name)
+{
+	FScopeLock ScopeLock(&Lock);
+	if(bFinished) return;
+	
+	FEvent& Event = Events.AddDefaulted_GetRef();
+	Event.Name = Name;
+	Event.StartTime = FPlatformTime::Seconds() - GStartTime;
+	TRACE_BOOKMARK(TEXT("Boot %s begin"), *Name.ToString());
+}
+
+void FBootTimeline::EndEvent(const FName Name, const bool bInSuccess)
+{
+	FScopeLock ScopeLock(&Lock);
+	if(bFinished) return;
+
+	// The most recent event with this name that is still open.
+	for (int32 Index = Events.Num() - 1; Index >= 0; --Index)
+	{
+		FEvent& Event = Events[Index];
+		if(Event.Name != Name || Event.EndTime != 0.0) continue;
+		
+		Event.EndTime = FPlatformTime::Seconds() - GStartTime;
+		Event.bSuccess = bInSuccess;
+		TRACE_BOOKMARK(TEXT("Boot %s end"), *Name.ToString());
+		return;
+	}
+}
+
+/**
+ * Called when the module is ready or failed to get ready. Writes the summary, events that end after this are ignored.
+ */
+void FBootTimeline::Finish(const bool bInSuccess)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		if(bFinished) return;
+		bFinished = true;
+		bSuccess = bInSuccess;
+		FinishTime = FPlatformTime::Seconds() - GStartTime;
+	}
+	TRACE_BOOKMARK(TEXT("Boot finished"));
+	UE_LOG(LogBootTimeline, Log, TEXT("Boot to online %s in %.1f ms."), bSuccess ? TEXT("succeeded") : TEXT("failed"), FinishTime * 1000.0);
+	
+	WriteSummary();
+
+	if(FParse::Param(FCommandLine::Get(), TEXT("BootTimelineExit")))
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bSuccess ? 0 : 1);
+	}
+}
+
+void FBootTimeline::WriteSummary() const
+{
+	FString Path = FPaths::ProjectLogDir() / TEXT("BootTimeline.json");
+	FParse::Value(FCommandLine::Get(), TEXT("BootTimelineFile="), Path);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>::Create(&Json);
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("success"), bSuccess);
+	Writer->WriteValue(TEXT("total_ms"), FinishTime * 1000.0);
+	Writer->WriteArrayStart(TEXT("events"));
+	for (const FEvent& Event : Events)
+	{
+		const bool bComplete = Event.EndTime != 0.0;
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("name"), Event.Name.ToString());
+		Writer->WriteValue(TEXT("start_ms"), Event.StartTime * 1000.0);
+		if(bComplete)
+		{
+			Writer->WriteValue(TEXT("end_ms"), Event.EndTime * 1000.0);
+			Writer->WriteValue(TEXT("duration_ms"), (Event.EndTime - Event.StartTime) * 1000.0);
+		}
+		Writer->WriteValue(TEXT("complete"), bComplete);
+		Writer->WriteValue(TEXT("success"), bComplete && Event.bSuccess);
+		Writer->WriteObjectEnd();
+	}
+	Writer->WriteArrayEnd();
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	if(FFileHelper::SaveStringToFile(Json, *Path))
+	{
+		UE_LOG(LogBootTimeline, Log, TEXT("Wrote boot timeline to '%s'."), *Path);
+	}
+	else
+	{
+		UE_LOG(LogBootTimeline, Warning, TEXT("Failed to write boot timeline to '%s'."), *Path);
+	}
+}
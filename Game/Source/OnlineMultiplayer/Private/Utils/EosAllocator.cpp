@@ -0,0 +1,190 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/EosAllocator.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "HAL/IConsoleManager.h"
+
+LLM_DEFINE_TAG(EOSSDK);
+
+std::atomic<int64> FEosAllocator::LiveBytes{0};
+std::atomic<int64> FEosAllocator::PeakBytes{0};
+std::atomic<int64> FEosAllocator::LiveAllocations{0};
+std::atomic<int64> FEosAllocator::TotalAllocations{0};
+std::atomic<int64> FEosAllocator::SizeBuckets[NumSizeBuckets];
+
+static FAutoConsoleCommand EosMemReportCommand(
+	TEXT("EOS.MemReport"),
+	TEXT("Prints the memory usage of the EOS-SDK."),
+	FConsoleCommandDelegate::CreateStatic(&FEosAllocator::LogStats));
+
+
+
+namespace EosAllocator
+{
+	/**
+	 * Stored right before every block handed to the SDK, so that the size and origin are known when it is released.
+	 */
+	struct FHeader
+	{
+		uint64 Size;
+		uint32 Alignment;
+		int32 PoolIndex; // INDEX_NONE when not pooled.
+	};
+	static_assert(sizeof(FHeader) == 16, "The header must fit in the minimum alignment.");
+
+	constexpr size_t MinAlignment = 16;
+	FORCEINLINE size_t GetHeaderSpace(const size_t Alignment) { return FMath::Max(Alignment, MinAlignment); }
+	FORCEINLINE FHeader* GetHeader(void* Pointer) { return static_cast<FHeader*>(Pointer) - 1; }
+
+	/**
+	 * Recycles small blocks instead of returning them to the heap.
+	 */
+	struct FSmallBlockPool
+	{
+		static constexpr int32 NumClasses = 4;
+		static constexpr size_t ClassSizes[NumClasses] = { 32, 64, 128, 256 };
+		
+		FCriticalSection Lock;
+		void* FreeLists[NumClasses] = {};
+		std::atomic<bool> bEnabled{false};
+
+		static int32 GetClass(const size_t SizeInBytes, const size_t Alignment)
+		{
+			if(Alignment > MinAlignment) return INDEX_NONE;
+			for (int32 Index = 0; Index < NumClasses; ++Index)
+			{
+				if(SizeInBytes <= ClassSizes[Index]) return Index;
+			}
+			return INDEX_NONE;
+		}
+
+		void* Pop(const int32 PoolIndex)
+		{
+			FScopeLock ScopeLock(&Lock);
+			void* Block = FreeLists[PoolIndex];
+			if(Block) FreeLists[PoolIndex] = *static_cast<void**>(Block);
+			return Block;
+		}
+
+		void Push(const int32 PoolIndex, void* Block)
+		{
+			FScopeLock ScopeLock(&Lock);
+			*static_cast<void**>(Block) = FreeLists[PoolIndex];
+			FreeLists[PoolIndex] = Block;
+		}
+	};
+
+	FSmallBlockPool& GetPool()
+	{
+		static FSmallBlockPool Pool;
+		return Pool;
+	}
+}
+
+// --------------------------------------------
+
+
+
+void* FEosAllocator::Allocate(size_t SizeInBytes, size_t Alignment)
+{
+	LLM_SCOPE_BYTAG(EOSSDK);
+	using namespace EosAllocator;
+	
+	Alignment = FMath::Max(Alignment, MinAlignment);
+	const size_t HeaderSpace = GetHeaderSpace(Alignment);
+	
+	// Small blocks have a fixed size per class, so they can be reused for any allocation of that class.
+	FSmallBlockPool& Pool = GetPool();
+	const int32 PoolIndex = Pool.bEnabled.load(std::memory_order_relaxed) ? FSmallBlockPool::GetClass(SizeInBytes, Alignment) : INDEX_NONE;
+	
+	void* RawBlock = PoolIndex != INDEX_NONE ? Pool.Pop(PoolIndex) : nullptr;
+	if(!RawBlock)
+	{
+		const size_t BlockSize = PoolIndex != INDEX_NONE ? FSmallBlockPool::ClassSizes[PoolIndex] : SizeInBytes;
+		RawBlock = FMemory::Malloc(HeaderSpace + BlockSize, Alignment);
+		if(!RawBlock) return nullptr;
+	}
+
+	void* Pointer = static_cast<uint8*>(RawBlock) + HeaderSpace;
+	*GetHeader(Pointer) = FHeader{ SizeInBytes, static_cast<uint32>(Alignment), PoolIndex };
+	TrackAllocation(SizeInBytes);
+	return Pointer;
+}
+
+void* FEosAllocator::Reallocate(void* Pointer, size_t SizeInBytes, size_t Alignment)
+{
+	if(!Pointer) return Allocate(SizeInBytes, Alignment);
+	if(!SizeInBytes)
+	{
+		Release(Pointer);
+		return nullptr;
+	}
+
+	// The header sits in front of the block, so copy into a new block instead of reallocating in place.
+	const EosAllocator::FHeader* Header = EosAllocator::GetHeader(Pointer);
+	void* NewPointer = Allocate(SizeInBytes, Alignment);
+	if(NewPointer)
+	{
+		FMemory::Memcpy(NewPointer, Pointer, FMath::Min<size_t>(Header->Size, SizeInBytes));
+		Release(Pointer);
+	}
+	return NewPointer;
+}
+
+void FEosAllocator::Release(void* Pointer)
+{
+	if(!Pointer) return;
+	LLM_SCOPE_BYTAG(EOSSDK);
+	using namespace EosAllocator;
+
+	const FHeader Header = *GetHeader(Pointer);
+	void* RawBlock = static_cast<uint8*>(Pointer) - GetHeaderSpace(Header.Alignment);
+	TrackRelease(Header.Size);
+	
+	if(Header.PoolIndex != INDEX_NONE) GetPool().Push(Header.PoolIndex, RawBlock);
+	else FMemory::Free(RawBlock);
+}
+
+/**
+ * Must be set before the SDK is initialized, blocks that are already pooled stay pooled.
+ */
+void FEosAllocator::SetSmallBlockPoolEnabled(const bool bEnabled)
+{
+	EosAllocator::GetPool().bEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+void FEosAllocator::TrackAllocation(const size_t SizeInBytes)
+{
+	const int64 NewLiveBytes = LiveBytes.fetch_add(SizeInBytes, std::memory_order_relaxed) + SizeInBytes;
+	int64 CurrentPeak = PeakBytes.load(std::memory_order_relaxed);
+	while(NewLiveBytes > CurrentPeak && !PeakBytes.compare_exchange_weak(CurrentPeak, NewLiveBytes, std::memory_order_relaxed)) {}
+	
+	LiveAllocations.fetch_add(1, std::memory_order_relaxed);
+	TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	const int32 Bucket = FMath::Min<int32>(FMath::CeilLogTwo64(FMath::Max<uint64>(SizeInBytes, 1)), NumSizeBuckets - 1);
+	SizeBuckets[Bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void FEosAllocator::TrackRelease(const size_t SizeInBytes)
+{
+	LiveBytes.fetch_sub(SizeInBytes, std::memory_order_relaxed);
+	LiveAllocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void FEosAllocator::LogStats()
+{
+	UE_LOG(LogEosAllocator, Log, TEXT("EOS-SDK memory, Live: %.1f KiB in %lld allocations, Peak: %.1f KiB, Total allocations: %lld"),
+		GetLiveBytes() / 1024.0, LiveAllocations.load(), GetPeakBytes() / 1024.0, TotalAllocations.load());
+
+	FString Buckets;
+	for (int32 Bucket = 0; Bucket < NumSizeBuckets; ++Bucket)
+	{
+		const int64 Count = SizeBuckets[Bucket].load(std::memory_order_relaxed);
+		if(!Count) continue;
+		
+		const FString Label = Bucket < NumSizeBuckets - 1 ? FString::Printf(TEXT("<=%llu"), 1ull << Bucket) : FString::Printf(TEXT(">%llu"), 1ull << (Bucket - 1));
+		Buckets += FString::Printf(TEXT("%s%s: %lld"), Buckets.IsEmpty() ? TEXT("") : TEXT(", "), *Label, Count);
+	}
+	UE_LOG(LogEosAllocator, Log, TEXT("EOS-SDK allocation sizes in bytes, [%s]"), *Buckets);
+}
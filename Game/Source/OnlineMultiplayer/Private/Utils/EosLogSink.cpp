@@ -0,0 +1,316 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/EosLogSink.h"
+#include "EOSManager.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+
+
+
+namespace EosLogSink
+{
+	constexpr float PollInterval = 0.05f;
+	constexpr double RepeatFlushInterval = 1.0;
+	constexpr double DropReportInterval = 1.0;
+	
+	struct FCategoryName
+	{
+		const TCHAR* Name;
+		EOS_ELogCategory Category;
+	};
+	
+	const FCategoryName CategoryNames[] =
+	{
+		{ TEXT("Core"), EOS_ELogCategory::EOS_LC_Core },
+		{ TEXT("Auth"), EOS_ELogCategory::EOS_LC_Auth },
+		{ TEXT("Friends"), EOS_ELogCategory::EOS_LC_Friends },
+		{ TEXT("Presence"), EOS_ELogCategory::EOS_LC_Presence },
+		{ TEXT("UserInfo"), EOS_ELogCategory::EOS_LC_UserInfo },
+		{ TEXT("HttpSerialization"), EOS_ELogCategory::EOS_LC_HttpSerialization },
+		{ TEXT("Ecom"), EOS_ELogCategory::EOS_LC_Ecom },
+		{ TEXT("P2P"), EOS_ELogCategory::EOS_LC_P2P },
+		{ TEXT("Sessions"), EOS_ELogCategory::EOS_LC_Sessions },
+		{ TEXT("RateLimiter"), EOS_ELogCategory::EOS_LC_RateLimiter },
+		{ TEXT("PlayerDataStorage"), EOS_ELogCategory::EOS_LC_PlayerDataStorage },
+		{ TEXT("Analytics"), EOS_ELogCategory::EOS_LC_Analytics },
+		{ TEXT("Messaging"), EOS_ELogCategory::EOS_LC_Messaging },
+		{ TEXT("Connect"), EOS_ELogCategory::EOS_LC_Connect },
+		{ TEXT("Overlay"), EOS_ELogCategory::EOS_LC_Overlay },
+		{ TEXT("Achievements"), EOS_ELogCategory::EOS_LC_Achievements },
+		{ TEXT("Stats"), EOS_ELogCategory::EOS_LC_Stats },
+		{ TEXT("UI"), EOS_ELogCategory::EOS_LC_UI },
+		{ TEXT("Lobby"), EOS_ELogCategory::EOS_LC_Lobby },
+		{ TEXT("Leaderboards"), EOS_ELogCategory::EOS_LC_Leaderboards },
+		{ TEXT("Keychain"), EOS_ELogCategory::EOS_LC_Keychain },
+		{ TEXT("IntegratedPlatform"), EOS_ELogCategory::EOS_LC_IntegratedPlatform },
+		{ TEXT("TitleStorage"), EOS_ELogCategory::EOS_LC_TitleStorage },
+		{ TEXT("Mods"), EOS_ELogCategory::EOS_LC_Mods },
+		{ TEXT("AntiCheat"), EOS_ELogCategory::EOS_LC_AntiCheat },
+		{ TEXT("Reports"), EOS_ELogCategory::EOS_LC_Reports },
+		{ TEXT("Sanctions"), EOS_ELogCategory::EOS_LC_Sanctions },
+		{ TEXT("ProgressionSnapshots"), EOS_ELogCategory::EOS_LC_ProgressionSnapshots },
+		{ TEXT("KWS"), EOS_ELogCategory::EOS_LC_KWS },
+		{ TEXT("RTC"), EOS_ELogCategory::EOS_LC_RTC },
+		{ TEXT("RTCAdmin"), EOS_ELogCategory::EOS_LC_RTCAdmin },
+		{ TEXT("CustomInvites"), EOS_ELogCategory::EOS_LC_CustomInvites },
+	};
+
+	bool ParseCategory(const FString& Name, EOS_ELogCategory& OutCategory)
+	{
+		for (const FCategoryName& CategoryName : CategoryNames)
+		{
+			if(Name.Equals(CategoryName.Name, ESearchCase::IgnoreCase))
+			{
+				OutCategory = CategoryName.Category;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ParseLevel(const FString& Name, EOS_ELogLevel& OutLevel)
+	{
+		if(Name.Equals(TEXT("Off"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_Off;
+		else if(Name.Equals(TEXT("Fatal"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_Fatal;
+		else if(Name.Equals(TEXT("Error"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_Error;
+		else if(Name.Equals(TEXT("Warning"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_Warning;
+		else if(Name.Equals(TEXT("Info"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_Info;
+		else if(Name.Equals(TEXT("Verbose"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_Verbose;
+		else if(Name.Equals(TEXT("VeryVerbose"), ESearchCase::IgnoreCase)) OutLevel = EOS_ELogLevel::EOS_LOG_VeryVerbose;
+		else return false;
+		return true;
+	}
+
+	ELogVerbosity::Type ToVerbosity(const EOS_ELogLevel Level)
+	{
+		switch (Level)
+		{
+		case EOS_ELogLevel::EOS_LOG_Fatal: return ELogVerbosity::Fatal;
+		case EOS_ELogLevel::EOS_LOG_Error: return ELogVerbosity::Error;
+		case EOS_ELogLevel::EOS_LOG_Warning: return ELogVerbosity::Warning;
+		case EOS_ELogLevel::EOS_LOG_Info: return ELogVerbosity::Log;
+		default: return ELogVerbosity::Verbose;
+		}
+	}
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Sets the log levels in the SDK and starts the writer thread.
+ *
+ * Must be called after the SDK has been initialized, the SDK does not accept a callback before that.
+ */
+void FEosLogSink::Initialize()
+{
+	if(Thread) return;
+
+	int32 ConfigRateLimit;
+	if (GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("EosLogRateLimit"), ConfigRateLimit, GGameIni)) RateLimit = FMath::Max(0, ConfigRateLimit);
+	Tokens = RateLimit;
+	LastRefillTime = FPlatformTime::Seconds();
+
+	// Without multithreading, messages are written directly from the callback.
+	if(FPlatformProcess::SupportsMultithreading())
+	{
+		WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+		bRunning = true;
+		Thread = FRunnableThread::Create(this, TEXT("EosLogSink"), 0, TPri_BelowNormal);
+		if(!Thread)
+		{
+			bRunning = false;
+			FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+			WakeEvent = nullptr;
+		}
+	}
+	
+	ApplyLogLevels();
+	
+	const EOS_EResult Result = EOS_Logging_SetCallback(&FEosLogSink::OnLogMessage);
+	if(Result != EOS_EResult::EOS_Success)
+	{
+		UE_LOG(LogEos, Error, TEXT("Failed to set the EOS logging callback. Result-Code: [%s]"), *FString(EOS_EResult_ToString(Result)));
+	}
+}
+
+/**
+ * Stops the writer thread and writes whatever is still queued.
+ */
+void FEosLogSink::Shutdown()
+{
+	if(!Thread) return;
+	
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+	
+	Drain();
+	FlushRepeats();
+	
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+/**
+ * Applies 'EosLogLevel' to every category, followed by the overrides in 'EosLogCategoryLevels'.
+ */
+void FEosLogSink::ApplyLogLevels() const
+{
+	EOS_ELogLevel DefaultLevel = EOS_ELogLevel::EOS_LOG_Info;
+	FString ConfigLevel;
+	if (GConfig->GetString(TEXT("OnlineMultiplayer"), TEXT("EosLogLevel"), ConfigLevel, GGameIni) && !EosLogSink::ParseLevel(ConfigLevel, DefaultLevel))
+	{
+		UE_LOG(LogEos, Warning, TEXT("Unknown EosLogLevel '%s'."), *ConfigLevel);
+	}
+	EOS_Logging_SetLogLevel(EOS_ELogCategory::EOS_LC_ALL_CATEGORIES, DefaultLevel);
+
+	TArray<FString> CategoryLevels;
+	GConfig->GetArray(TEXT("OnlineMultiplayer"), TEXT("EosLogCategoryLevels"), CategoryLevels, GGameIni);
+	for (const FString& CategoryLevel : CategoryLevels)
+	{
+		FString CategoryName, LevelName;
+		EOS_ELogCategory Category;
+		EOS_ELogLevel Level;
+		if(!CategoryLevel.Split(TEXT(":"), &CategoryName, &LevelName) ||
+			!EosLogSink::ParseCategory(CategoryName.TrimStartAndEnd(), Category) ||
+			!EosLogSink::ParseLevel(LevelName.TrimStartAndEnd(), Level))
+		{
+			UE_LOG(LogEos, Warning, TEXT("Invalid EosLogCategoryLevels entry '%s', expected 'Category:Level'."), *CategoryLevel);
+			continue;
+		}
+		EOS_Logging_SetLogLevel(Category, Level);
+	}
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Called by the SDK on any of its threads. Only copies the message into the queue.
+ */
+void EOS_CALL FEosLogSink::OnLogMessage(const EOS_LogMessage* Message)
+{
+	if(!Message || Message->Level == EOS_ELogLevel::EOS_LOG_Off) return;
+	if(LogEos.IsSuppressed(EosLogSink::ToVerbosity(Message->Level))) return;
+
+	FEosLogSink& Sink = Get();
+	if(Message->Level == EOS_ELogLevel::EOS_LOG_Fatal || !Sink.bRunning.load(std::memory_order_acquire))
+	{
+		WriteToLog(Message->Level, FString(UTF8_TO_TCHAR(Message->Category)), FString(UTF8_TO_TCHAR(Message->Message)));
+		return;
+	}
+	
+	Sink.Queue.Enqueue({ Message->Level, FString(UTF8_TO_TCHAR(Message->Category)), FString(UTF8_TO_TCHAR(Message->Message)) });
+}
+
+uint32 FEosLogSink::Run()
+{
+	while (bRunning.load(std::memory_order_acquire))
+	{
+		WakeEvent->Wait(FTimespan::FromSeconds(EosLogSink::PollInterval));
+		Drain();
+	}
+	return 0;
+}
+
+void FEosLogSink::Stop()
+{
+	bRunning.store(false, std::memory_order_release);
+	if(WakeEvent) WakeEvent->Trigger();
+}
+
+/**
+ * Writes everything in the queue, and reports repeats and dropped messages that have been pending for a while.
+ */
+void FEosLogSink::Drain()
+{
+	FEntry Entry;
+	while (Queue.Dequeue(Entry))
+	{
+		Write(Entry);
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if(RepeatCount > 0 && Now - RepeatStartTime >= EosLogSink::RepeatFlushInterval) FlushRepeats();
+	if(DroppedCount > 0 && Now - LastDropReportTime >= EosLogSink::DropReportInterval)
+	{
+		UE_LOG(LogEos, Warning, TEXT("EOS: Dropped %d log messages, exceeded %d per second."), DroppedCount, RateLimit);
+		DroppedCount = 0;
+		LastDropReportTime = Now;
+	}
+}
+
+/**
+ * Collapses the entry into the repeat count if it equals the previous one, otherwise writes it when the rate limit allows.
+ */
+void FEosLogSink::Write(const FEntry& Entry)
+{
+	if(LastEntry.IsSet() && LastEntry->Level == Entry.Level && LastEntry->Message == Entry.Message && LastEntry->Category == Entry.Category)
+	{
+		if(RepeatCount++ == 0) RepeatStartTime = FPlatformTime::Seconds();
+		return;
+	}
+	FlushRepeats();
+
+	// Errors and warnings are never dropped.
+	if(Entry.Level >= EOS_ELogLevel::EOS_LOG_Info && !ConsumeToken(FPlatformTime::Seconds()))
+	{
+		++DroppedCount;
+		LastEntry.Reset();
+		return;
+	}
+
+	WriteToLog(Entry.Level, Entry.Category, Entry.Message);
+	LastEntry = Entry;
+}
+
+void FEosLogSink::FlushRepeats()
+{
+	if(RepeatCount == 0 || !LastEntry.IsSet()) return;
+	WriteToLog(LastEntry->Level, LastEntry->Category, FString::Printf(TEXT("%s (repeated %d times)"), *LastEntry->Message, RepeatCount));
+	RepeatCount = 0;
+}
+
+/**
+ * Token bucket that refills at 'RateLimit' tokens per second, with a burst of one second worth of messages.
+ */
+bool FEosLogSink::ConsumeToken(const double Now)
+{
+	if(RateLimit <= 0) return true;
+	
+	Tokens = FMath::Min<double>(RateLimit, Tokens + (Now - LastRefillTime) * RateLimit);
+	LastRefillTime = Now;
+	if(Tokens < 1.0) return false;
+	
+	Tokens -= 1.0;
+	return true;
+}
+
+void FEosLogSink::WriteToLog(const EOS_ELogLevel Level, const FString& Category, const FString& Message)
+{
+	switch (Level)
+	{
+	case EOS_ELogLevel::EOS_LOG_Fatal:
+		UE_LOG(LogEos, Fatal, TEXT("EOS [%s]: %s"), *Category, *Message);
+		break;
+	case EOS_ELogLevel::EOS_LOG_Error:
+		UE_LOG(LogEos, Error, TEXT("EOS [%s]: %s"), *Category, *Message);
+		break;
+	case EOS_ELogLevel::EOS_LOG_Warning:
+		UE_LOG(LogEos, Warning, TEXT("EOS [%s]: %s"), *Category, *Message);
+		break;
+	case EOS_ELogLevel::EOS_LOG_Info:
+		UE_LOG(LogEos, Log, TEXT("EOS [%s]: %s"), *Category, *Message);
+		break;
+	case EOS_ELogLevel::EOS_LOG_Verbose:
+	case EOS_ELogLevel::EOS_LOG_VeryVerbose:
+		UE_LOG(LogEos, Verbose, TEXT("EOS [%s]: %s"), *Category, *Message);
+		break;
+	case EOS_ELogLevel::EOS_LOG_Off:
+	default:
+		break;
+	}
+}
@@ -0,0 +1,130 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/HostElection.h"
+
+
+
+/**
+ * Serializes the profile for a lobby member attribute, for example 'U=4096;N=1;R=<PUID>:32.5,<PUID>:80.1'
+ */
+FString FHostCandidateProfile::ToString() const
+{
+	TArray<FString> RoundTripTimeEntries;
+	for (const TPair<FString, float>& RoundTripTime : RoundTripTimes)
+	{
+		RoundTripTimeEntries.Add(FString::Printf(TEXT("%s:%.1f"), *RoundTripTime.Key, RoundTripTime.Value));
+	}
+	return FString::Printf(TEXT("U=%.0f;N=%d;R=%s"), UploadKbps, NATType, *FString::Join(RoundTripTimeEntries, TEXT(",")));
+}
+
+bool FHostCandidateProfile::FromString(const FString& InProductUserID, const FString& String, FHostCandidateProfile& OutProfile)
+{
+	OutProfile = FHostCandidateProfile();
+	OutProfile.ProductUserID = InProductUserID;
+
+	TArray<FString> Fields;
+	String.ParseIntoArray(Fields, TEXT(";"));
+	if(!Fields.Num()) return false;
+	
+	for (const FString& Field : Fields)
+	{
+		FString Key, Value;
+		if(!Field.Split(TEXT("="), &Key, &Value)) return false;
+
+		if(Key == TEXT("U")) OutProfile.UploadKbps = FCString::Atof(*Value);
+		else if(Key == TEXT("N")) OutProfile.NATType = static_cast<uint8>(FCString::Atoi(*Value));
+		else if(Key == TEXT("R"))
+		{
+			TArray<FString> Entries;
+			Value.ParseIntoArray(Entries, TEXT(","));
+			for (const FString& Entry : Entries)
+			{
+				FString PeerID, Milliseconds;
+				if(Entry.Split(TEXT(":"), &PeerID, &Milliseconds)) OutProfile.RoundTripTimes.Add(PeerID, FCString::Atof(*Milliseconds));
+			}
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------
+
+
+
+float FHostElection::Score(const FHostCandidateProfile& Candidate, const TArray<FString>& Members, const FHostElectionWeights& Weights)
+{
+	// Mean round-trip time from the other members to this candidate.
+	float TotalRoundTripTime = 0.0f;
+	int32 NumClients = 0;
+	for (const FString& Member : Members)
+	{
+		if(Member == Candidate.ProductUserID) continue;
+		const float* RoundTripTime = Candidate.RoundTripTimes.Find(Member);
+		TotalRoundTripTime += RoundTripTime ? *RoundTripTime : Weights.UnknownRttPenalty;
+		++NumClients;
+	}
+	float Score = NumClients ? TotalRoundTripTime / NumClients : 0.0f;
+
+	// Penalize hosts that cannot upload enough for all clients.
+	if(NumClients)
+	{
+		const float UploadKbps = Candidate.UploadKbps > 0.0f ? Candidate.UploadKbps : Weights.AssumedUploadKbps;
+		const float RequiredKbps = NumClients * Weights.PerClientUploadKbps;
+		const float Shortfall = FMath::Clamp(1.0f - UploadKbps / RequiredKbps, 0.0f, 1.0f);
+		Score += Shortfall * Weights.UploadShortfallPenalty;
+	}
+
+	// Strict NAT types cannot accept connections from every client.
+	if(Candidate.NATType == 2) Score += Weights.ModerateNATPenalty;
+	else if(Candidate.NATType == 3) Score += Weights.StrictNATPenalty;
+
+	if(Candidate.bIsOwner) Score -= Weights.OwnerBonus;
+	return Score;
+}
+
+FString FHostElection::Elect(const TArray<FHostCandidateProfile>& Candidates, const FHostElectionWeights& Weights)
+{
+	TArray<FString> Members;
+	for (const FHostCandidateProfile& Candidate : Candidates) Members.Add(Candidate.ProductUserID);
+
+	const FHostCandidateProfile* BestCandidate = nullptr;
+	float BestScore = TNumericLimits<float>::Max();
+	for (const FHostCandidateProfile& Candidate : Candidates)
+	{
+		// Fill in round-trip times that were only measured from the other side.
+		FHostCandidateProfile CompletedCandidate = Candidate;
+		for (const FString& Member : Members)
+		{
+			if(Member != Candidate.ProductUserID && !CompletedCandidate.RoundTripTimes.Contains(Member))
+			{
+				const float RoundTripTime = GetMeasuredRoundTripTime(Member, Candidate.ProductUserID, Candidates);
+				if(RoundTripTime >= 0.0f) CompletedCandidate.RoundTripTimes.Add(Member, RoundTripTime);
+			}
+		}
+		
+		const float Score = FHostElection::Score(CompletedCandidate, Members, Weights);
+		
+		// Ties go to the owner, then to the lowest ID so every member elects the same host.
+		const bool bIsBetter = !BestCandidate || Score < BestScore
+			|| (Score == BestScore && (Candidate.bIsOwner || (!BestCandidate->bIsOwner && Candidate.ProductUserID < BestCandidate->ProductUserID)));
+		if(bIsBetter)
+		{
+			BestCandidate = &Candidate;
+			BestScore = Score;
+		}
+	}
+	return BestCandidate ? BestCandidate->ProductUserID : FString();
+}
+
+/**
+ * Round-trip time that the given member measured to the peer, or -1 if it has not measured one.
+ */
+float FHostElection::GetMeasuredRoundTripTime(const FString& Member, const FString& Peer, const TArray<FHostCandidateProfile>& Candidates)
+{
+	for (const FHostCandidateProfile& Candidate : Candidates)
+	{
+		if(Candidate.ProductUserID != Member) continue;
+		if(const float* RoundTripTime = Candidate.RoundTripTimes.Find(Peer)) return *RoundTripTime;
+	}
+	return -1.0f;
+}
@@ -0,0 +1,200 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/JoinBarrier.h"
+
+
+
+FJoinLatencyHistogram& FJoinLatencyHistogram::Get()
+{
+	static FJoinLatencyHistogram Instance;
+	return Instance;
+}
+
+FJoinLatencyHistogram::FJoinLatencyHistogram()
+{
+	// One extra bucket for everything above the last bound.
+	BucketCounts.Init(0, GetBucketBounds().Num() + 1);
+}
+
+const TArray<double>& FJoinLatencyHistogram::GetBucketBounds()
+{
+	static const TArray<double> Bounds = { 0.5, 1.0, 2.0, 4.0, 8.0, 16.0 };
+	return Bounds;
+}
+
+void FJoinLatencyHistogram::Add(const double Latency)
+{
+	const TArray<double>& Bounds = GetBucketBounds();
+	int32 Bucket = 0;
+	while(Bucket < Bounds.Num() && Latency > Bounds[Bucket]) ++Bucket;
+	
+	++BucketCounts[Bucket];
+	++NumSamples;
+	TotalLatency += Latency;
+	MaxLatency = FMath::Max(MaxLatency, Latency);
+}
+
+void FJoinLatencyHistogram::Reset()
+{
+	for(int32& Count : BucketCounts) Count = 0;
+	NumSamples = 0;
+	TotalLatency = 0.0;
+	MaxLatency = 0.0;
+}
+
+void FJoinLatencyHistogram::LogSummary() const
+{
+	if(!NumSamples) return;
+
+	const TArray<double>& Bounds = GetBucketBounds();
+	FString Buckets;
+	for(int32 Index = 0; Index < BucketCounts.Num(); ++Index)
+	{
+		const FString Label = Bounds.IsValidIndex(Index) ? FString::Printf(TEXT("<=%.1fs"), Bounds[Index]) : FString::Printf(TEXT(">%.1fs"), Bounds.Last());
+		Buckets += FString::Printf(TEXT("%s%s: %d"), Buckets.IsEmpty() ? TEXT("") : TEXT(", "), *Label, BucketCounts[Index]);
+	}
+	
+	UE_LOG(LogJoinBarrier, Log, TEXT("Join latency over %d arrivals, Mean: %.2fs, Max: %.2fs, [%s]"), NumSamples, TotalLatency / NumSamples, MaxLatency, *Buckets);
+}
+
+// --------------------------------------------
+
+
+
+FJoinBarrier::FJoinBarrier(const TArray<FString>& ExpectedProductUserIDs, const FJoinBarrierPolicy& InPolicy)
+	: Policy(InPolicy)
+{
+	Expected.Append(ExpectedProductUserIDs);
+}
+
+FJoinBarrier::~FJoinBarrier()
+{
+	ClearTimeout();
+}
+
+void FJoinBarrier::Start()
+{
+	if(bStarted) return;
+	bStarted = true;
+	StartTime = FPlatformTime::Seconds();
+
+	UE_LOG(LogJoinBarrier, Log, TEXT("Waiting for %d of %d players to join..."), GetRequiredArrivals(), Expected.Num());
+	
+	if(Policy.Timeout > 0.0f)
+	{
+		TimeoutHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+		{
+			TimeoutHandle.Reset();
+			OnTimeout();
+			return false;
+		}), Policy.Timeout);
+	}
+
+	// Players may have arrived before the barrier started, or nobody is expected at all.
+	Evaluate();
+}
+
+void FJoinBarrier::Cancel()
+{
+	if(bReleased) return;
+	Release(EJoinBarrierResult::Cancelled);
+}
+
+void FJoinBarrier::Arrive(const FString& ProductUserID)
+{
+	if(!Expected.Contains(ProductUserID))
+	{
+		UE_LOG(LogJoinBarrier, Verbose, TEXT("Player '%s' arrived but was not expected."), *ProductUserID);
+		return;
+	}
+	if(ArrivalLatencies.Contains(ProductUserID)) return;
+	if(bReleased && !Policy.bAllowLateJoin) return;
+
+	const double Latency = bStarted ? FPlatformTime::Seconds() - StartTime : 0.0;
+	ArrivalLatencies.Add(ProductUserID, Latency);
+	FJoinLatencyHistogram::Get().Add(Latency);
+	
+	UE_LOG(LogJoinBarrier, Log, TEXT("Player '%s' arrived after %.2fs (%d/%d)."), *ProductUserID, Latency, ArrivalLatencies.Num(), Expected.Num());
+
+	if(bReleased)
+	{
+		OnLateArrivalDelegate.Broadcast(ProductUserID, Latency);
+		return;
+	}
+	
+	OnProgressDelegate.Broadcast(ArrivalLatencies.Num(), Expected.Num());
+	Evaluate();
+}
+
+/*
+ * Used when an expected player leaves the lobby while the barrier is waiting, so it does not wait for them until the timeout.
+ */
+void FJoinBarrier::RemoveExpected(const FString& ProductUserID)
+{
+	if(!Expected.Remove(ProductUserID)) return;
+	ArrivalLatencies.Remove(ProductUserID);
+
+	if(bReleased) return;
+	OnProgressDelegate.Broadcast(ArrivalLatencies.Num(), Expected.Num());
+	Evaluate();
+}
+
+double FJoinBarrier::GetArrivalLatency(const FString& ProductUserID) const
+{
+	const double* Latency = ArrivalLatencies.Find(ProductUserID);
+	return Latency ? *Latency : -1.0;
+}
+
+TArray<FString> FJoinBarrier::GetMissing() const
+{
+	TArray<FString> Missing;
+	for(const FString& ProductUserID : Expected)
+	{
+		if(!ArrivalLatencies.Contains(ProductUserID)) Missing.Add(ProductUserID);
+	}
+	return Missing;
+}
+
+int32 FJoinBarrier::GetRequiredArrivals() const
+{
+	if(Policy.Quorum <= 0) return Expected.Num();
+	return FMath::Min(Policy.Quorum, Expected.Num());
+}
+
+void FJoinBarrier::Evaluate()
+{
+	if(!bStarted || bReleased) return;
+
+	if(ArrivalLatencies.Num() >= Expected.Num()) Release(EJoinBarrierResult::AllJoined);
+	else if(ArrivalLatencies.Num() >= GetRequiredArrivals()) Release(EJoinBarrierResult::QuorumReached);
+}
+
+void FJoinBarrier::OnTimeout()
+{
+	if(bReleased) return;
+
+	const int32 MinPlayers = Policy.MinPlayersOnTimeout < 0 ? GetRequiredArrivals() : FMath::Min(Policy.MinPlayersOnTimeout, Expected.Num());
+	if(ArrivalLatencies.Num() >= MinPlayers)
+	{
+		Release(EJoinBarrierResult::QuorumReached);
+		return;
+	}
+
+	UE_LOG(LogJoinBarrier, Warning, TEXT("Timed out with %d of %d players, missing: [%s]"), ArrivalLatencies.Num(), Expected.Num(), *FString::Join(GetMissing(), TEXT(", ")));
+	Release(EJoinBarrierResult::TimedOut);
+}
+
+void FJoinBarrier::Release(const EJoinBarrierResult Result)
+{
+	bReleased = true;
+	ClearTimeout();
+	FJoinLatencyHistogram::Get().LogSummary();
+	OnCompleteDelegate.Broadcast(Result);
+}
+
+void FJoinBarrier::ClearTimeout()
+{
+	if(!TimeoutHandle.IsValid()) return;
+	FTSTicker::GetCoreTicker().RemoveTicker(TimeoutHandle);
+	TimeoutHandle.Reset();
+}
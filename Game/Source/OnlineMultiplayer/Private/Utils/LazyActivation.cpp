@@ -0,0 +1,80 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/LazyActivation.h"
+
+
+
+FLazyActivation::~FLazyActivation()
+{
+	Reset();
+}
+
+/**
+ * Binds the function that activates the owner, and runs it immediately unless the owner's class is configured as lazy.
+ */
+void FLazyActivation::Initialize(const UObject* InOwner, TFunction<void()> InActivateFunction)
+{
+	Owner = InOwner;
+	ActivateFunction = MoveTemp(InActivateFunction);
+	bActivated = false;
+
+	if(!IsLazy(InOwner->GetClass())) Activate();
+	else UE_LOG(LogLazyActivation, Verbose, TEXT("Deferring activation of '%s' until first use."), *InOwner->GetClass()->GetName());
+}
+
+/**
+ * Stops a pending prewarm and forgets the activation, should be called when the owner deinitializes.
+ */
+void FLazyActivation::Reset()
+{
+	if(PrewarmHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(PrewarmHandle);
+		PrewarmHandle.Reset();
+	}
+	ActivateFunction = nullptr;
+	bActivated = false;
+}
+
+/**
+ * Hint that the owner is going to be used soon.
+ *
+ * Activates it on the next tick instead of on first use, so the cost is not paid in the middle of the caller's frame.
+ */
+void FLazyActivation::Prewarm()
+{
+	if(bActivated || PrewarmHandle.IsValid()) return;
+
+	PrewarmHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+	{
+		PrewarmHandle.Reset();
+		if(Owner.IsValid()) Ensure();
+		return false;
+	}));
+}
+
+bool FLazyActivation::IsLazy(const UClass* Class)
+{
+	bool bLazyAll = false;
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bLazyOnlineSubsystems"), bLazyAll, GGameIni);
+	if(bLazyAll) return true;
+
+	TArray<FString> LazySubsystems;
+	GConfig->GetArray(TEXT("OnlineMultiplayer"), TEXT("LazySubsystems"), LazySubsystems, GGameIni);
+	return LazySubsystems.Contains(Class->GetName());
+}
+
+void FLazyActivation::Activate()
+{
+	if(!ActivateFunction) return;
+	
+	bActivated = true;
+	if(PrewarmHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(PrewarmHandle);
+		PrewarmHandle.Reset();
+	}
+	
+	UE_LOG(LogLazyActivation, Verbose, TEXT("Activating '%s'."), Owner.IsValid() ? *Owner->GetClass()->GetName() : TEXT("None"));
+	ActivateFunction();
+}
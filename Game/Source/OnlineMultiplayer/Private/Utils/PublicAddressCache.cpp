@@ -0,0 +1,162 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/PublicAddressCache.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+#include "SocketSubsystem.h"
+
+
+
+FPublicAddressCache& FPublicAddressCache::Get()
+{
+	static FPublicAddressCache Instance;
+	return Instance;
+}
+
+/**
+ * Loads the config, adds the default fallback resolver, and starts the first lookup.
+ */
+void FPublicAddressCache::Initialize()
+{
+	GConfig->GetString(TEXT("OnlineMultiplayer"), TEXT("PublicAddressOverride"), AddressOverride, GGameIni);
+	GConfig->GetString(TEXT("OnlineMultiplayer"), TEXT("PublicAddressURL"), LookupURL, GGameIni);
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("PublicAddressTTL"), TimeToLive, GGameIni);
+
+	// The local address only works for players on the same network, but is better than nothing.
+	AddFallbackResolver(TEXT("LocalAddress"), []() -> FString
+	{
+		ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		if(!SocketSubsystem) return FString();
+		
+		bool bCanBindAll;
+		const TSharedRef<FInternetAddr> LocalAddress = SocketSubsystem->GetLocalHostAddr(*GLog, bCanBindAll);
+		return LocalAddress->IsValid() ? LocalAddress->ToString(false) : FString();
+	});
+
+	Refresh();
+}
+
+/**
+ * Starts a lookup of the public address, unless the cached one is still fresh or a lookup is already busy.
+ */
+void FPublicAddressCache::Refresh()
+{
+	if(!AddressOverride.IsEmpty() || HasFreshAddress() || bLookupInFlight) return;
+	
+	FHttpModule* Http = &FHttpModule::Get();
+	if(!Http || !Http->IsHttpEnabled())
+	{
+		UE_LOG(LogPublicAddress, Warning, TEXT("HTTP is disabled, the public address cannot be looked up."));
+		return;
+	}
+
+	const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
+	Request->SetURL(LookupURL);
+	Request->SetVerb(TEXT("GET"));
+	Request->SetTimeout(10);
+	Request->OnProcessRequestComplete().BindRaw(this, &FPublicAddressCache::OnLookupComplete);
+
+	bLookupInFlight = Request->ProcessRequest();
+	if(!bLookupInFlight) UE_LOG(LogPublicAddress, Warning, TEXT("Failed to start the public address lookup."));
+}
+
+void FPublicAddressCache::OnLookupComplete(FHttpRequestPtr Request, FHttpResponsePtr Response, const bool bWasSuccessful)
+{
+	bLookupInFlight = false;
+
+	FString Address;
+	if(bWasSuccessful && Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		Address = Response->GetContentAsString().TrimStartAndEnd();
+	}
+	
+	if(Address.IsEmpty())
+	{
+		UE_LOG(LogPublicAddress, Warning, TEXT("Public address lookup at '%s' has failed."), *LookupURL);
+		if(Waiters.Num()) CompleteWaiters(CachedAddress.IsEmpty() ? ResolveFallbackAddress() : CachedAddress);
+		return;
+	}
+
+	CachedAddress = Address;
+	CachedTime = FPlatformTime::Seconds();
+	UE_LOG(LogPublicAddress, Log, TEXT("Public address resolved."));
+	CompleteWaiters(CachedAddress);
+}
+
+/**
+ * Calls back with the best address available.
+ *
+ * Only waits for a lookup that is already busy, and for no longer than the given time, after which a stale or fallback address is used.
+ */
+void FPublicAddressCache::ResolveAddress(const TFunction<void(const FString& Address)>& Callback, const float MaxWaitTime)
+{
+	// The override replaces the lookup, it is not used as a fallback for it.
+	if(!AddressOverride.IsEmpty())
+	{
+		Callback(AddressOverride);
+		return;
+	}
+	if(HasFreshAddress())
+	{
+		Callback(CachedAddress);
+		return;
+	}
+	
+	Refresh();
+	if(!bLookupInFlight)
+	{
+		Callback(CachedAddress.IsEmpty() ? ResolveFallbackAddress() : CachedAddress);
+		return;
+	}
+
+	Waiters.Add(Callback);
+	if(!WaitTimeoutHandle.IsValid())
+	{
+		WaitTimeoutHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+		{
+			WaitTimeoutHandle.Reset();
+			UE_LOG(LogPublicAddress, Warning, TEXT("Public address lookup is taking too long, using the cached or fallback address instead."));
+			CompleteWaiters(CachedAddress.IsEmpty() ? ResolveFallbackAddress() : CachedAddress);
+			return false;
+		}), MaxWaitTime);
+	}
+}
+
+void FPublicAddressCache::CompleteWaiters(const FString& Address)
+{
+	if(WaitTimeoutHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(WaitTimeoutHandle);
+		WaitTimeoutHandle.Reset();
+	}
+	
+	TArray<TFunction<void(const FString& Address)>> CompletedWaiters = MoveTemp(Waiters);
+	Waiters.Reset();
+	for (const auto& Waiter : CompletedWaiters) Waiter(Address);
+}
+
+/**
+ * Adds a resolver that is used when the public address cannot be looked up. Returns an empty string when it has no address.
+ */
+void FPublicAddressCache::AddFallbackResolver(const FString& Name, const TFunction<FString()>& Resolver)
+{
+	FallbackResolvers.Emplace(Name, Resolver);
+}
+
+FString FPublicAddressCache::ResolveFallbackAddress() const
+{
+	for (const TPair<FString, TFunction<FString()>>& FallbackResolver : FallbackResolvers)
+	{
+		if(FString Address = FallbackResolver.Value(); !Address.IsEmpty())
+		{
+			UE_LOG(LogPublicAddress, Log, TEXT("Using the address from fallback resolver '%s'."), *FallbackResolver.Key);
+			return Address;
+		}
+	}
+	return FString();
+}
+
+bool FPublicAddressCache::HasFreshAddress() const
+{
+	return !CachedAddress.IsEmpty() && FPlatformTime::Seconds() - CachedTime < TimeToLive;
+}
@@ -0,0 +1,169 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/StartupGraph.h"
+#include "Utils/BootTimeline.h"
+
+
+
+void FStartupGraph::AddStep(const FName Name, const TArray<FName>& Dependencies, TFunction<void(FCompleteStep)>&& Run)
+{
+	if(bStarted)
+	{
+		UE_LOG(LogStartupGraph, Error, TEXT("Cannot add step '%s' after the startup has started."), *Name.ToString());
+		return;
+	}
+
+	FStep& Step = Steps.AddDefaulted_GetRef();
+	Step.Name = Name;
+	Step.Dependencies = Dependencies;
+	Step.Run = MoveTemp(Run);
+}
+
+void FStartupGraph::Start()
+{
+	if(bStarted) return;
+	bStarted = true;
+	StartTime = FPlatformTime::Seconds();
+
+	// Steps that depend on a step that does not exist can never run.
+	for (FStep& Step : Steps)
+	{
+		for (const FName& Dependency : Step.Dependencies)
+		{
+			if(!Steps.ContainsByPredicate([&Dependency](const FStep& Other){ return Other.Name == Dependency; }))
+			{
+				UE_LOG(LogStartupGraph, Error, TEXT("Step '%s' depends on unknown step '%s'."), *Step.Name.ToString(), *Dependency.ToString());
+				Step.State = EStartupStepState::Failed;
+				bSuccess = false;
+			}
+		}
+	}
+	
+	RunReadySteps();
+}
+
+/**
+ * Calls the callback when the startup is complete, or immediately when it already is.
+ */
+void FStartupGraph::WhenComplete(TFunction<void(bool bWasSuccessful)>&& Callback)
+{
+	if(!Callback) return;
+	if(bComplete)
+	{
+		Callback(bSuccess);
+		return;
+	}
+	Waiters.Add(MoveTemp(Callback));
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Starts every pending step of which the dependencies have succeeded, and skips the ones of which a dependency did not.
+ */
+void FStartupGraph::RunReadySteps()
+{
+	bool bChanged = true;
+	while (bChanged && !bComplete)
+	{
+		bChanged = false;
+		for (int32 Index = 0; Index < Steps.Num(); ++Index)
+		{
+			if(Steps[Index].State != EStartupStepState::Pending) continue;
+
+			bool bReady = true, bBlocked = false;
+			for (const FName& Dependency : Steps[Index].Dependencies)
+			{
+				const FStep* Other = Steps.FindByPredicate([&Dependency](const FStep& Step){ return Step.Name == Dependency; });
+				if(Other->State == EStartupStepState::Failed || Other->State == EStartupStepState::Skipped) bBlocked = true;
+				else if(Other->State != EStartupStepState::Succeeded) bReady = false;
+			}
+
+			if(bBlocked)
+			{
+				Steps[Index].State = EStartupStepState::Skipped;
+				bSuccess = false;
+				bChanged = true;
+			}
+			else if(bReady)
+			{
+				Steps[Index].State = EStartupStepState::Running;
+				Steps[Index].StartTime = FPlatformTime::Seconds();
+				FBootTimeline::Get().BeginEvent(Steps[Index].Name);
+				bChanged = true;
+
+				// The step may complete before returning, so the run function is moved out of the array first.
+				TWeakPtr<FStartupGraph> WeakThis = AsShared();
+				const TFunction<void(FCompleteStep)> Run = MoveTemp(Steps[Index].Run);
+				Run([WeakThis, Index](const bool bStepSuccess)
+				{
+					if(const TSharedPtr<FStartupGraph> StrongThis = WeakThis.Pin()) StrongThis->CompleteStep(Index, bStepSuccess);
+				});
+			}
+		}
+	}
+	if(bComplete) return;
+
+	// Done when nothing is running anymore. Pending steps left at that point are part of a cycle.
+	if(Steps.ContainsByPredicate([](const FStep& Step){ return Step.State == EStartupStepState::Running; })) return;
+	for (FStep& Step : Steps)
+	{
+		if(Step.State != EStartupStepState::Pending) continue;
+		UE_LOG(LogStartupGraph, Error, TEXT("Step '%s' is part of a dependency cycle."), *Step.Name.ToString());
+		Step.State = EStartupStepState::Skipped;
+		bSuccess = false;
+	}
+	Finish();
+}
+
+void FStartupGraph::CompleteStep(const int32 Index, const bool bStepSuccess)
+{
+	FStep& Step = Steps[Index];
+	if(Step.State != EStartupStepState::Running) return;
+
+	Step.State = bStepSuccess ? EStartupStepState::Succeeded : EStartupStepState::Failed;
+	Step.EndTime = FPlatformTime::Seconds();
+	FBootTimeline::Get().EndEvent(Step.Name, bStepSuccess);
+	if(!bStepSuccess)
+	{
+		UE_LOG(LogStartupGraph, Warning, TEXT("Startup step '%s' failed."), *Step.Name.ToString());
+		bSuccess = false;
+	}
+	
+	RunReadySteps();
+}
+
+void FStartupGraph::Finish()
+{
+	bComplete = true;
+	EndTime = FPlatformTime::Seconds();
+	LogTimeline();
+
+	// Moved out first, a waiter may add another waiter.
+	TArray<TFunction<void(bool)>> CurrentWaiters = MoveTemp(Waiters);
+	for (const TFunction<void(bool)>& Waiter : CurrentWaiters) Waiter(bSuccess);
+}
+
+/**
+ * Logs when every step started and how long it took, relative to the start of the graph.
+ */
+void FStartupGraph::LogTimeline() const
+{
+	static const TCHAR* StateNames[] = { TEXT("Pending"), TEXT("Running"), TEXT("Succeeded"), TEXT("Failed"), TEXT("Skipped") };
+	
+	UE_LOG(LogStartupGraph, Log, TEXT("Startup %s in %.1f ms:"), bSuccess ? TEXT("succeeded") : TEXT("failed"), (EndTime - StartTime) * 1000.0);
+	for (const FStep& Step : Steps)
+	{
+		if(Step.StartTime == 0.0)
+		{
+			UE_LOG(LogStartupGraph, Log, TEXT("  %-24s %s"), *Step.Name.ToString(), StateNames[static_cast<uint8>(Step.State)]);
+			continue;
+		}
+		const double StepEndTime = Step.EndTime != 0.0 ? Step.EndTime : EndTime;
+		UE_LOG(LogStartupGraph, Log, TEXT("  %-24s %8.1f ms -> %8.1f ms  (%7.1f ms)  %s"), *Step.Name.ToString(),
+			(Step.StartTime - StartTime) * 1000.0, (StepEndTime - StartTime) * 1000.0, (StepEndTime - Step.StartTime) * 1000.0,
+			StateNames[static_cast<uint8>(Step.State)]);
+	}
+}
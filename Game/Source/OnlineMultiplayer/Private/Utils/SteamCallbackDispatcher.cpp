@@ -0,0 +1,339 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/SteamCallbackDispatcher.h"
+#include "HAL/IConsoleManager.h"
+
+#pragma warning(push)
+#pragma warning(disable: 4996)
+#pragma warning(disable: 4265)
+#include "isteamutils.h"
+#pragma warning(pop)
+
+DECLARE_STATS_GROUP(TEXT("Steam"), STATGROUP_Steam, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Steam Callback Dispatch"), STAT_SteamCallbackDispatch, STATGROUP_Steam);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Steam Callbacks Per Frame"), STAT_SteamCallbacksPerFrame, STATGROUP_Steam);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Steam Budget Exceeded"), STAT_SteamBudgetExceeded, STATGROUP_Steam);
+
+static FAutoConsoleCommand SteamCallbackReportCommand(
+	TEXT("Steam.CallbackReport"),
+	TEXT("Prints the number of times every Steam callback was dispatched, and how long the handlers took."),
+	FConsoleCommandDelegate::CreateLambda([]() { FSteamCallbackDispatcher::Get().LogStats(); }));
+
+
+
+/**
+ * Registered with the global Steam dispatcher for one callback-ID, forwards the callback to the handlers.
+ */
+class FSteamCallbackBridge final : public CCallbackBase
+{
+public:
+	FSteamCallbackBridge(const int32 CallbackId, const int32 InSize)
+		: Size(InSize)
+	{
+		m_iCallback = CallbackId;
+		SteamAPI_RegisterCallback(this, CallbackId);
+	}
+	
+	~FSteamCallbackBridge()
+	{
+		if(m_nCallbackFlags & k_ECallbackFlagsRegistered) SteamAPI_UnregisterCallback(this);
+	}
+
+	virtual void Run(void* Param) override { FSteamCallbackDispatcher::Get().Dispatch(m_iCallback, Param); }
+	virtual void Run(void* Param, bool, SteamAPICall_t) override { Run(Param); }
+	virtual int GetCallbackSizeBytes() override { return Size; }
+
+private:
+	int32 Size;
+};
+
+/**
+ * Registered with the global Steam dispatcher for one API-call, forwards the call-result to its handler.
+ */
+class FSteamCallResultBridge final : public CCallbackBase
+{
+public:
+	FSteamCallResultBridge(const SteamAPICall_t InApiCall, const int32 CallbackId, const int32 InSize)
+		: ApiCall(InApiCall), Size(InSize)
+	{
+		m_iCallback = CallbackId;
+		SteamAPI_RegisterCallResult(this, ApiCall);
+	}
+
+	~FSteamCallResultBridge()
+	{
+		if(ApiCall != k_uAPICallInvalid) SteamAPI_UnregisterCallResult(this, ApiCall);
+	}
+
+	virtual void Run(void* Param) override { Run(Param, false, ApiCall); }
+	virtual void Run(void* Param, const bool bIOFailure, const SteamAPICall_t InApiCall) override
+	{
+		ApiCall = k_uAPICallInvalid; // Steam unregisters the call-result itself.
+		FSteamCallbackDispatcher::Get().DispatchCallResult(InApiCall, Param, bIOFailure);
+	}
+	virtual int GetCallbackSizeBytes() override { return Size; }
+
+private:
+	SteamAPICall_t ApiCall;
+	int32 Size;
+};
+
+
+// --------------------------------------------
+
+
+FSteamCallbackDispatcher::~FSteamCallbackDispatcher()
+{
+	
+}
+
+/**
+ * Must be called after SteamAPI_Init.
+ */
+void FSteamCallbackDispatcher::Initialize()
+{
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bSteamManualDispatch"), bManualDispatch, GGameIni);
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("SteamCallbackBudgetMs"), BudgetMs, GGameIni);
+	
+	if(bManualDispatch)
+	{
+		SteamAPI_ManualDispatch_Init();
+		ManualDispatchPipe = MakeSteamPipe();
+		
+		// Handlers registered before initializing no longer need their bridge.
+		for (TPair<int32, FCallbackEntry>& Pair : Callbacks) Pair.Value.Bridge.Reset();
+		UE_LOG(LogSteamCallbackDispatcher, Log, TEXT("Using manual dispatch for Steam callbacks, budget: %.2f ms."), BudgetMs);
+	}
+	bInitialized = true;
+}
+
+void FSteamCallbackDispatcher::Shutdown()
+{
+	Callbacks.Empty();
+	PendingCalls.Empty();
+	CompletedBridges.Empty();
+	bInitialized = false;
+}
+
+/**
+ * Dispatches the callbacks that have been received since the last frame. Called every frame by FSteamManager.
+ */
+void FSteamCallbackDispatcher::RunFrame()
+{
+	CompletedBridges.Reset();
+	if(!bInitialized) return;
+	
+	if(!bManualDispatch)
+	{
+		SteamAPI_RunCallbacks();
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_SteamCallbackDispatch);
+	
+	ManualDispatchPipe.RunFrame();
+
+	const double Deadline = FPlatformTime::Seconds() + BudgetMs / 1000.0;
+	int32 NumDispatched = 0;
+	CallbackMsg_t Message;
+	while (ManualDispatchPipe.GetNextCallback(Message))
+	{
+		if(Message.m_iCallback == SteamAPICallCompleted_t::k_iCallback)
+		{
+			DispatchCallCompleted(SteamAPI_GetHSteamPipe(), *reinterpret_cast<SteamAPICallCompleted_t*>(Message.m_pubParam));
+		}
+		else
+		{
+			Dispatch(Message.m_iCallback, Message.m_pubParam);
+		}
+		ManualDispatchPipe.FreeLastCallback();
+		++NumDispatched;
+
+		// The remaining callbacks stay in the pipe until the next frame.
+		if(BudgetMs > 0.0f && FPlatformTime::Seconds() >= Deadline)
+		{
+			INC_DWORD_STAT(STAT_SteamBudgetExceeded);
+			break;
+		}
+	}
+	SET_DWORD_STAT(STAT_SteamCallbacksPerFrame, NumDispatched);
+}
+
+FSteamCallbackDispatcher::FManualDispatchPipe FSteamCallbackDispatcher::MakeSteamPipe()
+{
+	const HSteamPipe Pipe = SteamAPI_GetHSteamPipe();
+	FManualDispatchPipe SteamPipe;
+	SteamPipe.RunFrame = [Pipe]() { SteamAPI_ManualDispatch_RunFrame(Pipe); };
+	SteamPipe.GetNextCallback = [Pipe](CallbackMsg_t& OutMessage) { return SteamAPI_ManualDispatch_GetNextCallback(Pipe, &OutMessage); };
+	SteamPipe.FreeLastCallback = [Pipe]() { SteamAPI_ManualDispatch_FreeLastCallback(Pipe); };
+	return SteamPipe;
+}
+
+/**
+ * Fetches the result of a completed API-call and passes it to the handler that is waiting for it.
+ */
+void FSteamCallbackDispatcher::DispatchCallCompleted(const HSteamPipe Pipe, const SteamAPICallCompleted_t& CallCompleted)
+{
+	if(!PendingCalls.Contains(CallCompleted.m_hAsyncCall)) return;
+
+	CallResultBuffer.SetNumUninitialized(CallCompleted.m_cubParam, false);
+	bool bFailed = false;
+	const bool bSuccess = SteamAPI_ManualDispatch_GetAPICallResult(Pipe, CallCompleted.m_hAsyncCall, CallResultBuffer.GetData(),
+		CallCompleted.m_cubParam, CallCompleted.m_iCallback, &bFailed);
+	
+	DispatchCallResult(CallCompleted.m_hAsyncCall, CallResultBuffer.GetData(), !bSuccess || bFailed);
+}
+
+
+// --------------------------------------------
+
+
+void FSteamCallbackDispatcher::RegisterInternal(const void* Owner, const int32 CallbackId, const int32 Size, TFunction<void(void*)>&& Callback)
+{
+	if(DispatchDepth > 0)
+	{
+		DeferredHandlers.Add(FDeferredHandler{CallbackId, Size, FHandler{Owner, MoveTemp(Callback)}});
+		return;
+	}
+	
+	FCallbackEntry& Entry = Callbacks.FindOrAdd(CallbackId);
+	Entry.Handlers.Add(FHandler{Owner, MoveTemp(Callback)});
+	if(!bManualDispatch && !Entry.Bridge) Entry.Bridge = MakeUnique<FSteamCallbackBridge>(CallbackId, Size);
+}
+
+void FSteamCallbackDispatcher::CallInternal(const void* Owner, const SteamAPICall_t ApiCall, const int32 CallbackId, const int32 Size, TFunction<void(void*, bool)>&& Callback)
+{
+	if(ApiCall == k_uAPICallInvalid) return;
+	
+	FPendingCall& PendingCall = PendingCalls.Add(ApiCall, FPendingCall{Owner, CallbackId, MoveTemp(Callback)});
+	if(!bManualDispatch) PendingCall.Bridge = MakeUnique<FSteamCallResultBridge>(ApiCall, CallbackId, Size);
+}
+
+void FSteamCallbackDispatcher::RemoveAll(const void* Owner)
+{
+	for (TPair<int32, FCallbackEntry>& Pair : Callbacks)
+	{
+		for (FHandler& Handler : Pair.Value.Handlers)
+		{
+			if(Handler.Owner == Owner) Handler.Owner = nullptr;
+		}
+	}
+	DeferredHandlers.RemoveAll([Owner](const FDeferredHandler& Deferred){ return Deferred.Handler.Owner == Owner; });
+	
+	for (auto Iterator = PendingCalls.CreateIterator(); Iterator; ++Iterator)
+	{
+		if(Iterator.Value().Owner == Owner) Iterator.RemoveCurrent();
+	}
+
+	bNeedsCompact = true;
+	if(DispatchDepth == 0) Compact();
+}
+
+/**
+ * Removes the handlers that were cleared and applies the registrations that were made during a dispatch.
+ */
+void FSteamCallbackDispatcher::Compact()
+{
+	if(bNeedsCompact)
+	{
+		for (auto Iterator = Callbacks.CreateIterator(); Iterator; ++Iterator)
+		{
+			Iterator.Value().Handlers.RemoveAll([](const FHandler& Handler){ return Handler.Owner == nullptr; });
+			if(Iterator.Value().Handlers.IsEmpty()) Iterator.RemoveCurrent();
+		}
+		bNeedsCompact = false;
+	}
+
+	TArray<FDeferredHandler> Deferred = MoveTemp(DeferredHandlers);
+	for (FDeferredHandler& Handler : Deferred)
+	{
+		RegisterInternal(Handler.Handler.Owner, Handler.CallbackId, Handler.Size, MoveTemp(Handler.Handler.Callback));
+	}
+}
+
+
+// --------------------------------------------
+
+
+void FSteamCallbackDispatcher::Dispatch(const int32 CallbackId, void* Data)
+{
+	FCallbackEntry* Entry = Callbacks.Find(CallbackId);
+	if(!Entry) return;
+
+	// The handlers are not added or removed while dispatching, so the entry stays valid.
+	InvokeProfiled(CallbackId, [Entry, Data]()
+	{
+		for (int32 Index = 0; Index < Entry->Handlers.Num(); ++Index)
+		{
+			if(Entry->Handlers[Index].Owner) Entry->Handlers[Index].Callback(Data);
+		}
+	});
+}
+
+void FSteamCallbackDispatcher::DispatchCallResult(const SteamAPICall_t ApiCall, void* Data, const bool bIOFailure)
+{
+	FPendingCall* Found = PendingCalls.Find(ApiCall);
+	if(!Found) return;
+	FPendingCall PendingCall = MoveTemp(*Found);
+	PendingCalls.Remove(ApiCall);
+
+	// The bridge is still on the stack when called from Steam, so it is destroyed on the next frame.
+	if(PendingCall.Bridge) CompletedBridges.Add(MoveTemp(PendingCall.Bridge));
+
+	InvokeProfiled(PendingCall.CallbackId, [&PendingCall, Data, bIOFailure]()
+	{
+		PendingCall.Callback(Data, bIOFailure);
+	});
+}
+
+/**
+ * Times the handlers of a callback-ID, both as a stat and in the profile printed by 'Steam.CallbackReport'.
+ */
+void FSteamCallbackDispatcher::InvokeProfiled(const int32 CallbackId, TFunctionRef<void()> Function)
+{
+	const TStatId StatId = GetProfile(CallbackId).StatId;
+	const double StartTime = FPlatformTime::Seconds();
+	{
+#if STATS
+		FScopeCycleCounter CycleCounter(StatId);
+#endif
+		++DispatchDepth;
+		Function();
+		--DispatchDepth;
+	}
+	const double Duration = FPlatformTime::Seconds() - StartTime;
+
+	// Looked up again, a nested dispatch may have added a profile.
+	FCallbackProfile& Profile = Profiles.FindChecked(CallbackId);
+	++Profile.Count;
+	Profile.TotalSeconds += Duration;
+	Profile.MaxSeconds = FMath::Max(Profile.MaxSeconds, Duration);
+
+	if(DispatchDepth == 0 && (bNeedsCompact || DeferredHandlers.Num())) Compact();
+}
+
+FSteamCallbackDispatcher::FCallbackProfile& FSteamCallbackDispatcher::GetProfile(const int32 CallbackId)
+{
+	FCallbackProfile& Profile = Profiles.FindOrAdd(CallbackId);
+#if STATS
+	if(!Profile.StatId.IsValidStat())
+	{
+		Profile.StatId = FDynamicStats::CreateStatId<FStatGroup_STATGROUP_Steam>(FString::Printf(TEXT("Steam Callback %d"), CallbackId));
+	}
+#endif
+	return Profile;
+}
+
+void FSteamCallbackDispatcher::LogStats() const
+{
+	UE_LOG(LogSteamCallbackDispatcher, Log, TEXT("Steam callbacks (%s dispatch):"), bManualDispatch ? TEXT("manual") : TEXT("global"));
+	
+	TArray<TPair<int32, FCallbackProfile>> Sorted = Profiles.Array();
+	Sorted.Sort([](const TPair<int32, FCallbackProfile>& A, const TPair<int32, FCallbackProfile>& B){ return A.Value.TotalSeconds > B.Value.TotalSeconds; });
+	for (const TPair<int32, FCallbackProfile>& Pair : Sorted)
+	{
+		const FCallbackProfile& Profile = Pair.Value;
+		UE_LOG(LogSteamCallbackDispatcher, Log, TEXT("  %6d: %8lld calls, total %8.3f ms, average %6.3f ms, max %6.3f ms"),
+			Pair.Key, Profile.Count, Profile.TotalSeconds * 1000.0, Profile.Count ? Profile.TotalSeconds * 1000.0 / Profile.Count : 0.0, Profile.MaxSeconds * 1000.0);
+	}
+}
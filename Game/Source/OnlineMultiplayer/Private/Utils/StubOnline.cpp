@@ -0,0 +1,39 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/StubOnline.h"
+#include "Containers/Ticker.h"
+
+
+
+bool FStubOnline::IsEnabled()
+{
+	static const bool bEnabled = []()
+	{
+		bool bStubOnline = FParse::Param(FCommandLine::Get(), TEXT("StubOnline"));
+		if(!bStubOnline) GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bStubOnline"), bStubOnline, GGameIni);
+		if(bStubOnline) UE_LOG(LogStubOnline, Warning, TEXT("Online services are stubbed, Steam and EOS are not used."));
+		return bStubOnline;
+	}();
+	return bEnabled;
+}
+
+/**
+ * @return The delay in seconds.
+ */
+float FStubOnline::GetLatency()
+{
+	float LatencyMs = 0.0f;
+	GConfig->GetFloat(TEXT("OnlineMultiplayer"), TEXT("StubOnlineLatencyMs"), LatencyMs, GGameIni);
+	FParse::Value(FCommandLine::Get(), TEXT("StubOnlineLatencyMs="), LatencyMs);
+	return FMath::Max(0.0f, LatencyMs) / 1000.0f;
+}
+
+void FStubOnline::CompleteAfterLatency(TFunction<void()>&& Function)
+{
+	// Always deferred, like a real async operation, even without latency.
+	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Function = MoveTemp(Function)](float)
+	{
+		Function();
+		return false;
+	}), GetLatency());
+}
@@ -0,0 +1,387 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#include "Utils/UserProfileCache.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Engine/Texture2D.h"
+
+
+
+static constexpr uint32 ProfileCacheMagic = 0x4350554F; // "OUPC"
+static constexpr uint32 ProfileCacheVersion = 1;
+static constexpr int32 ProfileCacheHeaderSize = sizeof(uint32) * 2;
+static constexpr int32 ProfileCacheRecordHeaderSize = sizeof(uint32) * 2;
+
+
+/**
+ * Copies the details of the user, and the pixels of its avatar if they are still available on the CPU.
+ */
+FPersistedUserProfile FPersistedUserProfile::FromOnlineUser(UOnlineUser* OnlineUser)
+{
+	FPersistedUserProfile Profile;
+	Profile.ProductUserID = OnlineUser->GetProductUserID();
+	Profile.EpicAccountID = OnlineUser->GetEpicAccountID();
+	Profile.Platform = OnlineUser->GetPlatform();
+	Profile.UserID = OnlineUser->GetUserID();
+	Profile.Username = OnlineUser->GetUsername();
+	Profile.ExternalPlatformUsers = OnlineUser->GetExternalPlatformUsers();
+	Profile.SavedTime = FDateTime::UtcNow().ToUnixTimestamp();
+	for (TPair<EPlatform, FPlatformUser>& Pair : Profile.ExternalPlatformUsers) Pair.Value.Avatar = nullptr;
+
+	UTexture2D* Avatar = OnlineUser->GetAvatar();
+	FTexturePlatformData* PlatformData = Avatar ? Avatar->GetPlatformData() : nullptr;
+	if(!PlatformData || PlatformData->Mips.IsEmpty()) return Profile;
+
+	FByteBulkData& BulkData = PlatformData->Mips[0].BulkData;
+	const int32 ExpectedSize = PlatformData->SizeX * PlatformData->SizeY * 4;
+	if(BulkData.GetBulkDataSize() != ExpectedSize) return Profile; // Already uploaded and discarded.
+	
+	if(const uint8* Pixels = static_cast<const uint8*>(BulkData.LockReadOnly()))
+	{
+		Profile.AvatarWidth = PlatformData->SizeX;
+		Profile.AvatarHeight = PlatformData->SizeY;
+		Profile.AvatarPixels = TArray<uint8>(Pixels, ExpectedSize);
+	}
+	BulkData.Unlock();
+	return Profile;
+}
+
+/**
+ * Creates the user without its avatar. The avatar texture is created by the caller, within the per-frame upload budget.
+ */
+UOnlineUser* FPersistedUserProfile::ToOnlineUser() const
+{
+	UOnlineUser* OnlineUser = NewObject<UOnlineUser>();
+	OnlineUser->SetProductUserID(ProductUserID);
+	OnlineUser->SetEpicAccountID(EpicAccountID);
+	OnlineUser->SetExternalPlatformUsers(ExternalPlatformUsers);
+	if(!OnlineUser->SetPlatformUser(Platform))
+	{
+		OnlineUser->SetUserID(UserID);
+		OnlineUser->SetUsername(Username);
+	}
+	OnlineUser->SetPlatform(Platform);
+	return OnlineUser;
+}
+
+/**
+ * @return The memory used by the profile, mostly the uncompressed avatar.
+ */
+int64 FPersistedUserProfile::GetAllocatedSize() const
+{
+	int64 Size = sizeof(FPersistedUserProfile) + AvatarPixels.GetAllocatedSize() + ExternalPlatformUsers.GetAllocatedSize();
+	Size += ProductUserID.GetAllocatedSize() + EpicAccountID.GetAllocatedSize() + UserID.GetAllocatedSize() + Username.GetAllocatedSize();
+	return Size;
+}
+
+
+// --------------------------------------------
+
+
+FUserProfileCache::~FUserProfileCache()
+{
+	Unmap();
+}
+
+FUserProfileCache& FUserProfileCache::Get()
+{
+	static FUserProfileCache Instance;
+	return Instance;
+}
+
+/**
+ * Loads the config, maps the cache file, and starts validating it in the background.
+ */
+void FUserProfileCache::Initialize()
+{
+	GConfig->GetBool(TEXT("OnlineMultiplayer"), TEXT("bUserProfileCache"), bEnabled, GGameIni);
+	GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("UserProfileCacheSize"), MaxProfiles, GGameIni);
+	int32 MaxFileMB = MaxFileBytes / (1024 * 1024);
+	GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("UserProfileCacheMB"), MaxFileMB, GGameIni);
+	MaxFileBytes = static_cast<int64>(MaxFileMB) * 1024 * 1024;
+	int32 MaxMemoryMB = MaxMemoryBytes / (1024 * 1024);
+	GConfig->GetInt(TEXT("OnlineMultiplayer"), TEXT("UserProfileCacheMemoryMB"), MaxMemoryMB, GGameIni);
+	MaxMemoryBytes = static_cast<int64>(MaxMemoryMB) * 1024 * 1024;
+	if(!bEnabled || MappedFile) return;
+
+	const FString FilePath = GetFilePath();
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if(MappedFile && MappedFile->GetFileSize() > ProfileCacheHeaderSize) MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	if(!MappedRegion)
+	{
+		Unmap();
+		bReady = true;
+		return;
+	}
+
+	ValidationTask = Async(EAsyncExecution::ThreadPool, [this]() { Validate(); });
+}
+
+/**
+ * Waits for the validation, and writes the retained and new profiles.
+ */
+void FUserProfileCache::Shutdown()
+{
+	if(!bEnabled) return;
+	if(ValidationTask.IsValid()) ValidationTask.Wait();
+	Save();
+}
+
+/**
+ * Gets the profile of the given user, stored this launch or read from the cache file.
+ *
+ * Returns false while the file is still being validated.
+ */
+bool FUserProfileCache::Load(const FString& ProductUserID, FPersistedUserProfile& OutProfile)
+{
+	if(const FPersistedUserProfile* Profile = StoredProfiles.Find(ProductUserID))
+	{
+		OutProfile = *Profile;
+		return true;
+	}
+	if(!bReady) return false;
+
+	const FRecord* Record = Records.Find(ProductUserID);
+	if(!Record) return false;
+	return DeserializeProfile(GetMappedView().Slice(Record->Offset, Record->Size), OutProfile);
+}
+
+void FUserProfileCache::Store(FPersistedUserProfile&& Profile)
+{
+	if(!bEnabled || Profile.ProductUserID.IsEmpty()) return;
+	
+	// Keep the persisted avatar if the new one could not be read back.
+	if(Profile.AvatarPixels.IsEmpty())
+	{
+		FPersistedUserProfile Existing;
+		if(Load(Profile.ProductUserID, Existing))
+		{
+			Profile.AvatarWidth = Existing.AvatarWidth;
+			Profile.AvatarHeight = Existing.AvatarHeight;
+			Profile.AvatarPixels = MoveTemp(Existing.AvatarPixels);
+		}
+	}
+	if(const FPersistedUserProfile* Replaced = StoredProfiles.Find(Profile.ProductUserID)) StoredProfilesBytes -= Replaced->GetAllocatedSize();
+	StoredProfilesBytes += Profile.GetAllocatedSize();
+	StoredProfiles.Add(Profile.ProductUserID, MoveTemp(Profile));
+	TrimStoredProfiles();
+}
+
+/**
+ * Drops the oldest profiles stored this launch, until they are within the profile count and memory limits.
+ */
+void FUserProfileCache::TrimStoredProfiles()
+{
+	while(StoredProfiles.Num() && (StoredProfiles.Num() > MaxProfiles || StoredProfilesBytes > MaxMemoryBytes))
+	{
+		const FPersistedUserProfile* Oldest = nullptr;
+		for (const TPair<FString, FPersistedUserProfile>& Pair : StoredProfiles)
+		{
+			if(!Oldest || Pair.Value.SavedTime < Oldest->SavedTime) Oldest = &Pair.Value;
+		}
+		
+		StoredProfilesBytes -= Oldest->GetAllocatedSize();
+		StoredProfiles.Remove(FString(Oldest->ProductUserID));
+	}
+}
+
+
+// --------------------------------------------
+
+
+/**
+ * Runs on a background thread. Checks the header and the checksum of every record, and indexes the valid ones.
+ * Stops at the first damaged record, since the records after it cannot be located reliably.
+ */
+void FUserProfileCache::Validate()
+{
+	const TArrayView<const uint8> View = GetMappedView();
+	const uint32* Header = reinterpret_cast<const uint32*>(View.GetData());
+	if(Header[0] != ProfileCacheMagic || Header[1] != ProfileCacheVersion)
+	{
+		UE_LOG(LogUserProfileCache, Log, TEXT("Ignoring the user profile cache, it has an unknown format or version."));
+		bReady = true;
+		return;
+	}
+
+	TMap<FString, FRecord> ValidRecords;
+	int32 Offset = ProfileCacheHeaderSize;
+	while(Offset + ProfileCacheRecordHeaderSize <= View.Num())
+	{
+		uint32 Size, Crc;
+		FMemory::Memcpy(&Size, View.GetData() + Offset, sizeof(uint32));
+		FMemory::Memcpy(&Crc, View.GetData() + Offset + sizeof(uint32), sizeof(uint32));
+		const int32 PayloadOffset = Offset + ProfileCacheRecordHeaderSize;
+		if(static_cast<int64>(PayloadOffset) + Size > View.Num() || FCrc::MemCrc32(View.GetData() + PayloadOffset, Size) != Crc)
+		{
+			UE_LOG(LogUserProfileCache, Warning, TEXT("The user profile cache is damaged at offset %d, the remaining records are ignored."), Offset);
+			break;
+		}
+
+		FPersistedUserProfile Profile;
+		if(DeserializeProfile(View.Slice(PayloadOffset, Size), Profile))
+		{
+			ValidRecords.Add(Profile.ProductUserID, FRecord{PayloadOffset, Size, Profile.SavedTime});
+		}
+		Offset = PayloadOffset + Size;
+	}
+
+	UE_LOG(LogUserProfileCache, Log, TEXT("Loaded %d user profile(s) from the cache."), ValidRecords.Num());
+	Records = MoveTemp(ValidRecords);
+	bReady = true;
+}
+
+/**
+ * Writes the newest profiles to a temporary file within the limits, and replaces the cache file with it.
+ */
+void FUserProfileCache::Save()
+{
+	// Serialize the profiles stored this launch, and copy the retained records out of the mapped file.
+	TArray<TPair<int64, TArray<uint8>>> Payloads;
+	for (TPair<FString, FPersistedUserProfile>& Pair : StoredProfiles)
+	{
+		Payloads.Emplace(Pair.Value.SavedTime, SerializeProfile(Pair.Value));
+	}
+	const TArrayView<const uint8> View = GetMappedView();
+	for (const TPair<FString, FRecord>& Pair : Records)
+	{
+		if(StoredProfiles.Contains(Pair.Key)) continue;
+		Payloads.Emplace(Pair.Value.SavedTime, TArray<uint8>(View.Slice(Pair.Value.Offset, Pair.Value.Size).GetData(), Pair.Value.Size));
+	}
+	if(Payloads.IsEmpty()) return;
+
+	// The file cannot be replaced while it is mapped.
+	Records.Reset();
+	Unmap();
+
+	Payloads.Sort([](const TPair<int64, TArray<uint8>>& A, const TPair<int64, TArray<uint8>>& B) { return A.Key > B.Key; });
+	
+	TArray<uint8> Data;
+	Data.Append(reinterpret_cast<const uint8*>(&ProfileCacheMagic), sizeof(uint32));
+	Data.Append(reinterpret_cast<const uint8*>(&ProfileCacheVersion), sizeof(uint32));
+	int32 Written = 0;
+	for (const TPair<int64, TArray<uint8>>& Payload : Payloads)
+	{
+		if(Written >= MaxProfiles || Data.Num() + ProfileCacheRecordHeaderSize + Payload.Value.Num() > MaxFileBytes) break;
+		
+		const uint32 Size = Payload.Value.Num();
+		const uint32 Crc = FCrc::MemCrc32(Payload.Value.GetData(), Size);
+		Data.Append(reinterpret_cast<const uint8*>(&Size), sizeof(uint32));
+		Data.Append(reinterpret_cast<const uint8*>(&Crc), sizeof(uint32));
+		Data.Append(Payload.Value);
+		Written++;
+	}
+
+	const FString FilePath = GetFilePath();
+	const FString TempFilePath = FilePath + TEXT(".tmp");
+	if(!FFileHelper::SaveArrayToFile(Data, *TempFilePath) || !IFileManager::Get().Move(*FilePath, *TempFilePath, true))
+	{
+		UE_LOG(LogUserProfileCache, Warning, TEXT("Failed to write the user profile cache to '%s'."), *FilePath);
+		return;
+	}
+	UE_LOG(LogUserProfileCache, Log, TEXT("Saved %d user profile(s), %d bytes."), Written, Data.Num());
+}
+
+void FUserProfileCache::Unmap()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+TArrayView<const uint8> FUserProfileCache::GetMappedView() const
+{
+	if(!MappedRegion) return TArrayView<const uint8>();
+	return TArrayView<const uint8>(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+}
+
+
+// --------------------------------------------
+
+
+static void SerializeProfileFields(FArchive& Ar, FPersistedUserProfile& Profile)
+{
+	Ar << Profile.ProductUserID;
+	Ar << Profile.EpicAccountID;
+	Ar << Profile.Platform;
+	Ar << Profile.UserID;
+	Ar << Profile.Username;
+	Ar << Profile.SavedTime;
+
+	int32 ExternalCount = Profile.ExternalPlatformUsers.Num();
+	Ar << ExternalCount;
+	if(Ar.IsLoading())
+	{
+		Profile.ExternalPlatformUsers.Reset();
+		for (int32 Index = 0; Index < ExternalCount && !Ar.IsError(); ++Index)
+		{
+			FPlatformUser PlatformUser{};
+			Ar << PlatformUser.UserID << PlatformUser.Username << PlatformUser.Platform << PlatformUser.LastLoginTime;
+			Profile.ExternalPlatformUsers.Add(PlatformUser.Platform, PlatformUser);
+		}
+	}
+	else
+	{
+		for (TPair<EPlatform, FPlatformUser>& Pair : Profile.ExternalPlatformUsers)
+		{
+			Ar << Pair.Value.UserID << Pair.Value.Username << Pair.Value.Platform << Pair.Value.LastLoginTime;
+		}
+	}
+
+	Ar << Profile.AvatarWidth;
+	Ar << Profile.AvatarHeight;
+}
+
+/**
+ * Payload: the profile fields, followed by the avatar pixels compressed with zlib.
+ */
+TArray<uint8> FUserProfileCache::SerializeProfile(FPersistedUserProfile& Profile)
+{
+	TArray<uint8> Payload;
+	FMemoryWriter Writer(Payload);
+	SerializeProfileFields(Writer, Profile);
+
+	TArray<uint8> Compressed;
+	if(Profile.AvatarPixels.Num())
+	{
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Profile.AvatarPixels.Num());
+		Compressed.SetNumUninitialized(CompressedSize);
+		if(FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, Profile.AvatarPixels.GetData(), Profile.AvatarPixels.Num())) Compressed.SetNum(CompressedSize);
+		else Compressed.Reset();
+	}
+	Writer << Compressed;
+	return Payload;
+}
+
+bool FUserProfileCache::DeserializeProfile(const TArrayView<const uint8> Payload, FPersistedUserProfile& OutProfile)
+{
+	FMemoryReaderView Reader(Payload);
+	SerializeProfileFields(Reader, OutProfile);
+
+	TArray<uint8> Compressed;
+	Reader << Compressed;
+	if(Reader.IsError() || OutProfile.ProductUserID.IsEmpty()) return false;
+
+	OutProfile.AvatarPixels.Reset();
+	if(Compressed.IsEmpty()) return true;
+	
+	const int64 PixelsSize = static_cast<int64>(OutProfile.AvatarWidth) * OutProfile.AvatarHeight * 4;
+	if(PixelsSize <= 0 || PixelsSize > 16 * 1024 * 1024) return true; // Keep the profile, drop the implausible avatar.
+	
+	OutProfile.AvatarPixels.SetNumUninitialized(static_cast<int32>(PixelsSize));
+	if(!FCompression::UncompressMemory(NAME_Zlib, OutProfile.AvatarPixels.GetData(), PixelsSize, Compressed.GetData(), Compressed.Num()))
+	{
+		OutProfile.AvatarPixels.Reset();
+	}
+	return true;
+}
+
+FString FUserProfileCache::GetFilePath()
+{
+	return FPaths::ProjectSavedDir() / TEXT("OnlineMultiplayer") / TEXT("UserProfiles.bin");
+}
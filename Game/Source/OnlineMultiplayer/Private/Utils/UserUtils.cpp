@@ -4,11 +4,12 @@
 
 
 /*
- * Uses the given image-buffer to create a Texture2D that can be used by Unreal.
+ * Uses the given RGBA image-buffer to create a Texture2D that can be used by Unreal.
+ * The pixels are copied once, straight into the mip data. Must be called on the game thread.
  */
-UTexture2D* FUserUtils::ImageBufferToTexture2D(const std::vector<uint8>& Buffer, const uint32 Width, const uint32 Height)
+UTexture2D* FUserUtils::ImageBufferToTexture2D(const TConstArrayView<uint8> Buffer, const uint32 Width, const uint32 Height)
 {
-	if (Buffer.size() != Width * Height * 4)
+	if (Buffer.Num() != static_cast<int64>(Width) * Height * 4)
 	{
 		// Buffer size is not as expected. Todo handle error
 		return nullptr;
@@ -25,7 +26,7 @@ UTexture2D* FUserUtils::ImageBufferToTexture2D(const std::vector<uint8>& Buffer,
 	// Copy the pixel data to the texture
 	FTexturePlatformData* TexturePlatformData = Texture->GetPlatformData();
 	void* TextureData = TexturePlatformData->Mips[0].BulkData.Lock(LOCK_READ_WRITE);
-	FMemory::Memcpy(TextureData, Buffer.data(), Buffer.size());
+	FMemory::Memcpy(TextureData, Buffer.GetData(), Buffer.Num());
 	TexturePlatformData->Mips[0].BulkData.Unlock();
 
 	// Update the texture resource
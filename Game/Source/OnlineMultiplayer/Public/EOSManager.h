@@ -15,6 +15,17 @@ inline DEFINE_LOG_CATEGORY(LogEos);
  * Responsible for initializing the SDK.
  * 
  * Other classes can get the platform-handle from this class.
+ *
+ * The platform is ticked adaptively: every frame while EOS has work, with extra ticks when the frame has headroom,
+ * and at a lower rate when idle or when the game is in a performance-critical state.
+ * EOS has work while any async operation is in flight, so every call with a completion callback is wrapped in Begin/EndAsyncOperation.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - EosTickBudgetMs: Budget of a single EOS_Platform_Tick, zero is unlimited.
+ * - EosTargetFrameRate: Frame rate used to compute the frame headroom.
+ * - bEosPinThreads: Keep the SDK threads off the cores of the game, rendering and RHI threads. Overridden by '-EosPinThreads=' on the command-line.
+ * - EosAffinityNetworkWork, EosAffinityStorageIo, EosAffinityWebSocketIo, EosAffinityP2PIo, EosAffinityHttpRequestIo, EosAffinityRTCIo:
+ *   Affinity mask per category of SDK thread, overriding the derived default. Zero lets the SDK decide.
  */
 class ONLINEMULTIPLAYER_API FEosManager final : public FTickableGameObject
 {
@@ -30,14 +41,42 @@ public:
 	static FEosManager& Get();
 	void Initialize();
 
+	void MarkBusy(const float Duration = 1.0f);
+	void BeginAsyncOperation();
+	void EndAsyncOperation(const EOS_EResult Result);
+	FORCEINLINE int32 GetNumAsyncOperations() const { return NumAsyncOperations; }
+	void SetPerformanceCritical(const bool bInPerformanceCritical);
+	FORCEINLINE float GetLastTickDuration() const { return LastTickDurationMs; }
+	FORCEINLINE double GetLastTickTime() const { return LastTickTime; } // When packets and callbacks were last pumped.
+	FORCEINLINE bool AreThreadsPinned() const { return bThreadsPinned; }
+
 private:
 	void InitializeSdk();
+	void InitializeThreadAffinity(EOS_Initialize_ThreadAffinity& ThreadAffinity);
 	void InitializePlatform();
 	EOS_EResult CreateIntegratedPlatform(EOS_Platform_Options& PlatformOptions);
 	void FreeIntegratedPlatform(EOS_Platform_Options& PlatformOptions);
 
 	
 	EOS_HPlatform PlatformHandle;
+	bool bThreadsPinned = false;
+
+	// Tick scheduling
+	uint32 TickBudgetMs = 1;
+	float TargetFrameTimeMs = 1000.0f / 60.0f;
+	bool bPerformanceCritical = false;
+	double BusyUntil = 0.0;
+	int32 NumAsyncOperations = 0;
+	double LastTickTime = 0.0;
+	float LastTickDurationMs = 0.0f;
+	
+	static constexpr float IdleTickInterval = 0.1f;
+	static constexpr float PerformanceCriticalTickInterval = 0.25f;
+	static constexpr float IdleTickThresholdMs = 0.05f; // A tick that takes longer than this has processed callbacks.
+	static constexpr float HeadroomFraction = 0.5f; // Part of the frame headroom that EOS may use.
+	static constexpr float MinFrameBudgetMs = 0.5f;
+	static constexpr float MaxFrameBudgetMs = 4.0f;
+	static constexpr int32 MaxTicksPerFrame = 4;
 	
 public:
 	FORCEINLINE EOS_HPlatform GetPlatformHandle() const { return PlatformHandle; }
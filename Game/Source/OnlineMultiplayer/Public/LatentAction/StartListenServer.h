@@ -5,11 +5,13 @@
 #include "CoreMinimal.h"
 #include "Engine/Engine.h"
 #include "Net/OnlineBlueprintCallProxyBase.h"
+#include "Utils/JoinBarrier.h"
 #include "StartListenServer.generated.h"
 
 class ULobbySubsystem;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FProxyStartListenServerCompleteDelegate);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FProxyStartListenServerProgressDelegate, int32, Arrived, int32, Expected);
 
 
 
@@ -24,31 +26,55 @@ class UStartListenServer : public UOnlineBlueprintCallProxyBase
 	UPROPERTY(BlueprintAssignable)
 	FProxyStartListenServerCompleteDelegate OnFailure;
 
+	UPROPERTY(BlueprintAssignable)
+	FProxyStartListenServerProgressDelegate OnProgress;
+
+	/** Another lobby member has been elected to host, and will start the server instead. */
+	UPROPERTY(BlueprintAssignable)
+	FProxyStartListenServerCompleteDelegate OnHostTransferred;
+
 	/**
 	 * Will start an active listen server.
 	 * 
-	 * If there is an active lobby or session, then all members will be requested to join, and this function will wait until all of them have joined before completing.
+	 * If there is an active lobby or session, then all members will be requested to join, and this function will wait until the quorum has joined before completing.
+	 *
+	 * @param Quorum Amount of members that have to join before completing, zero waits for all of them.
+	 * @param Timeout Seconds to wait for the quorum before the server is stopped.
+	 * @param bAllowLateJoin Whether members that join after completing are still tracked.
+	 * @param bSkipHostElection Host on this machine without electing the best connected member, for example when this member has just been elected.
+	 * @param MinPlayersOnTimeout When the timeout elapses, still complete if at least this many members have joined. Negative uses 'JoinMinPlayersOnTimeout' from the [OnlineMultiplayer] config, which requires the quorum by default.
 	 */
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"), Category = "Server")
-	static UStartListenServer* StartListenServer(UObject* WorldContextObject);
+	static UStartListenServer* StartListenServer(UObject* WorldContextObject, const int32 Quorum = 0, const float Timeout = 12.0f, const bool bAllowLateJoin = true, const bool bSkipHostElection = false, const int32 MinPlayersOnTimeout = -1);
 	
 	virtual void Activate() override;
-	void OnHttpRequestCompleted(TSharedPtr<class IHttpRequest, ESPMode::ThreadSafe> Request, TSharedPtr<class IHttpResponse, ESPMode::ThreadSafe> Response, bool bWasSuccessful);
 	void ServerStarted(UWorld* NewWorld);
-	void WaitForPlayersToJoin(ULobbySubsystem* LobbySubsystem);
+	void OnServerAddressResolved(const FString& Address, ULobbySubsystem* LobbySubsystem);
+	bool WaitForPlayersToJoin(ULobbySubsystem* LobbySubsystem);
+	void OnJoinBarrierComplete(const EJoinBarrierResult Result);
+	void ClearJoinBarrier();
+	void OnWorldCleanup(UWorld* CleanedWorld, bool bSessionEnded, bool bCleanupResources);
 	void StopServer();
 	void ServerStopped(UWorld* NewWorld);
+
+	FORCEINLINE double GetListeningTime() const { return ListeningTime; }
 	
 	
 private:
 	UPROPERTY() UWorld* World;
 	
-	FString ResponseString;
+	FString ServerAddress;
+	FString MapName;
+	bool bMapPrewarmed = false;
+	bool bElectedHost = false;
+	double ActivateTime = 0.0;
+	double ListeningTime = 0.0; // Seconds from activation until the server was listening.
 	FDelegateHandle StartServerCompleteDelegateHandle;
 	FDelegateHandle StopServerCompleteDelegateHandle;
-	FDelegateHandle OnPlayerProductIDSetDelegateHandle;
+	FDelegateHandle PlayerJoinedDelegateHandle;
+	FDelegateHandle LobbyUserLeftDelegateHandle;
+	FDelegateHandle WorldCleanupDelegateHandle;
 	
-	TArray<FString> JoinedMembers;
-	FTimerHandle TimeoutTimerHandle;
-	static constexpr float TimeoutDuration = 12.0f;
+	FJoinBarrierPolicy JoinPolicy;
+	TUniquePtr<FJoinBarrier> JoinBarrier;
 };
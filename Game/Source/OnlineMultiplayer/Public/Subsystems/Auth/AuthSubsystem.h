@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <string>
 #include "CoreMinimal.h"
 #include "eos_sdk.h"
 #include "AuthSubsystem.generated.h"
@@ -9,6 +10,8 @@
 DECLARE_LOG_CATEGORY_EXTERN(LogAuthSubsystem, Log, All);
 inline DEFINE_LOG_CATEGORY(LogAuthSubsystem);
 
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnAuthLoginCompleteDelegate, const bool bSuccess);
+
 
 
 /**
@@ -16,7 +19,7 @@ inline DEFINE_LOG_CATEGORY(LogAuthSubsystem);
  *
  * Connect is used for multiplayer and matchmaking.
  *
- * Auth is used for user accounts and friends.
+ * Auth is used for user accounts and friends. Its login is persisted by the SDK between launches, and that login is tried before the Steam ticket.
  */
 UCLASS(BlueprintType)
 class ONLINEMULTIPLAYER_API UAuthSubsystem : public UGameInstanceSubsystem
@@ -29,6 +32,9 @@ protected:
 public:
 	UFUNCTION(BlueprintCallable, Category = "Account")
 	void Login();
+	void LoginWithPersistentAuth(TFunction<void(bool bSuccess)>&& Callback);
+	void LoginWithSteamSessionTicket(const std::string& TicketString);
+	bool RestoreLogin();
 	UFUNCTION(BlueprintCallable, Category = "Account")
 	void Logout();
 
@@ -47,4 +53,7 @@ private:
 	
 	UPROPERTY()
 	class ULocalUserSubsystem* LocalUserSubsystem;
+
+public:
+	FOnAuthLoginCompleteDelegate OnAuthLoginCompleteDelegate;
 };
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <string>
 #include "CoreMinimal.h"
 #include "eos_sdk.h"
 #include "Types/UserTypes.h"
@@ -20,6 +21,9 @@ DECLARE_MULTICAST_DELEGATE_TwoParams(FOnConnectLoginCompleteDelegate, const bool
  * Connect is used for multiplayer and matchmaking.
  *
  * Auth is used for user accounts and friends.
+ *
+ * The login is refreshed before it expires, using the session ticket that Steam already validated.
+ * A new ticket is only requested when a login with the cached one is rejected.
  */
 UCLASS(BlueprintType)
 class ONLINEMULTIPLAYER_API UConnectSubsystem : public UGameInstanceSubsystem
@@ -28,21 +32,33 @@ class ONLINEMULTIPLAYER_API UConnectSubsystem : public UGameInstanceSubsystem
 	
 protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
 
 public:
 	UFUNCTION(BlueprintCallable, Category = "Account")
 	void Login();
+	void LoginWithSteamSessionTicket(const std::string& TicketString);
+	bool RestoreLogin();
 	UFUNCTION(BlueprintCallable, Category = "Account")
 	void Logout();
 
 private:
 	static void EOS_CALL OnLoginComplete(const EOS_Connect_LoginCallbackInfo* Data);
+	static void EOS_CALL OnAuthExpiration(const EOS_Connect_AuthExpirationCallbackInfo* Data);
 	void OnLogoutComplete();
 
+	EOS_NotificationId AuthExpirationNotificationId = EOS_INVALID_NOTIFICATIONID;
+	bool bRetriedWithNewTicket = false;
+
 public:
 	void GetOnlineUserDetails(TArray<FString>& ProductUserIDList, const TFunction<void(TArray<UOnlineUser*>)> &Callback);
 
 private:
+	UOnlineUser* CreateOnlineUser(const EOS_ProductUserId TargetUserID) const;
+	void FetchOnlineUserAvatars(const TSharedPtr<struct FGetOnlineUserDetailsState>& State);
+
+	const int32 MaxUsersPerMappingQuery = 128; // Chosen chunk size, not an SDK limit. Keeps each query small enough to complete quickly while the others are in flight.
+
 	void CreateNewUser();
 	void CheckAccounts();
 
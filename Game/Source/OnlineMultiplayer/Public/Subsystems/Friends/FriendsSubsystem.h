@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "eos_sdk.h"
 #include "Types/UserTypes.h"
+#include "Utils/LazyActivation.h"
 #include "FriendsSubsystem.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogFriendsSubsystem, Log, All);
@@ -24,7 +25,15 @@ protected:
 	UFriendsSubsystem();
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 
+private:
+	void Activate();
+	mutable FLazyActivation Activation;
+
 public:
+	/** Hint that the friends are about to be used, activates the subsystem ahead of time when it is lazy. */
+	UFUNCTION(BlueprintCallable)
+	void Prewarm() { Activation.Prewarm(); }
+	
 	UFUNCTION(BlueprintCallable)
 	TArray<FPlatformUser> GetFriendList() const;
 
@@ -36,7 +45,7 @@ private:
 	TMap<FString, UOnlineUser*> EosFriendList;
 	
 	class FEosManager* EosManager;
-	EOS_HFriends FriendsHandle;
+	EOS_HFriends FriendsHandle = nullptr;
 
 	UPROPERTY() class USteamFriendsSubsystem* SteamFriendsSubsystem;
 	UPROPERTY() class ULocalUserSubsystem* LocalUserSubsystem;
@@ -28,6 +28,7 @@ class ONLINEMULTIPLAYER_API USteamFriendsSubsystem : public UGameInstanceSubsyst
 	
 protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
 
 public:
 	TArray<FPlatformUser> GetFriendList();
@@ -35,7 +36,7 @@ public:
 	void InviteToLobby(const FString& LobbyID, const FString& UserID);
 
 private:
-	STEAM_CALLBACK(USteamFriendsSubsystem, OnPersonaStateChange, PersonaStateChange_t);
+	void OnPersonaStateChange(PersonaStateChange_t* Data);
 	UTexture2D* CreateTextureFromAvatar(const int AvatarHandle) const;
 	
 	UPROPERTY()
@@ -0,0 +1,108 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "eos_sdk.h"
+#include "Containers/Ticker.h"
+#include "Types/LobbyTypes.h"
+#include "Utils/HostElection.h"
+#include "HostElectionSubsystem.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogHostElectionSubsystem, Log, All);
+inline DEFINE_LOG_CATEGORY(LogHostElectionSubsystem);
+
+
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnElectedAsHostDelegate, class UStartListenServer* ListenServer);
+
+
+
+/**
+ * Subsystem that picks the lobby member with the best connectivity to host the listen server.
+ *
+ * While in a lobby, members exchange small ping packets over an EOS P2P socket and publish their round-trip times,
+ * upload estimate and NAT type as the 'HostProfile' member attribute. The owner runs the election before starting the server,
+ * and transfers ownership to the winner if that is another member. The winner then starts the listen server itself.
+ *
+ * While probing, EOS is ticked every frame and the probes are polled and answered every frame. The time a ping waited
+ * between EOS pumping it and being answered is sent back with the answer and subtracted, so the frame scheduling does not end up in the samples.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - bHostElection: Whether to elect a host at all, otherwise the owner always hosts. Disabled by default.
+ * - UploadKbps: Upload capacity of this machine, skips the measurement when set.
+ * - UploadProbeURL: Endpoint of the project that accepts a POST, used to measure the upload capacity once per session.
+ *   Not set by default, the upload capacity is then unknown unless UploadKbps is set.
+ * - UploadProbeKB: Size of the measurement upload.
+ */
+UCLASS()
+class ONLINEMULTIPLAYER_API UHostElectionSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+	UHostElectionSubsystem();
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+public:
+	/** Broadcasts on the member that has been elected and promoted to owner, after it has started the listen server. Bind to the proxy to follow its progress. */
+	FOnElectedAsHostDelegate OnElectedAsHostDelegate;
+
+	FString RunElection() const;
+	void TransferHost(const FString& ProductUserID, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback);
+	
+	FORCEINLINE bool IsElectionEnabled() const { return bElectionEnabled; }
+	FHostCandidateProfile GetLocalProfile() const;
+
+private:
+	void StartProbing();
+	void StopProbing();
+	bool Tick(float DeltaTime);
+	void SendProbes();
+	void ReceiveProbes();
+	void PublishProfile();
+	void MeasureUpload();
+	static void OnConnectionRequest(const EOS_P2P_OnIncomingConnectionRequestInfo* Data);
+	
+	void OnCreateLobbyComplete(const ECreateLobbyResultCode Result, const FLobby& Lobby);
+	void OnJoinLobbyComplete(const EJoinLobbyResultCode Result, const FLobby& Lobby);
+	void OnLeaveLobbyComplete(const ELeaveLobbyResultCode Result);
+	void OnLobbyUserPromoted(const FString& ProductUserID);
+	UFUNCTION() void OnElectedListenServerComplete();
+
+	// Settings
+	bool bElectionEnabled = false;
+	float UploadKbps = 0.0f;
+	FString UploadProbeURL;
+	int32 UploadProbeKB = 512;
+	static constexpr float ProbeInterval = 2.0f;
+	static constexpr float PublishInterval = 10.0f;
+	static constexpr float RoundTripTimeSmoothing = 0.25f;
+
+	// Measurements
+	TMap<FString, float> RoundTripTimes;
+	uint8 NATType = 0;
+	FString PublishedProfile;
+	double LastProbeTime = 0.0;
+	double LastPublishTime = 0.0;
+	bool bUploadMeasured = false;
+
+	FTSTicker::FDelegateHandle TickHandle;
+	FDelegateHandle OnCreateLobbyCompleteDelegateHandle;
+	FDelegateHandle OnJoinLobbyCompleteDelegateHandle;
+	FDelegateHandle OnLeaveLobbyCompleteDelegateHandle;
+	FDelegateHandle OnLobbyUserPromotedDelegateHandle;
+
+	// EOS Variables
+	EOS_HP2P P2PHandle;
+	EOS_NotificationId ConnectionRequestNotification = EOS_INVALID_NOTIFICATIONID;
+
+	// Keeps the listen server this member started after being elected alive until it completes.
+	UPROPERTY() class UStartListenServer* ElectedListenServer;
+
+	// Subsystems
+	class FEosManager* EosManager;
+	UPROPERTY() class ULocalUserSubsystem* LocalUserSubsystem;
+	UPROPERTY() class ULobbySubsystem* LobbySubsystem;
+};
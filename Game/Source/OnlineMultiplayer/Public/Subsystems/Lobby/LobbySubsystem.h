@@ -6,6 +6,7 @@
 #include "eos_sdk.h"
 #include "Types/UserTypes.h"
 #include "Types/LobbyTypes.h"
+#include "Utils/LazyActivation.h"
 #include "LobbySubsystem.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogLobbySubsystem, Log, All);
@@ -24,6 +25,7 @@ DECLARE_MULTICAST_DELEGATE_OneParam(FOnLobbyUserKickedDelegate, const FString& P
 DECLARE_MULTICAST_DELEGATE_OneParam(FOnLobbyUserPromotedDelegate, const FString& ProductUserID);
 
 DECLARE_MULTICAST_DELEGATE_OneParam(FOnSessionIDAttributeAdded, const FString&);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMapNameAttributeChanged, const FString&);
 DECLARE_MULTICAST_DELEGATE_OneParam(FOnLobbyAttributeChanged, const FLobbyAttribute&);
 
 DECLARE_MULTICAST_DELEGATE_OneParam(FOnLobbyStartedDelegate, const FString& ServerAddress);
@@ -56,7 +58,15 @@ protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
 
+private:
+	void Activate();
+	FLazyActivation Activation;
+
 public:
+	/** Hint that a lobby is about to be used, activates the subsystem ahead of time when it is lazy. */
+	UFUNCTION(BlueprintCallable)
+	void Prewarm() { Activation.Prewarm(); }
+	
 	// Delegates
 	FOnCreateLobbyCompleteDelegate OnCreateLobbyCompleteDelegate;
 	FOnJoinLobbyCompleteDelegate OnJoinLobbyCompleteDelegate;
@@ -69,6 +79,7 @@ public:
 	FOnLobbyUserPromotedDelegate OnLobbyUserPromotedDelegate;
 	
 	FOnSessionIDAttributeAdded OnSessionIDAttributeChanged; // For joining a session
+	FOnMapNameAttributeChanged OnMapNameAttributeChanged; // For preloading the map the host is about to start
 	FOnLobbyAttributeChanged OnLobbyAttributeChanged; // Custom lobby attribute
 
 	FOnLobbyStartedDelegate OnLobbyStartedDelegate;
@@ -82,6 +93,7 @@ public:
 	void JoinLobbyByID(const FString& LobbyID);
 	void JoinLobbyByUserID(const FString& UserID);
 	void LeaveLobby();
+	void PromoteMember(const FString& ProductUserID, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback);
 
 	UFUNCTION(BlueprintCallable, meta = (Latent, WorldContext = "WorldContextObject", LatentInfo = "LatentInfos"))
 	void StartListenServer(UObject* WorldContextObject, FLatentActionInfos LatentInfos);
@@ -93,6 +105,8 @@ private:
 public:
 	FORCEINLINE void SetAttribute(const FLobbyAttribute& Attribute, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback) { SetAttributes(TArray<FLobbyAttribute>{Attribute}, OnCompleteCallback); }
 	void SetAttributes(TArray<FLobbyAttribute> Attributes, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback);
+	void SetMemberAttribute(const FLobbyAttribute& Attribute, TFunction<void(const bool bWasSuccessful)> OnCompleteCallback);
+	bool GetMemberAttribute(const FString& ProductUserID, const FString& Key, FLobbyAttribute& OutAttribute) const;
 
 private:
 	TArray<FLobbyAttribute> FilterAttributes(TArray<FLobbyAttribute>& Attributes);
@@ -108,7 +122,7 @@ private:
 	void OnLobbyUserPromoted(const FString& TargetUserID);
 	
 	// EOS Variables
-	EOS_HLobby LobbyHandle;
+	EOS_HLobby LobbyHandle = nullptr;
 	EOS_HLobbyDetails GetLobbyDetailsHandle() const;
 	EOS_HLobbySearch LobbySearchByLobbyIDHandle;
 	EOS_HLobbySearch LobbySearchByUserIDHandle;
@@ -125,7 +139,7 @@ private:
 	void LoadLobby(TFunction<void(bool bSuccess)> OnCompleteCallback);
 
 	TArray<FString> UsersToLoad; // Used to check if user's have left after loading their data.
-	TArray<FString> SpecialAttributes{"ServerAddress", "SessionID", "SteamLobbyID", "PsnLobbyID", "XboxLobbyID"};
+	TArray<FString> SpecialAttributes{"ServerAddress", "SessionID", "MapName", "ElectedHost", "SteamLobbyID", "PsnLobbyID", "XboxLobbyID"};
 
 public:
 	FORCEINLINE FLobby& GetLobby() { return Lobby; }
@@ -12,6 +12,7 @@
 
 #include "CoreMinimal.h"
 #include "PlatformLobbySubsystemBase.h"
+#include "Utils/LazyActivation.h"
 #include "SteamLobbySubsystem.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogSteamLobbySubsystem, Log, All);
@@ -31,7 +32,15 @@ protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
 
+private:
+	void Activate();
+	FLazyActivation Activation;
+
 public:
+	/** Hint that the shadow lobby is about to be used, activates the subsystem ahead of time when it is lazy. */
+	UFUNCTION(BlueprintCallable)
+	void Prewarm() { Activation.Prewarm(); }
+	
 	virtual void CreateLobby() override;
 	virtual void JoinLobby(const FString& LobbyID) override;
 	virtual void LeaveLobby() override;
@@ -39,14 +48,11 @@ public:
 
 private:
 	void OnCreateLobbyComplete(LobbyCreated_t* Data, bool bIOFailure);
-	CCallResult<USteamLobbySubsystem, LobbyCreated_t> OnCreateShadowLobbyCallResult;
-
 	void OnJoinLobbyComplete(LobbyEnter_t* Data, bool bIOFailure);
-	CCallResult<USteamLobbySubsystem, LobbyEnter_t> OnShadowLobbyEnterCallResult;
 
-	STEAM_CALLBACK(USteamLobbySubsystem, OnLobbyDataUpdateComplete, LobbyDataUpdate_t);
-	STEAM_CALLBACK(USteamLobbySubsystem, OnJoinLobbyRequest, GameLobbyJoinRequested_t);
-	STEAM_CALLBACK(USteamLobbySubsystem, OnJoinRichPresenceRequest, GameRichPresenceJoinRequested_t);
+	void OnLobbyDataUpdateComplete(LobbyDataUpdate_t* Data);
+	void OnJoinLobbyRequest(GameLobbyJoinRequested_t* Data);
+	void OnJoinRichPresenceRequest(GameRichPresenceJoinRequested_t* Data);
 
 	UPROPERTY() class ULocalUserSubsystem* LocalUserSubsystem;
 	UPROPERTY() class ULobbySubsystem* LobbySubsystem;
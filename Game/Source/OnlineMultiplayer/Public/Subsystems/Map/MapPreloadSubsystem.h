@@ -0,0 +1,80 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Types/LobbyTypes.h"
+#include "MapPreloadSubsystem.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogMapPreloadSubsystem, Log, All);
+inline DEFINE_LOG_CATEGORY(LogMapPreloadSubsystem);
+
+
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnMapPreloadCompleteDelegate, const FString& MapName, const bool bSuccess);
+
+
+
+/**
+ * Subsystem that loads the map of an upcoming server travel in the background.
+ *
+ * The host announces the map on the lobby before traveling, members then start loading it while the server is still starting.
+ * The host also pre-warms the listen-server map while the lobby is still forming, so starting the server does not have to load it cold.
+ * The loaded world is kept resident until the travel has loaded its map, so LoadMap finds it in memory instead of loading it again.
+ * A loaded world that is not part of a world-context is inactive, so holding it across the travel's garbage collection is not a leak.
+ * Nothing is preloaded when the map's world is the live world, the travel tears that world down and loads the map again.
+ * Set 'ListenServerMap' to another map than the menu for the host pre-warm to have an effect outside of PIE.
+ *
+ * The listen-server map is read from 'ListenServerMap' in the [OnlineMultiplayer] section of the game config.
+ */
+UCLASS()
+class ONLINEMULTIPLAYER_API UMapPreloadSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+public:
+	FOnMapPreloadCompleteDelegate OnMapPreloadCompleteDelegate;
+	
+	void AnnounceMap(const FString& MapName);
+	void PreloadMap(const FString& MapName);
+	void PrewarmListenServerMap();
+	void CancelPreload();
+
+	FORCEINLINE const FString& GetListenServerMap() const { return ListenServerMap; }
+	FORCEINLINE const FString& GetPreloadedMapName() const { return MapName; }
+	FORCEINLINE bool IsPreloadComplete() const { return PreloadedWorld != nullptr; }
+	FORCEINLINE double GetLastTimeSaved() const { return LastTimeSaved; }
+
+private:
+	void OnPackageLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result, const int32 RequestID);
+	void OnPreLoadMap(const FString& TravelURL);
+	void OnPostLoadMap(UWorld* LoadedWorld);
+	void OnCreateLobbyComplete(const ECreateLobbyResultCode Result, const FLobby& Lobby);
+	void OnLobbyUserPromoted(const FString& ProductUserID);
+	
+	UPROPERTY() class ULobbySubsystem* LobbySubsystem;
+	UPROPERTY() class ULocalUserSubsystem* LocalUserSubsystem;
+	FDelegateHandle OnMapNameAttributeChangedDelegateHandle;
+	FDelegateHandle OnCreateLobbyCompleteDelegateHandle;
+	FDelegateHandle OnLobbyUserPromotedDelegateHandle;
+	FDelegateHandle OnLobbyStoppedDelegateHandle;
+	FDelegateHandle PreLoadMapDelegateHandle;
+	FDelegateHandle PostLoadMapDelegateHandle;
+
+	FString ListenServerMap = "/Game/Maps/MainMenu";
+	FString MapName;
+	int32 LoadRequestID = INDEX_NONE;
+	
+	// Keeps the map with its hard references resident, released after the travel has loaded its map.
+	UPROPERTY() UWorld* PreloadedWorld;
+	FString PreloadedPackageName;
+
+	double PreloadStartTime = 0.0;
+	double PreloadCompleteTime = 0.0;
+	double TravelStartTime = 0.0;
+	double LastTimeSaved = 0.0;
+};
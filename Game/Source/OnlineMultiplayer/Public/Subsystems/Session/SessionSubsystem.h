@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "eos_sdk.h"
 #include "Types/SessionTypes.h"
+#include "Utils/ScopedEosHandle.h"
+#include "Utils/LazyActivation.h"
 #include "SessionSubsystem.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogSessionSubsystem, Log, All);
@@ -13,7 +15,14 @@ inline DEFINE_LOG_CATEGORY(LogSessionSubsystem);
 
 
 DECLARE_MULTICAST_DELEGATE_TwoParams(FOnCreateSessionCompleteDelegate, const ECreateSessionResultCode, const FSession&);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnJoinSessionCompleteDelegate, const EJoinSessionResultCode, const FSession&);
 DECLARE_MULTICAST_DELEGATE(FOnServerCreatedDelegate);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnSessionUpdatedDelegate, const FSession&);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnFindSessionsUpdateDelegate, const TArray<FSessionSearchResult>&);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnFindSessionsCompleteDelegate, const EFindSessionsResultCode, const TArray<FSessionSearchResult>&);
+
+using FScopedActiveSessionHandle = TScopedEosHandle<EOS_HActiveSession, &EOS_ActiveSession_Release>;
+using FScopedSessionDetailsHandle = TScopedEosHandle<EOS_HSessionDetails, &EOS_SessionDetails_Release>;
 
 
 
@@ -30,20 +39,36 @@ protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
 
+private:
+	void Activate();
+	FLazyActivation Activation;
+
 public:
+	/** Hint that a session is about to be used, activates the subsystem ahead of time when it is lazy. */
+	UFUNCTION(BlueprintCallable, Category = "Online|Session")
+	void Prewarm() { Activation.Prewarm(); }
+	
 	FOnCreateSessionCompleteDelegate OnCreateSessionCompleteDelegate;
+	FOnJoinSessionCompleteDelegate OnJoinSessionCompleteDelegate;
 	FOnServerCreatedDelegate OnServerCreatedDelegate;
+	FOnSessionUpdatedDelegate OnSessionUpdatedDelegate; // The cached session has been refreshed.
+	FOnFindSessionsUpdateDelegate OnFindSessionsUpdateDelegate; // Ranked results so far, broadcast each time a bucket's search completes.
+	FOnFindSessionsCompleteDelegate OnFindSessionsCompleteDelegate;
 
 private:
 	FDelegateHandle OnServerCreatedDelegateHandle;
+	FDelegateHandle OnSessionIDAttributeChangedDelegateHandle;
 
 public:
 	UFUNCTION(BlueprintCallable, Category = "Online|Session")
 	void CreateSession(const FSessionSettings& Settings);
 	void StartSession();
 	void EndSession();
+	void JoinSessionByID(const FString& SessionID);
 
 private:
+	void PublishSessionToLobby();
+	void OnLobbySessionIDChanged(const FString& SessionID);
 	void JoinSessionByHandle(const EOS_HSessionDetails& DetailsHandle);
 	static void OnJoinSessionComplete(const EOS_Sessions_JoinSessionCallbackInfo* Data);
 	
@@ -51,6 +76,55 @@ public:
 
 	void InvitePlayer(const FString& ProductUserID);
 
+	void FindSessions(const FSessionSearchSettings& Settings);
+	void CancelFindSessions();
+	void JoinSearchResult(const FString& SessionID);
+	void UpdatePingEstimate(const FString& HostAddress, const float Ping);
+
+private:
+	static void OnFindSessionsComplete(const EOS_SessionSearch_FindCallbackInfo* Data);
+	void AddSearchResults(const EOS_HSessionSearch& SearchHandle, const FString& BucketID);
+	void RankSearchResults();
+	void ProbeHostPing(const FString& HostAddress);
+	void FinishFindSessions();
+	void ResetSearchResults();
+	TArray<FSessionAttribute> GetAttributesFromDetailsHandle(const EOS_HSessionDetails& DetailsHandle) const;
+
+	uint32 ActiveSearchID = 0;
+	int32 PendingSearches = 0;
+	bool bSearching = false;
+	FSessionSearchSettings SearchSettings;
+	FTimerHandle FindSessionsTimeoutHandle;
+	UPROPERTY() TArray<FSessionSearchResult> SearchResults;
+	TMap<FString, EOS_HSessionDetails> SearchResultDetailsHandles; // Session-ID -> details handle, used to join a result.
+	TMap<FString, float> PingEstimates; // Host-Address -> smoothed ping in milliseconds.
+	TSet<FString> PingProbesInFlight;
+	const float PingProbeTimeout = 1.0f;
+
+public:
+	void RegisterPlayer(const FString& ProductUserID);
+	void UnregisterPlayer(const FString& ProductUserID);
+	void FlushPlayerRegistrations();
+
+private:
+	void SchedulePlayerRegistrationFlush();
+	void RetryPlayerRegistration(const FString& ProductUserID, const bool bRegister);
+	static void OnRegisterPlayersComplete(const EOS_Sessions_RegisterPlayersCallbackInfo* Data);
+	static void OnUnregisterPlayersComplete(const EOS_Sessions_UnregisterPlayersCallbackInfo* Data);
+
+	// Players are collected over a short window, and then (un)registered in a single call.
+	TSet<FString> PendingRegistrations;
+	TSet<FString> PendingUnregistrations;
+	TSet<FString> PlayersInFlight; // Their next (un)registration is held until this one completes, so they stay in order.
+	TMap<FString, int32> RegistrationAttempts; // Product-User-ID -> failed attempts, removed on success.
+	FTimerHandle PlayerRegistrationTimerHandle;
+	const float PlayerRegistrationWindow = 0.25f;
+	const int32 MaxPlayerRegistrationAttempts = 3;
+
+public:
+	FORCEINLINE const TArray<FSessionSearchResult>& GetSearchResults() const { return SearchResults; }
+	FORCEINLINE bool IsSearching() const { return bSearching; }
+
 private:
 	static void OnInviteReceived(const EOS_Sessions_SessionInviteReceivedCallbackInfo* Data);
 	
@@ -58,15 +132,28 @@ private:
 	bool AddAttributeToHandle(EOS_HSessionModification& Handle, const FSessionAttribute& Attribute);
 
 public:
-	FORCEINLINE void SetAttribute(const FSessionAttribute& Attribute) { SetAttributes(TArray<FSessionAttribute>{Attribute}); }
-	void SetAttributes(const TArray<FSessionAttribute>& Attributes);
+	FORCEINLINE void SetAttribute(const FSessionAttribute& Attribute, const TFunction<void(bool bWasSuccessful)>& Callback = nullptr) { SetAttributes(TArray<FSessionAttribute>{Attribute}, Callback); }
+	void SetAttributes(const TArray<FSessionAttribute>& Attributes, const TFunction<void(bool bWasSuccessful)>& Callback = nullptr);
 	void SetSpecialAttribute(const FSessionAttribute& Attribute, const TFunction<void(bool bWasSuccessful)>& Callback);
 
+private:
+	void QueueAttributes(const TArray<FSessionAttribute>& Attributes, const TFunction<void(bool bWasSuccessful)>& Callback);
+	void FlushAttributes();
+
+	TMap<FString, FSessionAttribute> PendingAttributes; // Changes not yet sent.
+	TMap<FString, FSessionAttribute> InFlightAttributes; // Changes sent, but not yet acknowledged.
+	TArray<TFunction<void(bool bWasSuccessful)>> PendingAttributeCallbacks;
+	bool bAttributeUpdateInFlight = false;
+	int32 AttributeUpdateAttempts = 0; // Failed updates in a row, reset on success.
+	const int32 MaxAttributeUpdateAttempts = 3;
+	FTimerHandle AttributeUpdateTimerHandle;
+
 private:
 	// EOS Variables
-	EOS_HSessions SessionHandle;
-	EOS_HActiveSession GetActiveSessionHandle() const;
-	EOS_HSessionDetails SessionDetailsHandle;
+	EOS_HSessions SessionHandle = nullptr;
+	FScopedActiveSessionHandle CopyActiveSessionHandle() const;
+	FScopedSessionDetailsHandle SessionDetailsHandle;
+	EOS_HSessionSearch SessionSearchByIDHandle = nullptr; // Of the search in JoinSessionByID that is in flight, released by its callback.
 	EOS_NotificationId OnSessionInviteNotification;
 
 	class FEosManager* EosManager;
@@ -75,6 +162,7 @@ private:
 
 	UPROPERTY() FSession Session;
 	void LoadSession(TFunction<void(bool bSuccess)> OnCompleteCallback);
+	bool RefreshSession();
 
 	TArray<FString> SpecialAttributes{"GameStarted"};
 
@@ -37,6 +37,7 @@ private:
 
 public:
 	FORCEINLINE ULocalUser* GetLocalUser() const { return LocalUser; }
+	void LoadLocalUserDetails(const TFunction<void(bool bWasSuccessful)>& OnComplete);
 
 
 	
@@ -44,10 +45,13 @@ public:
 	
 	void RequestSteamEncryptedAppTicket(const TFunction<void(std::string Ticket)> TicketReadyCallback);
 	void RequestSteamSessionTicket(const TFunction<void(std::string Ticket)> TicketReadyCallback);
+	void InvalidateSteamSessionTicket();
+	void AcquireSteamSessionTicket();
+	void ReleaseSteamSessionTicket();
 
 private:
 	void OnSteamEncryptedAppTicketResponse(const TArray<uint8> Ticket);
 	TFunction<void(std::string TicketString)> SteamEncryptedAppTicketCallback;
 	void OnSteamSessionTicketResponse(const TArray<uint8> Ticket);
-	TFunction<void(std::string TicketString)> SteamSessionTicketCallback;
+	TArray<TFunction<void(std::string TicketString)>> SteamSessionTicketCallbacks; // Auth and Connect can wait for the same ticket.
 };
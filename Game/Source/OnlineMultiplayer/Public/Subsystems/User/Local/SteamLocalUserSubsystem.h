@@ -32,29 +32,36 @@ class ONLINEMULTIPLAYER_API USteamLocalUserSubsystem : public UGameInstanceSubsy
 	
 protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
 	
 public:
 	// Tickets
 	void RequestEncryptedAppTicket();
 	FOnEncryptedAppTicketReady OnEncryptedAppTicketReady;
 	void RequestSessionTicket();
+	void InvalidateSessionTicket();
+	void AcquireSessionTicket();
+	void ReleaseSessionTicket();
 	FOnSessionTicketReady OnSessionTicketReady;
 	
 private:
 	// Ticket callbacks
 	void OnEncryptedAppTicketResponse( EncryptedAppTicketResponse_t *pEncryptedAppTicketResponse, bool bIOFailure );
-	CCallResult<USteamLocalUserSubsystem, EncryptedAppTicketResponse_t> m_EncryptedAppTicketResponseCallResult;
-	STEAM_CALLBACK(USteamLocalUserSubsystem, OnSessionTicketResponse, GetAuthSessionTicketResponse_t);
+	void OnSessionTicketResponse(GetAuthSessionTicketResponse_t* Data);
 
 	// Session ticket data
 	TArray<uint8> SessionTicket;
+	HAuthTicket AuthTicket = k_HAuthTicketInvalid;
 	bool bWaitingForSessionTicket = false;
 	bool bSessionTicketReady = false;
+	int32 NumSessionTicketUsers = 0; // Logins in flight that use a session ticket.
+	TArray<HAuthTicket> RetiredAuthTickets; // Invalidated, but still used by a login.
+	void CancelRetiredSessionTickets();
 	
 	SteamNetworkingIdentity Identity;
 
 public:
-	void LoadLocalUserDetails(class ULocalUser &LocalUser);
+	void LoadLocalUserDetails(class ULocalUser &LocalUser, const TFunction<void(bool bWasSuccessful)>& OnComplete);
 	
 	FORCEINLINE void SetRichPresence(const char *Key, const char *Value) { SteamFriends()->SetRichPresence(Key, Value); }
 	FORCEINLINE CSteamID GetSteamID() const { return SteamUser()->GetSteamID(); }
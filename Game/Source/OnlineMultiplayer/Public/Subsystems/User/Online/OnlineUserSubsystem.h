@@ -44,10 +44,43 @@ struct FGetOnlineUsersResult
 
 
 
+/**
+ * Bookkeeping for a cached online-user.
+ */
+struct FOnlineUserCacheEntry
+{
+	double FetchedTime = 0.0;
+	double LastAccessTime = 0.0;
+};
+
+struct FOnlineUserCacheStats
+{
+	uint64 Hits = 0;
+	uint64 Misses = 0;
+	uint64 DiskHits = 0; // Misses that were served from the persisted profiles.
+	uint64 Evictions = 0;
+	uint64 Refreshes = 0;
+};
+
+
+
 /**
  * Subsystem for managing user's from the friend, lobby or session lists.
  *
  * Provides helper functions for getting certain user data.
+ *
+ * Users that are not cached are requested through a coalescer, all IDs requested within a tick are fetched with a single GetOnlineUserDetails call.
+ * Requests for an ID that is already being fetched wait on that fetch instead of starting a new one.
+ *
+ * Fetched users are kept in a bounded cache, the least recently used users are evicted when it holds too many users or too much avatar memory.
+ * Users older than the time-to-live are still returned, but refreshed in the background.
+ * The local user, the members of the current lobby, and users pinned with PinUser are never evicted.
+ * Users that are not in memory are looked up in the persisted profiles of earlier launches (see FUserProfileCache), and refreshed straight away.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - OnlineUserCacheSize: Maximum amount of cached users.
+ * - OnlineUserCacheTextureMB: Maximum avatar memory of the cached users, in megabytes.
+ * - OnlineUserCacheTTL: Seconds before a cached user is refreshed.
  */
 UCLASS(BlueprintType)
 class ONLINEMULTIPLAYER_API UOnlineUserSubsystem : public UGameInstanceSubsystem
@@ -59,6 +92,7 @@ public:
 
 protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
 
 private:
 	class FSteamManager* SteamManager;
@@ -67,10 +101,36 @@ private:
 	UPROPERTY() class USteamOnlineUserSubsystem* SteamOnlineUserSubsystem;
 	
 	UPROPERTY() TMap<FString, UOnlineUser*> CachedOnlineUsers;
+	TMap<FString, FOnlineUserCacheEntry> CacheEntries;
+	TMap<FString, int32> PinnedUsers; // Product-User-ID -> pin count.
+	FOnlineUserCacheStats CacheStats;
+	
+	int32 MaxCachedUsers = 256;
+	int64 MaxCachedTextureBytes = 64 * 1024 * 1024;
+	float CacheTimeToLive = 600.0f;
+
+	UOnlineUser* FindCachedUser(const FString& ProductUserID);
+	UOnlineUser* AddCachedUser(UOnlineUser* OnlineUser);
+	void TrimCache();
+	bool IsPinned(const FString& ProductUserID);
+	static int64 GetTextureBytes(const UOnlineUser* OnlineUser);
+
+	void RequestOnlineUser(const FString& ProductUserID, TFunction<void(UOnlineUser*)>&& OnComplete);
+	void FlushRequests();
+	void CompleteRequests(const TArray<FString>& ProductUserIDs, const TArray<UOnlineUser*>& OnlineUserList);
+
+	TMap<FString, TArray<TFunction<void(UOnlineUser*)>>> RequestWaiters; // Product-User-ID -> callbacks waiting for it, queued or in-flight.
+	TArray<FString> QueuedRequests; // Not yet sent, flushed on the next tick.
+	bool bFlushScheduled = false;
 
 public:
 	void GetOnlineUser(const FString& ProductUserID, const TFunction<void(FGetOnlineUserResult)> &Callback);
 	void GetOnlineUsers(TArray<FString>& ProductUserIDs,const TFunction<void(FGetOnlineUsersResult)> &Callback);
 	
 	void LoadUserAvatar(const UOnlineUser* OnlineUser, const TFunction<void>& Callback);
+
+	void PinUser(const FString& ProductUserID);
+	void UnpinUser(const FString& ProductUserID);
+	void LogCacheStats();
+	FORCEINLINE const FOnlineUserCacheStats& GetCacheStats() const { return CacheStats; }
 };
@@ -3,6 +3,9 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Containers/Ticker.h"
+#include <atomic>
 #include <string>
 
 #pragma warning(push)
@@ -22,24 +25,74 @@ inline DEFINE_LOG_CATEGORY(LogSteamOnlineUserSubsystem);
 
 
 
+/**
+ * An avatar read from Steam on a worker thread, waiting for its texture to be created on the game thread.
+ */
+struct FPreparedAvatar
+{
+	uint32 Width = 0;
+	uint32 Height = 0;
+	TArray<uint8> Pixels; // RGBA, empty if the image could not be read.
+	TFunction<void(UTexture2D*)> Callback;
+};
+
+/**
+ * Reads the size and RGBA pixels of an avatar image on a worker thread. Returns false if the image could not be read.
+ */
+using FAvatarImageSource = TFunction<bool(const int ImageData, uint32& OutWidth, uint32& OutHeight, TArray<uint8>& OutPixels)>;
+
+/**
+ * The avatars waiting for their texture, shared with the worker tasks so they can finish after the subsystem is gone.
+ * Once closed, nothing is uploaded anymore and the callbacks of the queued avatars, and of those queued later, are called with nullptr.
+ */
+class FPreparedAvatarQueue : public TSharedFromThis<FPreparedAvatarQueue, ESPMode::ThreadSafe>
+{
+public:
+	void Enqueue(FPreparedAvatar&& Avatar);
+	FORCEINLINE bool Dequeue(FPreparedAvatar& OutAvatar) { return Avatars.Dequeue(OutAvatar); }
+	void Close();
+
+private:
+	void FailAll();
+	
+	TQueue<FPreparedAvatar, EQueueMode::Mpsc> Avatars;
+	std::atomic<bool> bClosed = false;
+};
+
 /**
  * Subsystem for managing Steam users.
+ *
+ * Avatar pixels are read from Steam on a worker thread. Their textures are created on the game thread,
+ * for as many avatars as fit in SteamAvatarUploadBudgetMs per frame (at least one), so a burst of avatars does not hitch a single frame.
+ * The pixels are read from the Steam utils, unless another image source is set.
  */
 UCLASS(NotBlueprintable)
 class ONLINEMULTIPLAYER_API USteamOnlineUserSubsystem : public UGameInstanceSubsystem
 {
 	GENERATED_BODY()
+	friend class FSteamAvatarPipelineTest;
 	
 protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
 
 public:
 	void FetchAvatar(const uint64 UserID, const TFunction<void(UTexture2D*)> &Callback);
+	void QueueAvatarUpload(TArray<uint8>&& Pixels, const uint32 Width, const uint32 Height, const TFunction<void(UTexture2D*)>& Callback);
+	FORCEINLINE void SetAvatarImageSource(FAvatarImageSource&& InImageSource) { ImageSource = MoveTemp(InImageSource); }
 
 private:
-	UTexture2D* ProcessAvatar(const int& ImageData);
-	STEAM_CALLBACK(USteamOnlineUserSubsystem, OnPersonaStateChange, PersonaStateChange_t);
-	STEAM_CALLBACK(USteamOnlineUserSubsystem, OnAvatarImageLoaded, AvatarImageLoaded_t);
+	static bool ReadSteamAvatarImage(const int ImageData, uint32& OutWidth, uint32& OutHeight, TArray<uint8>& OutPixels);
+	void ProcessAvatar(const int ImageData, const TFunction<void(UTexture2D*)>& Callback);
+	void ProcessWaitingAvatar(const CSteamID SteamUserID);
+	bool UploadPreparedAvatars(float DeltaTime);
+	void OnPersonaStateChange(PersonaStateChange_t* Data);
+	void OnAvatarImageLoaded(AvatarImageLoaded_t* Data);
+
+	TMap<uint64, TArray<TFunction<void(UTexture2D*)>>> FetchAvatarCallbacks; // Every request for a user waits for the same avatar.
 
-	TMap<uint64, const TFunction<void(UTexture2D*)>> FetchAvatarCallbacks;
+	TSharedRef<FPreparedAvatarQueue, ESPMode::ThreadSafe> PreparedAvatars = MakeShared<FPreparedAvatarQueue, ESPMode::ThreadSafe>();
+	FAvatarImageSource ImageSource = &ReadSteamAvatarImage; // Copied into every worker task.
+	FTSTicker::FDelegateHandle UploadTickerHandle;
+	float UploadBudgetMs = 1.0f;
 };
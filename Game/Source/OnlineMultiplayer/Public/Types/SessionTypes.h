@@ -49,6 +49,19 @@ struct FSessionAttribute
 
 	UPROPERTY(BlueprintReadWrite)
 	double DoubleValue;
+
+	bool HasSameValue(const FSessionAttribute& Other) const
+	{
+		if(Type != Other.Type) return false;
+		switch (Type)
+		{
+		case ESessionAttributeType::Bool: return BoolValue == Other.BoolValue;
+		case ESessionAttributeType::String: return StringValue == Other.StringValue;
+		case ESessionAttributeType::Int64: return IntValue == Other.IntValue;
+		case ESessionAttributeType::Double: return DoubleValue == Other.DoubleValue;
+		}
+		return false;
+	}
 };
 
 
@@ -67,6 +80,76 @@ struct FSessionSettings
 
 	UPROPERTY(BlueprintReadWrite)
 	int32 MaxMembers = 4;
+
+	UPROPERTY(BlueprintReadWrite)
+	FString BucketID = FString("Game:1.0.0");
+
+	UPROPERTY(BlueprintReadWrite)
+	bool bAllowJoinInProgress = true;
+
+	UPROPERTY(BlueprintReadWrite)
+	bool bInvitesAllowed = true;
+};
+
+
+
+/*
+ * Search
+ */
+
+USTRUCT(BlueprintType)
+struct FSessionSearchSettings
+{
+	GENERATED_BODY()
+
+	// Buckets to search in, each bucket is searched in parallel.
+	UPROPERTY(BlueprintReadWrite)
+	TArray<FString> BucketIDs{FString("Game:1.0.0")};
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 MaxResultsPerBucket = 10;
+
+	// Finishes the search as soon as this many results are found. 0 waits for all buckets.
+	UPROPERTY(BlueprintReadWrite)
+	int32 MinResults = 0;
+
+	// Finishes the search with the results found so far after this many seconds. 0 disables the timeout.
+	UPROPERTY(BlueprintReadWrite)
+	float Timeout = 0.0f;
+};
+
+/*
+ * A session found by a search.
+ */
+USTRUCT(BlueprintType)
+struct FSessionSearchResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FString ID;
+
+	UPROPERTY(BlueprintReadOnly)
+	FString BucketID;
+
+	UPROPERTY(BlueprintReadOnly)
+	FString HostAddress;
+
+	UPROPERTY(BlueprintReadOnly)
+	FString OwnerID;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 OpenSlots = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 MaxMembers = 0;
+
+	UPROPERTY()
+	TMap<FString, FSessionAttribute> Attributes;
+
+	// Cached ping estimate to the host in milliseconds, negative when unknown.
+	UPROPERTY(BlueprintReadOnly)
+	float Ping = -1.0f;
 };
 
 
@@ -76,8 +159,26 @@ struct FSessionSettings
  */
 
 
+/*
+ * Mirrors the state of the session on EOS.
+ */
+UENUM(BlueprintType)
+enum class ESessionState : uint8
+{
+	NoSession,
+	Creating,
+	Pending,
+	Starting,
+	InProgress,
+	Ending,
+	Ended,
+	Destroying,
+};
+
 /*
  * Stores all information about a session.
+ *
+ * This is a snapshot of the session, only refreshed when the session changes, so it is cheap to read every frame.
  */
 USTRUCT(BlueprintType)
 struct FSession
@@ -102,17 +203,51 @@ struct FSession
 	UPROPERTY(BlueprintReadOnly)
 	TMap<FString, UOnlineUser*> MemberList;
 
+	UPROPERTY(BlueprintReadOnly)
+	ESessionState State = ESessionState::NoSession;
+
+	// Product-User-IDs of the players registered in the session.
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FString> RegisteredPlayers;
+
 
 	
 	FORCEINLINE void AddMember(UOnlineUser* OnlineUser) { MemberList.Add(OnlineUser->GetProductUserID(), OnlineUser); }
 	FORCEINLINE void RemoveMember(const FString& ProductUserID) { MemberList.Remove(ProductUserID); }
+	FORCEINLINE bool IsPlayerRegistered(const FString& ProductUserID) const { return RegisteredPlayers.Contains(ProductUserID); }
+	FORCEINLINE bool HasAttribute(const FString& Key) const { return Attributes.Contains(Key); }
+
+	// Typed attribute accessors, return the default value when the attribute does not exist or is of another type.
+	bool GetBoolAttribute(const FString& Key, const bool bDefault = false) const
+	{
+		const FSessionAttribute* Attribute = Attributes.Find(Key);
+		return Attribute && Attribute->Type == ESessionAttributeType::Bool ? Attribute->BoolValue : bDefault;
+	}
+	FString GetStringAttribute(const FString& Key, const FString& Default = FString()) const
+	{
+		const FSessionAttribute* Attribute = Attributes.Find(Key);
+		return Attribute && Attribute->Type == ESessionAttributeType::String ? Attribute->StringValue : Default;
+	}
+	int64 GetIntAttribute(const FString& Key, const int64 Default = 0) const
+	{
+		const FSessionAttribute* Attribute = Attributes.Find(Key);
+		return Attribute && Attribute->Type == ESessionAttributeType::Int64 ? Attribute->IntValue : Default;
+	}
+	double GetDoubleAttribute(const FString& Key, const double Default = 0.0) const
+	{
+		const FSessionAttribute* Attribute = Attributes.Find(Key);
+		return Attribute && Attribute->Type == ESessionAttributeType::Double ? Attribute->DoubleValue : Default;
+	}
 
 	// Sets everything to default values
 	void Reset()
 	{
+		Name = "";
 		ID = "";
 		OwnerID = "";
+		State = ESessionState::NoSession;
 		MemberList.Empty();
+		RegisteredPlayers.Empty();
 		Attributes.Empty();
 		Settings = FSessionSettings();
 	}
@@ -133,4 +268,24 @@ enum class ECreateSessionResultCode : uint8
 	InSession UMETA(DisplayName = "Already in a session."),
 	EosFailure UMETA(DisplayName = "Some Epic Online Services SDK functionality failed."),
 	Unknown UMETA(DisplayName = "Unkown error occurred."),
+};
+
+UENUM(BlueprintType)
+enum class EJoinSessionResultCode : uint8
+{
+	Success UMETA(DisplayName = "Success."),
+	Failure UMETA(DisplayName = "Failed to join the session."),
+	NotFound UMETA(DisplayName = "No session was found."),
+	InSession UMETA(DisplayName = "Already in a session."),
+	EosFailure UMETA(DisplayName = "Some Epic Online Services SDK functionality failed."),
+	Unknown UMETA(DisplayName = "Unkown error occurred."),
+};
+
+UENUM(BlueprintType)
+enum class EFindSessionsResultCode : uint8
+{
+	Success UMETA(DisplayName = "Success."),
+	NoResults UMETA(DisplayName = "No sessions were found."),
+	Failure UMETA(DisplayName = "Failed to search for sessions."),
+	EosFailure UMETA(DisplayName = "Some Epic Online Services SDK functionality failed."),
 };
\ No newline at end of file
@@ -77,6 +77,7 @@ public:
 	UFUNCTION(BlueprintPure, Category = "User|Details") FORCEINLINE FString GetUsername() const { return PlatformUser.Username; }
 	UFUNCTION(BlueprintPure, Category = "User|Details") FORCEINLINE UTexture2D* GetAvatar() const { return PlatformUser.Avatar; }
 	UFUNCTION(BlueprintPure, Category = "User|Details") FORCEINLINE EPlatform GetPlatform() const { return Platform; }
+	FORCEINLINE const TMap<EPlatform, FPlatformUser>& GetExternalPlatformUsers() const { return ExternalPlatformUsers; }
 
 	// Setters
 	FORCEINLINE void SetProductUserID(const FString &InProductUserID) { ProductUserID = InProductUserID; }
@@ -98,6 +99,21 @@ public:
 		PlatformUser = *PlatformUserPtr;
 		return true;
 	}
+
+	/**
+	 * Refreshes this user in place with newly fetched details, so existing references see the new data.
+	 * The current avatar is kept if the other user has none.
+	 */
+	void CopyDetailsFrom(const UOnlineUser* Other)
+	{
+		UTexture2D* CurrentAvatar = PlatformUser.Avatar;
+		ProductUserID = Other->ProductUserID;
+		EpicAccountID = Other->EpicAccountID;
+		Platform = Other->Platform;
+		PlatformUser = Other->PlatformUser;
+		ExternalPlatformUsers = Other->ExternalPlatformUsers;
+		if(!PlatformUser.Avatar) PlatformUser.Avatar = CurrentAvatar;
+	}
 };
 
 
@@ -0,0 +1,69 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogBootTimeline, Log, All);
+inline DEFINE_LOG_CATEGORY(LogBootTimeline);
+
+
+
+/**
+ * Records named events from process start until the module is logged in and ready, to track the startup time.
+ *
+ * Every event is also emitted to Unreal Insights: synchronous events as CPU scopes, asynchronous ones as bookmarks.
+ * When the startup is finished, a JSON summary is written to 'Saved/Logs/BootTimeline.json', or the path given by '-BootTimelineFile='.
+ * With '-BootTimelineExit' the game exits after writing the summary, so CI can run it headless and compare the results.
+ * Add '-StubOnline' to measure the happy path without Steam or EOS, see FStubOnline.
+ */
+class ONLINEMULTIPLAYER_API FBootTimeline
+{
+	FBootTimeline() = default;
+	
+public:
+	static FBootTimeline& Get()
+	{
+		static FBootTimeline Instance;
+		return Instance;
+	}
+
+	void BeginEvent(const FName Name);
+	void EndEvent(const FName Name, const bool bInSuccess = true);
+	void Finish(const bool bInSuccess);
+
+	/**
+	 * Records an event for the lifetime of the scope.
+	 */
+	struct FScope
+	{
+		explicit FScope(const FName InName) : Name(InName) { Get().BeginEvent(Name); }
+		~FScope() { Get().EndEvent(Name, bSuccess); }
+		
+		FName Name;
+		bool bSuccess = true;
+	};
+
+private:
+	void WriteSummary() const;
+	
+	struct FEvent
+	{
+		FName Name;
+		double StartTime = 0.0;
+		double EndTime = 0.0;
+		bool bSuccess = false;
+	};
+	
+	TArray<FEvent> Events;
+	bool bFinished = false;
+	bool bSuccess = false;
+	double FinishTime = 0.0;
+	FCriticalSection Lock;
+};
+
+/** Records the rest of the current scope as a boot event, and as a CPU scope in Unreal Insights. */
+#define BOOT_TIMELINE_SCOPE(Name) \
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("Boot " Name); \
+	FBootTimeline::FScope PREPROCESSOR_JOIN(BootTimelineScope, __LINE__)(TEXT(Name))
@@ -0,0 +1,45 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "eos_base.h"
+#include <atomic>
+
+DECLARE_LOG_CATEGORY_EXTERN(LogEosAllocator, Log, All);
+inline DEFINE_LOG_CATEGORY(LogEosAllocator);
+
+
+
+/**
+ * Memory hooks for the EOS-SDK, so its allocations go through FMemory and are tracked.
+ *
+ * Allocations are tagged for LLM, counted and bucketed by size. Small blocks can optionally be recycled from a pool,
+ * which keeps the churn of the SDK away from the general heap on long-running servers.
+ * The statistics can be printed with 'EOS.MemReport', which is also part of 'memreport'.
+ */
+class ONLINEMULTIPLAYER_API FEosAllocator
+{
+public:
+	static void* EOS_MEMORY_CALL Allocate(size_t SizeInBytes, size_t Alignment);
+	static void* EOS_MEMORY_CALL Reallocate(void* Pointer, size_t SizeInBytes, size_t Alignment);
+	static void EOS_MEMORY_CALL Release(void* Pointer);
+
+	static void SetSmallBlockPoolEnabled(const bool bEnabled);
+	static void LogStats();
+
+	FORCEINLINE static int64 GetLiveBytes() { return LiveBytes.load(std::memory_order_relaxed); }
+	FORCEINLINE static int64 GetPeakBytes() { return PeakBytes.load(std::memory_order_relaxed); }
+
+	static constexpr int32 NumSizeBuckets = 21; // Powers of two up to 512 KiB, the last bucket holds everything larger.
+
+private:
+	static void TrackAllocation(const size_t SizeInBytes);
+	static void TrackRelease(const size_t SizeInBytes);
+	
+	static std::atomic<int64> LiveBytes;
+	static std::atomic<int64> PeakBytes;
+	static std::atomic<int64> LiveAllocations;
+	static std::atomic<int64> TotalAllocations;
+	static std::atomic<int64> SizeBuckets[NumSizeBuckets];
+};
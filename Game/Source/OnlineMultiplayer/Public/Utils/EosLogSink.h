@@ -0,0 +1,79 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "eos_logging.h"
+#include <atomic>
+
+class FRunnableThread;
+class FEvent;
+
+
+
+/**
+ * Receives the log messages of the EOS-SDK and writes them to 'LogEos' on a background thread.
+ *
+ * The SDK calls back on its own threads, so the callback only copies the message into a lock-free queue.
+ * Categories below their configured level are filtered by the SDK itself and never reach the callback.
+ * Consecutive duplicates are collapsed into a repeat count, and informational messages are rate limited.
+ * Fatal messages bypass the queue so they are never lost.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - EosLogLevel: Level for every category, one of Off, Fatal, Error, Warning, Info, Verbose or VeryVerbose.
+ * - +EosLogCategoryLevels: Overrides per category in the form 'Category:Level', e.g. 'P2P:Verbose'.
+ * - EosLogRateLimit: Maximum number of informational messages per second, zero is unlimited.
+ */
+class ONLINEMULTIPLAYER_API FEosLogSink final : public FRunnable
+{
+	FEosLogSink() = default;
+	
+public:
+	static FEosLogSink& Get()
+	{
+		static FEosLogSink Instance;
+		return Instance;
+	}
+	
+	void Initialize();
+	void Shutdown();
+
+private:
+	static void EOS_CALL OnLogMessage(const EOS_LogMessage* Message);
+	
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	struct FEntry
+	{
+		EOS_ELogLevel Level;
+		FString Category;
+		FString Message;
+	};
+	
+	void ApplyLogLevels() const;
+	void Drain();
+	void Write(const FEntry& Entry);
+	void FlushRepeats();
+	bool ConsumeToken(const double Now);
+	static void WriteToLog(const EOS_ELogLevel Level, const FString& Category, const FString& Message);
+
+	
+	TQueue<FEntry, EQueueMode::Mpsc> Queue;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bRunning{false};
+
+	// Only accessed by the writer thread.
+	TOptional<FEntry> LastEntry;
+	int32 RepeatCount = 0;
+	double RepeatStartTime = 0.0;
+
+	int32 RateLimit = 100;
+	double Tokens = 0.0;
+	double LastRefillTime = 0.0;
+	int32 DroppedCount = 0;
+	double LastDropReportTime = 0.0;
+};
@@ -0,0 +1,54 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+
+/**
+ * Network profile of a lobby member that could host the listen server.
+ */
+struct ONLINEMULTIPLAYER_API FHostCandidateProfile
+{
+	FString ProductUserID;
+	TMap<FString, float> RoundTripTimes; // Milliseconds, keyed by the Product-User-ID of the other member.
+	float UploadKbps = 0.0f; // Zero when unknown.
+	uint8 NATType = 0; // EOS_ENATType, zero when unknown.
+	bool bIsOwner = false;
+
+	FString ToString() const;
+	static bool FromString(const FString& ProductUserID, const FString& String, FHostCandidateProfile& OutProfile);
+};
+
+/**
+ * Tunables for scoring host candidates. All penalties are in milliseconds, so they weigh against round-trip times.
+ */
+struct FHostElectionWeights
+{
+	float UnknownRttPenalty = 250.0f; // Used for members that have no round-trip time to the candidate.
+	float PerClientUploadKbps = 256.0f; // Upload needed per connected client.
+	float AssumedUploadKbps = 2048.0f; // Used when the candidate has not reported its upload.
+	float UploadShortfallPenalty = 200.0f; // Added when the upload can serve none of the clients, scaled by the missing fraction.
+	float ModerateNATPenalty = 20.0f;
+	float StrictNATPenalty = 150.0f;
+	float OwnerBonus = 15.0f; // Hysteresis, so ownership is only transferred for a clear improvement.
+};
+
+/**
+ * Scores lobby members as listen-server host and picks the best one.
+ *
+ * Pure functions on profiles, so they can be driven with simulated member profiles without any network.
+ */
+class ONLINEMULTIPLAYER_API FHostElection
+{
+public:
+	/** Lower is better. Roughly the mean latency clients would have to this host, plus penalties. */
+	static float Score(const FHostCandidateProfile& Candidate, const TArray<FString>& Members, const FHostElectionWeights& Weights = FHostElectionWeights());
+
+	/** Returns the Product-User-ID of the best host, or an empty string if there are no candidates. */
+	static FString Elect(const TArray<FHostCandidateProfile>& Candidates, const FHostElectionWeights& Weights = FHostElectionWeights());
+
+private:
+	static float GetMeasuredRoundTripTime(const FString& Member, const FString& Peer, const TArray<FHostCandidateProfile>& Candidates);
+};
@@ -0,0 +1,112 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogJoinBarrier, Log, All);
+inline DEFINE_LOG_CATEGORY(LogJoinBarrier);
+
+
+
+/**
+ * When a join barrier releases, and which arrivals it waits for.
+ */
+struct FJoinBarrierPolicy
+{
+	/** Release as soon as this many players have arrived. Zero or less means all expected players. */
+	int32 Quorum = 0;
+
+	/** Seconds to wait before the barrier gives up on the quorum. */
+	float Timeout = 12.0f;
+
+	/** When the timeout elapses, still release if at least this many players have arrived. Negative means the quorum is required. */
+	int32 MinPlayersOnTimeout = -1;
+
+	/** Keep tracking players that arrive after the barrier has released. */
+	bool bAllowLateJoin = true;
+};
+
+enum class EJoinBarrierResult : uint8
+{
+	AllJoined,
+	QuorumReached,
+	TimedOut,
+	Cancelled
+};
+
+/**
+ * Arrival latencies of all join barriers, bucketed in seconds since the barrier started.
+ */
+class ONLINEMULTIPLAYER_API FJoinLatencyHistogram
+{
+public:
+	static FJoinLatencyHistogram& Get();
+	
+	void Add(const double Latency);
+	void Reset();
+	void LogSummary() const;
+
+	FORCEINLINE int32 GetNumSamples() const { return NumSamples; }
+	FORCEINLINE const TArray<int32>& GetBucketCounts() const { return BucketCounts; }
+	static const TArray<double>& GetBucketBounds();
+
+private:
+	FJoinLatencyHistogram();
+	
+	TArray<int32> BucketCounts;
+	int32 NumSamples = 0;
+	double MaxLatency = 0.0;
+	double TotalLatency = 0.0;
+};
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnJoinBarrierProgressDelegate, const int32 Arrived, const int32 Expected);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnJoinBarrierCompleteDelegate, const EJoinBarrierResult);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnJoinBarrierLateArrivalDelegate, const FString& ProductUserID, const double Latency);
+
+
+
+/**
+ * Waits for an expected set of players to arrive, and releases according to the policy.
+ *
+ * Arrivals and departures are reported by the owner, for example from the game-mode and the lobby.
+ */
+class ONLINEMULTIPLAYER_API FJoinBarrier
+{
+public:
+	FJoinBarrier(const TArray<FString>& ExpectedProductUserIDs, const FJoinBarrierPolicy& InPolicy);
+	~FJoinBarrier();
+
+	void Start();
+	void Cancel();
+	
+	void Arrive(const FString& ProductUserID);
+	void RemoveExpected(const FString& ProductUserID);
+
+	FORCEINLINE bool IsReleased() const { return bReleased; }
+	FORCEINLINE int32 GetNumExpected() const { return Expected.Num(); }
+	FORCEINLINE int32 GetNumArrived() const { return ArrivalLatencies.Num(); }
+	FORCEINLINE const TMap<FString, double>& GetArrivalLatencies() const { return ArrivalLatencies; }
+	double GetArrivalLatency(const FString& ProductUserID) const;
+	TArray<FString> GetMissing() const;
+
+	FOnJoinBarrierProgressDelegate OnProgressDelegate;
+	FOnJoinBarrierCompleteDelegate OnCompleteDelegate;
+	FOnJoinBarrierLateArrivalDelegate OnLateArrivalDelegate;
+
+private:
+	int32 GetRequiredArrivals() const;
+	void Evaluate();
+	void OnTimeout();
+	void Release(const EJoinBarrierResult Result);
+	void ClearTimeout();
+	
+	FJoinBarrierPolicy Policy;
+	TSet<FString> Expected;
+	TMap<FString, double> ArrivalLatencies;
+	double StartTime = 0.0;
+	bool bStarted = false;
+	bool bReleased = false;
+	FTSTicker::FDelegateHandle TimeoutHandle;
+};
@@ -0,0 +1,47 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogLazyActivation, Log, All);
+inline DEFINE_LOG_CATEGORY(LogLazyActivation);
+
+
+
+/**
+ * Defers the heavy part of a subsystem's startup, acquiring SDK interfaces and registering notifications, until it is first used.
+ *
+ * The owner binds its activation function in Initialize and calls Ensure at the start of every public entry point.
+ * Subsystems that are not configured as lazy are activated straight away, so the default behaviour is unchanged.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - bLazyOnlineSubsystems: Make every subsystem that supports it lazy.
+ * - +LazySubsystems: Name of a single subsystem class to make lazy, without the 'U' prefix (e.g. LobbySubsystem).
+ *
+ * Notifications of a lazy subsystem are not received before it is activated,
+ * so only enable this for builds that never get invites or lobby updates before they use the subsystem, like dedicated servers.
+ */
+class ONLINEMULTIPLAYER_API FLazyActivation
+{
+public:
+	~FLazyActivation();
+	
+	void Initialize(const UObject* InOwner, TFunction<void()> InActivateFunction);
+	void Reset();
+	void Prewarm();
+
+	FORCEINLINE void Ensure() { if(!bActivated) Activate(); }
+	FORCEINLINE bool IsActivated() const { return bActivated; }
+
+	static bool IsLazy(const UClass* Class);
+
+private:
+	void Activate();
+
+	TWeakObjectPtr<const UObject> Owner;
+	TFunction<void()> ActivateFunction;
+	bool bActivated = false;
+	FTSTicker::FDelegateHandle PrewarmHandle;
+};
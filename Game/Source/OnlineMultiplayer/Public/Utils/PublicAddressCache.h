@@ -0,0 +1,58 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Containers/Ticker.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogPublicAddress, Log, All);
+inline DEFINE_LOG_CATEGORY(LogPublicAddress);
+
+
+
+/**
+ * Singleton that discovers and caches the public address of this machine, which other players use to join a listen server.
+ *
+ * The lookup is started at module startup and cached for a configurable time, so hosting does not have to wait for it.
+ * When the lookup fails, or takes too long, the fallback resolvers are tried in the order they were added.
+ * The override is not one of these fallbacks, when it is set no lookup is made at all.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - PublicAddressOverride: Always use this address, skipping the lookup.
+ * - PublicAddressURL: Endpoint that responds with the address as plain text.
+ * - PublicAddressTTL: Seconds before the cached address is looked up again.
+ */
+class ONLINEMULTIPLAYER_API FPublicAddressCache
+{
+	FPublicAddressCache() = default;
+	friend class FPublicAddressCacheLookupTest;
+
+public:
+	static FPublicAddressCache& Get();
+	void Initialize();
+	
+	void Refresh();
+	void ResolveAddress(const TFunction<void(const FString& Address)>& Callback, const float MaxWaitTime = 2.0f);
+	void AddFallbackResolver(const FString& Name, const TFunction<FString()>& Resolver);
+
+	bool HasFreshAddress() const;
+	FORCEINLINE const FString& GetCachedAddress() const { return CachedAddress; }
+
+private:
+	void OnLookupComplete(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful);
+	FString ResolveFallbackAddress() const;
+	void CompleteWaiters(const FString& Address);
+
+	FString AddressOverride;
+	FString LookupURL = "http://api.ipify.org";
+	float TimeToLive = 600.0f;
+	
+	FString CachedAddress;
+	double CachedTime = 0.0;
+	bool bLookupInFlight = false;
+
+	TArray<TFunction<void(const FString& Address)>> Waiters;
+	FTSTicker::FDelegateHandle WaitTimeoutHandle;
+	TArray<TPair<FString, TFunction<FString()>>> FallbackResolvers;
+};
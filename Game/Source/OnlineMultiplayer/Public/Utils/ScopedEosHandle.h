@@ -0,0 +1,54 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "eos_base.h"
+
+
+
+/**
+ * Owns a handle copied from the EOS-SDK and releases it when going out of scope.
+ *
+ * Use ::Release to hand the handle over to code that releases it itself.
+ */
+template<typename HandleType, void(EOS_CALL* ReleaseFunction)(HandleType)>
+class TScopedEosHandle
+{
+public:
+	TScopedEosHandle() = default;
+	explicit TScopedEosHandle(HandleType InHandle) : Handle(InHandle) {}
+	~TScopedEosHandle() { Reset(); }
+
+	TScopedEosHandle(const TScopedEosHandle&) = delete;
+	TScopedEosHandle& operator=(const TScopedEosHandle&) = delete;
+	
+	TScopedEosHandle(TScopedEosHandle&& Other) noexcept : Handle(Other.Release()) {}
+	TScopedEosHandle& operator=(TScopedEosHandle&& Other) noexcept
+	{
+		if(this != &Other) Reset(Other.Release());
+		return *this;
+	}
+
+	FORCEINLINE HandleType Get() const { return Handle; }
+	FORCEINLINE bool IsValid() const { return Handle != nullptr; }
+	FORCEINLINE explicit operator bool() const { return IsValid(); }
+
+	// Releases the current handle, and takes ownership of the new one.
+	void Reset(HandleType NewHandle = nullptr)
+	{
+		if(Handle) ReleaseFunction(Handle);
+		Handle = NewHandle;
+	}
+
+	// Gives up ownership without releasing the handle.
+	HandleType Release()
+	{
+		HandleType OldHandle = Handle;
+		Handle = nullptr;
+		return OldHandle;
+	}
+
+private:
+	HandleType Handle = nullptr;
+};
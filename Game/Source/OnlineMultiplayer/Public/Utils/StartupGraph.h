@@ -0,0 +1,70 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogStartupGraph, Log, All);
+inline DEFINE_LOG_CATEGORY(LogStartupGraph);
+
+enum class EStartupStepState : uint8
+{
+	Pending,
+	Running,
+	Succeeded,
+	Failed,
+	Skipped, // A dependency failed.
+};
+
+
+
+/**
+ * Runs the asynchronous startup steps of the module, each step as soon as the steps it depends on have succeeded.
+ *
+ * Independent steps run concurrently. When a step fails, the steps depending on it are skipped and the startup fails.
+ * Any number of waiters can be added, also after the startup has finished.
+ */
+class ONLINEMULTIPLAYER_API FStartupGraph : public TSharedFromThis<FStartupGraph>
+{
+public:
+	using FCompleteStep = TFunction<void(bool bSuccess)>;
+	
+	struct FStep
+	{
+		FName Name;
+		TArray<FName> Dependencies;
+		TFunction<void(FCompleteStep)> Run;
+		EStartupStepState State = EStartupStepState::Pending;
+		double StartTime = 0.0;
+		double EndTime = 0.0;
+	};
+
+	/**
+	 * Adds a step that runs once all its dependencies have succeeded. The step must call the given function when it is done.
+	 */
+	void AddStep(const FName Name, const TArray<FName>& Dependencies, TFunction<void(FCompleteStep)>&& Run);
+	void Start();
+	void WhenComplete(TFunction<void(bool bWasSuccessful)>&& Callback);
+
+	FORCEINLINE bool IsStarted() const { return bStarted; }
+	FORCEINLINE bool IsComplete() const { return bComplete; }
+	FORCEINLINE bool WasSuccessful() const { return bSuccess; }
+	FORCEINLINE double GetStartTime() const { return StartTime; }
+	FORCEINLINE double GetEndTime() const { return EndTime; }
+	FORCEINLINE const TArray<FStep>& GetSteps() const { return Steps; }
+
+	void LogTimeline() const;
+
+private:
+	void RunReadySteps();
+	void CompleteStep(const int32 Index, const bool bStepSuccess);
+	void Finish();
+	
+	TArray<FStep> Steps;
+	TArray<TFunction<void(bool)>> Waiters;
+	bool bStarted = false;
+	bool bComplete = false;
+	bool bSuccess = true;
+	double StartTime = 0.0;
+	double EndTime = 0.0;
+};
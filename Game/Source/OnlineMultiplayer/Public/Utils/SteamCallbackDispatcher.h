@@ -0,0 +1,155 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#pragma warning(push)
+#pragma warning(disable: 4996)
+#pragma warning(disable: 4265)
+#include "steam_api.h"
+#include "steam_api_common.h"
+#pragma warning(pop)
+
+DECLARE_LOG_CATEGORY_EXTERN(LogSteamCallbackDispatcher, Log, All);
+inline DEFINE_LOG_CATEGORY(LogSteamCallbackDispatcher);
+
+
+
+/**
+ * Routes Steam callbacks and call-results to typed handlers, and profiles every callback-ID.
+ *
+ * By default the callbacks are pumped with SteamAPI_RunCallbacks, and the dispatcher registers one bridge per callback-ID.
+ * In manual mode the callbacks are drained with SteamAPI_ManualDispatch_* within a per-frame time budget,
+ * anything left over stays in the pipe for the next frame.
+ * Manual dispatch is process-wide, so it should only be enabled when the OnlineSubsystemSteam plugin is not pumping callbacks itself.
+ *
+ * The counts and durations are recorded as stats in 'stat Steam', and can be printed with 'Steam.CallbackReport'.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - bSteamManualDispatch: Drain the callbacks manually instead of using SteamAPI_RunCallbacks.
+ * - SteamCallbackBudgetMs: Time budget per frame for manual dispatch, zero is unlimited.
+ */
+class ONLINEMULTIPLAYER_API FSteamCallbackDispatcher
+{
+	FSteamCallbackDispatcher() = default;
+	~FSteamCallbackDispatcher();
+	friend class FSteamCallbackDispatcherTest;
+	
+public:
+	static FSteamCallbackDispatcher& Get()
+	{
+		static FSteamCallbackDispatcher Instance;
+		return Instance;
+	}
+
+	void Initialize();
+	void Shutdown();
+	void RunFrame();
+	
+	/**
+	 * Calls the function on the object every time the callback of type T is received.
+	 */
+	template<typename T, typename UserClass>
+	void RegisterUObject(UserClass* Object, void (UserClass::*Function)(T*))
+	{
+		TWeakObjectPtr<UserClass> WeakObject(Object);
+		RegisterInternal(Object, T::k_iCallback, sizeof(T), [WeakObject, Function](void* Data)
+		{
+			if(UserClass* StrongObject = WeakObject.Get()) (StrongObject->*Function)(static_cast<T*>(Data));
+		});
+	}
+
+	/**
+	 * Calls the function on the object once the call-result of type T for the given API-call is received.
+	 */
+	template<typename T, typename UserClass>
+	void CallUObject(const SteamAPICall_t ApiCall, UserClass* Object, void (UserClass::*Function)(T*, bool))
+	{
+		TWeakObjectPtr<UserClass> WeakObject(Object);
+		CallInternal(Object, ApiCall, T::k_iCallback, sizeof(T), [WeakObject, Function](void* Data, const bool bIOFailure)
+		{
+			if(UserClass* StrongObject = WeakObject.Get()) (StrongObject->*Function)(static_cast<T*>(Data), bIOFailure);
+		});
+	}
+
+	/** Removes every callback and pending call-result of the owner. */
+	void RemoveAll(const void* Owner);
+
+	/** Invokes the handlers of a callback as if it was received from Steam. */
+	void Dispatch(const int32 CallbackId, void* Data);
+	void DispatchCallResult(const SteamAPICall_t ApiCall, void* Data, const bool bIOFailure);
+
+	void LogStats() const;
+
+private:
+	void RegisterInternal(const void* Owner, const int32 CallbackId, const int32 Size, TFunction<void(void*)>&& Callback);
+	void CallInternal(const void* Owner, const SteamAPICall_t ApiCall, const int32 CallbackId, const int32 Size, TFunction<void(void*, bool)>&& Callback);
+	void DispatchCallCompleted(const HSteamPipe Pipe, const struct SteamAPICallCompleted_t& CallCompleted);
+	void InvokeProfiled(const int32 CallbackId, TFunctionRef<void()> Function);
+	void Compact();
+	
+	struct FHandler
+	{
+		const void* Owner;
+		TFunction<void(void*)> Callback;
+	};
+	
+	struct FDeferredHandler
+	{
+		int32 CallbackId;
+		int32 Size;
+		FHandler Handler;
+	};
+	
+	struct FCallbackEntry
+	{
+		TArray<FHandler> Handlers;
+		TUniquePtr<class FSteamCallbackBridge> Bridge;
+	};
+
+	struct FPendingCall
+	{
+		const void* Owner;
+		int32 CallbackId;
+		TFunction<void(void*, bool)> Callback;
+		TUniquePtr<class FSteamCallResultBridge> Bridge;
+	};
+
+	struct FCallbackProfile
+	{
+		int64 Count = 0;
+		double TotalSeconds = 0.0;
+		double MaxSeconds = 0.0;
+		TStatId StatId;
+	};
+	
+	FCallbackProfile& GetProfile(const int32 CallbackId);
+
+	/**
+	 * The pipe that manual dispatch drains, Steam's pipe after Initialize. Tests feed their callbacks through their own pipe.
+	 */
+	struct FManualDispatchPipe
+	{
+		TFunction<void()> RunFrame;
+		TFunction<bool(CallbackMsg_t& OutMessage)> GetNextCallback;
+		TFunction<void()> FreeLastCallback;
+	};
+	static FManualDispatchPipe MakeSteamPipe();
+	FManualDispatchPipe ManualDispatchPipe;
+	
+
+	TMap<int32, FCallbackEntry> Callbacks;
+	TMap<SteamAPICall_t, FPendingCall> PendingCalls;
+	TMap<int32, FCallbackProfile> Profiles;
+	TArray<TUniquePtr<class FSteamCallResultBridge>> CompletedBridges;
+	
+	// Registrations made by a handler are applied after the dispatch, so the containers are not changed while iterating.
+	int32 DispatchDepth = 0;
+	TArray<FDeferredHandler> DeferredHandlers;
+	bool bNeedsCompact = false;
+
+	bool bManualDispatch = false;
+	bool bInitialized = false;
+	float BudgetMs = 2.0f;
+	TArray<uint8> CallResultBuffer;
+};
@@ -0,0 +1,29 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogStubOnline, Log, All);
+inline DEFINE_LOG_CATEGORY(LogStubOnline);
+
+
+
+/**
+ * Offline mode in which the Steam and EOS SDKs are not initialized, and the startup steps complete with fake results.
+ *
+ * Used to measure the startup path headless with '-BootTimelineExit', where no Steam client or network is available.
+ *
+ * Enabled with '-StubOnline' on the command-line, or in the [OnlineMultiplayer] section of the game config:
+ * - bStubOnline: Stub the Steam and EOS startup.
+ * - StubOnlineLatencyMs: Delay before every stubbed step completes, standing in for the network. Overridden by '-StubOnlineLatencyMs='.
+ */
+class ONLINEMULTIPLAYER_API FStubOnline
+{
+public:
+	static bool IsEnabled();
+	static float GetLatency();
+
+	/** Calls the function after the stubbed latency, on the game thread. */
+	static void CompleteAfterLatency(TFunction<void()>&& Function);
+};
@@ -0,0 +1,98 @@
+﻿// Copyright © 2023 Melvin Brink
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Types/UserTypes.h"
+#include "Async/Future.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogUserProfileCache, Log, All);
+inline DEFINE_LOG_CATEGORY(LogUserProfileCache);
+
+
+
+/**
+ * Everything that is persisted of an online-user. The avatar is kept as raw RGBA pixels in memory, and compressed on disk.
+ */
+struct FPersistedUserProfile
+{
+	FString ProductUserID;
+	FString EpicAccountID;
+	EPlatform Platform = EPlatform::Epic;
+	FString UserID;
+	FString Username;
+	TMap<EPlatform, FPlatformUser> ExternalPlatformUsers;
+	int64 SavedTime = 0; // Unix time.
+	
+	uint32 AvatarWidth = 0;
+	uint32 AvatarHeight = 0;
+	TArray<uint8> AvatarPixels;
+
+	static FPersistedUserProfile FromOnlineUser(UOnlineUser* OnlineUser);
+	UOnlineUser* ToOnlineUser() const;
+	int64 GetAllocatedSize() const;
+};
+
+/**
+ * Singleton that persists the profiles of online-users between launches, so users seen before can be shown before they are fetched again.
+ *
+ * The file is memory-mapped at startup, and its records are validated on a background thread before they are used.
+ * Profiles are read from the mapped file on demand, and new profiles are written together with the retained ones on shutdown.
+ *
+ * File layout: a header with the magic and format version, followed by records of [PayloadSize, Crc32, Payload].
+ * A file with another magic or version is ignored and replaced on the next save.
+ *
+ * Configured in the [OnlineMultiplayer] section of the game config:
+ * - bUserProfileCache: Enables the cache.
+ * - UserProfileCacheSize: Maximum amount of persisted profiles, the oldest are dropped first.
+ * - UserProfileCacheMB: Maximum size of the file in megabytes.
+ * - UserProfileCacheMemoryMB: Maximum size of the profiles stored this launch in megabytes, with their uncompressed avatars.
+ *   The oldest are dropped first, and are written from the file again if they were in it.
+ */
+class ONLINEMULTIPLAYER_API FUserProfileCache
+{
+	FUserProfileCache() = default;
+
+public:
+	~FUserProfileCache();
+	static FUserProfileCache& Get();
+	void Initialize();
+	void Shutdown();
+
+	bool Load(const FString& ProductUserID, FPersistedUserProfile& OutProfile);
+	void Store(FPersistedUserProfile&& Profile);
+
+	FORCEINLINE bool IsReady() const { return bReady; }
+
+private:
+	struct FRecord
+	{
+		int32 Offset; // Of the payload in the mapped file.
+		uint32 Size;
+		int64 SavedTime;
+	};
+	
+	void Validate();
+	void TrimStoredProfiles();
+	void Save();
+	void Unmap();
+	TArrayView<const uint8> GetMappedView() const;
+
+	static TArray<uint8> SerializeProfile(FPersistedUserProfile& Profile);
+	static bool DeserializeProfile(TArrayView<const uint8> Payload, FPersistedUserProfile& OutProfile);
+	static FString GetFilePath();
+
+	bool bEnabled = true;
+	int32 MaxProfiles = 1024;
+	int64 MaxFileBytes = 32 * 1024 * 1024;
+	int64 MaxMemoryBytes = 16 * 1024 * 1024;
+	
+	TUniquePtr<class IMappedFileHandle> MappedFile;
+	TUniquePtr<class IMappedFileRegion> MappedRegion;
+	TMap<FString, FRecord> Records; // Validated records in the mapped file, only read after IsReady.
+	TFuture<void> ValidationTask;
+	std::atomic<bool> bReady = false;
+
+	TMap<FString, FPersistedUserProfile> StoredProfiles; // Added this launch, written on shutdown.
+	int64 StoredProfilesBytes = 0;
+};
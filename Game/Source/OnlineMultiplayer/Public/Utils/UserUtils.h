@@ -1,7 +1,6 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
-#include <vector>
 
 /**
  * Class providing helper methods for users.
@@ -9,5 +8,5 @@
 class ONLINEMULTIPLAYER_API FUserUtils
 {
 public:
-	static UTexture2D* ImageBufferToTexture2D(const std::vector<uint8>& Buffer, const uint32 Width, const uint32 Height);
+	static UTexture2D* ImageBufferToTexture2D(TConstArrayView<uint8> Buffer, const uint32 Width, const uint32 Height);
 };
\ No newline at end of file